@@ -0,0 +1,412 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Minimal C++20 coroutine support for the asynchronous API of the updater.
+//   Task<T>     Lazy coroutine, starts when it is awaited (or passed to Start()) and resumes its awaiter when done
+//   Executor    Where coroutines continue, implement Post() to run them on the event loop or thread pool of the host
+//   Schedule()  co_await Schedule(executor) continues the coroutine on the executor
+//   Run()       Runs a blocking function on an executor and returns its result as Task
+//   Start()     Starts a task from regular code, the returned future is ready once the task is done
+
+namespace selfUpdater::async
+{
+
+class Executor
+{
+public:
+	using Work = std::function<void()>;
+
+	virtual ~Executor() = default;
+
+	virtual void Post(Work work) = 0;
+};
+
+// Runs the work right away on the calling thread
+class InlineExecutor : public Executor
+{
+public:
+	void Post(Work work) override
+	{
+		work();
+	}
+};
+
+// Hands the work to a function of the host, e.g., the post/dispatch function of its event loop
+class FunctionExecutor : public Executor
+{
+public:
+	using PostFunction = std::function<void(Work)>;
+
+	explicit FunctionExecutor(PostFunction post) :
+		m_post(std::move(post))
+	{
+	}
+
+	void Post(Work work) override
+	{
+		m_post(std::move(work));
+	}
+
+private:
+	PostFunction m_post;
+};
+
+// Runs the work on a fixed set of background threads.
+// The threads are detached on purpose: the updater calls std::exit() from within a task once the new version was started,
+// which must neither wait for nor join the thread it is running on.
+class ThreadExecutor : public Executor
+{
+	struct Queue
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<Work> work;
+		bool stopped = false;
+	};
+
+public:
+	explicit ThreadExecutor(const uint32_t& threads = 1) :
+		m_pQueue(std::make_shared<Queue>())
+	{
+		for (uint32_t i = 0; i < (std::max)(threads, 1u); i++)
+			std::thread(run, m_pQueue).detach();
+	}
+
+	~ThreadExecutor()
+	{
+		std::lock_guard<std::mutex> lock(m_pQueue->mutex);
+		m_pQueue->stopped = true;
+		m_pQueue->cv.notify_all();
+	}
+
+	ThreadExecutor(const ThreadExecutor&)            = delete;
+	ThreadExecutor& operator=(const ThreadExecutor&) = delete;
+
+	void Post(Work work) override
+	{
+		std::lock_guard<std::mutex> lock(m_pQueue->mutex);
+		m_pQueue->work.push_back(std::move(work));
+		m_pQueue->cv.notify_one();
+	}
+
+private:
+	// Pending work is still done after the executor was destroyed, the queue lives as long as one of its threads
+	static void run(std::shared_ptr<Queue> pQueue)
+	{
+		while (true)
+		{
+			Work work;
+			{
+				std::unique_lock<std::mutex> lock(pQueue->mutex);
+				pQueue->cv.wait(lock, [&]() { return pQueue->stopped || !pQueue->work.empty(); });
+
+				if (pQueue->work.empty())
+					return;
+
+				work = std::move(pQueue->work.front());
+				pQueue->work.pop_front();
+			}
+
+			work();
+		}
+	}
+
+private:
+	std::shared_ptr<Queue> m_pQueue;
+};
+
+// Shared threads for blocking work like network requests, used whenever no other executor is given
+inline std::shared_ptr<Executor> GetBackgroundExecutor()
+{
+	static std::shared_ptr<Executor> pExecutor = std::make_shared<ThreadExecutor>(2);
+	return pExecutor;
+}
+
+template<typename T = void>
+class Task;
+
+namespace detail
+{
+
+class PromiseBase
+{
+	// Continues with the awaiting coroutine (if any) without growing the stack
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			const std::coroutine_handle<> continuation = handle.promise().m_continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+public:
+	std::suspend_always initial_suspend() const noexcept
+	{
+		return {};
+	}
+
+	FinalAwaiter final_suspend() const noexcept
+	{
+		return {};
+	}
+
+	void unhandled_exception()
+	{
+		m_exception = std::current_exception();
+	}
+
+	void SetContinuation(std::coroutine_handle<> continuation)
+	{
+		m_continuation = continuation;
+	}
+
+protected:
+	void rethrow() const
+	{
+		if (m_exception)
+			std::rethrow_exception(m_exception);
+	}
+
+private:
+	std::coroutine_handle<> m_continuation;
+	std::exception_ptr m_exception;
+};
+
+template<typename T>
+class Promise : public PromiseBase
+{
+public:
+	Task<T> get_return_object();
+
+	template<typename U>
+	void return_value(U&& value)
+	{
+		m_value.emplace(std::forward<U>(value));
+	}
+
+	T Result()
+	{
+		rethrow();
+		return std::move(*m_value);
+	}
+
+private:
+	std::optional<T> m_value;
+};
+
+template<>
+class Promise<void> : public PromiseBase
+{
+public:
+	Task<void> get_return_object();
+
+	void return_void()
+	{
+	}
+
+	void Result()
+	{
+		rethrow();
+	}
+};
+
+// Fire and forget coroutine, used by Start() to drive a task from regular code
+struct Detached
+{
+	struct promise_type
+	{
+		Detached get_return_object()
+		{
+			return {};
+		}
+
+		std::suspend_never initial_suspend() const noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() const noexcept
+		{
+			return {};
+		}
+
+		void return_void()
+		{
+		}
+
+		void unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+};
+
+} // namespace detail
+
+template<typename T>
+class Task
+{
+public:
+	using promise_type = detail::Promise<T>;
+	using Handle       = std::coroutine_handle<promise_type>;
+
+public:
+	explicit Task(Handle handle) :
+		m_handle(handle)
+	{
+	}
+
+	Task(Task&& other) noexcept :
+		m_handle(std::exchange(other.m_handle, {}))
+	{
+	}
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_handle)
+				m_handle.destroy();
+
+			m_handle = std::exchange(other.m_handle, {});
+		}
+
+		return *this;
+	}
+
+	~Task()
+	{
+		if (m_handle)
+			m_handle.destroy();
+	}
+
+	Task(const Task&)            = delete;
+	Task& operator=(const Task&) = delete;
+
+	bool await_ready() const noexcept
+	{
+		return !m_handle || m_handle.done();
+	}
+
+	// Starts the task, it resumes the awaiting coroutine once it is done
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		m_handle.promise().SetContinuation(awaiting);
+		return m_handle;
+	}
+
+	T await_resume()
+	{
+		return m_handle.promise().Result();
+	}
+
+private:
+	Handle m_handle;
+};
+
+namespace detail
+{
+
+template<typename T>
+inline Task<T> Promise<T>::get_return_object()
+{
+	return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object()
+{
+	return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+template<typename T>
+Detached drive(Task<T> task, std::promise<T> promise)
+{
+	try
+	{
+		if constexpr (std::is_void_v<T>)
+		{
+			co_await task;
+			promise.set_value();
+		}
+		else
+			promise.set_value(co_await task);
+	}
+	catch (...)
+	{
+		promise.set_exception(std::current_exception());
+	}
+}
+
+} // namespace detail
+
+// Continues the awaiting coroutine on the executor
+inline auto Schedule(Executor& executor)
+{
+	struct Awaiter
+	{
+		Executor& executor;
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle)
+		{
+			executor.Post([handle]() { handle.resume(); });
+		}
+
+		void await_resume() const noexcept
+		{
+		}
+	};
+
+	return Awaiter{ executor };
+}
+
+// Runs the blocking function on the executor, the awaiting coroutine continues on that executor afterwards
+template<typename Function>
+Task<std::invoke_result_t<Function>> Run(Executor& executor, Function function)
+{
+	co_await Schedule(executor);
+	co_return function();
+}
+
+// Starts the task on the calling thread, it runs until its first suspension (e.g., a Schedule()) before this returns
+template<typename T>
+std::future<T> Start(Task<T> task)
+{
+	std::promise<T> promise;
+	std::future<T> future = promise.get_future();
+
+	detail::drive(std::move(task), std::move(promise));
+
+	return future;
+}
+
+} // namespace selfUpdater::async
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Manifest.hpp"
+#include "Version.hpp"
+
+// Binary version file for catalogs with many entries, it is used in place (e.g., from a mapped file),
+// looking up an entry is a binary search over the index and only the found entry is materialized.
+//
+// Format, all integers are little-endian:
+//   header:  "SUMANIF1", u32 entry count, u32 string table size
+//   index:   per entry, sorted by name: u32 name offset, u32 name length, u32 attribute offset, u32 attribute length,
+//            u16 major, u16 minor, u16 revision, u16 build
+//   strings: UTF-8 names and attributes, offsets are relative to the start of the table
+//
+// The attributes are stored as in the text format (<key>=<value> separated by tabs), so new attributes need no format change.
+// A prerelease tag is stored as the prerelease=<tag> attribute. A name can have several records (e.g., for different channels),
+// they are next to each other in the order of the text file.
+
+namespace selfUpdater::manifest
+{
+
+class BinaryManifest
+{
+	static constexpr size_t HEADER_SIZE = 16;
+	static constexpr size_t RECORD_SIZE = 24;
+
+public:
+	static constexpr std::array<uint8_t, 8> MAGIC = { 'S', 'U', 'M', 'A', 'N', 'I', 'F', '1' };
+
+	struct Record
+	{
+		std::string_view name;
+		std::string_view attributes;
+		uint16_t major;
+		uint16_t minor;
+		uint16_t revision;
+		uint16_t build;
+	};
+
+public:
+	explicit BinaryManifest(std::span<const uint8_t> data) :
+		m_data(data)
+	{
+		if (!IsBinary(data) || data.size() < HEADER_SIZE)
+			return;
+
+		m_count       = readU32(MAGIC.size());
+		m_stringsSize = readU32(MAGIC.size() + 4);
+
+		const uint64_t indexSize = static_cast<uint64_t>(m_count) * RECORD_SIZE;
+		m_valid                  = (HEADER_SIZE + indexSize + m_stringsSize <= data.size());
+		m_stringsOffset          = HEADER_SIZE + static_cast<size_t>(indexSize);
+	}
+
+	static bool IsBinary(std::span<const uint8_t> data)
+	{
+		return data.size() >= MAGIC.size() && std::equal(MAGIC.begin(), MAGIC.end(), data.begin());
+	}
+
+	bool IsValid() const
+	{
+		return m_valid;
+	}
+
+	const uint32_t& Size() const
+	{
+		return m_count;
+	}
+
+	// Records with offsets outside of the string table are returned empty
+	Record At(const uint32_t& idx) const
+	{
+		const size_t pos = HEADER_SIZE + static_cast<size_t>(idx) * RECORD_SIZE;
+
+		Record record = {};
+
+		record.name       = string(readU32(pos), readU32(pos + 4));
+		record.attributes = string(readU32(pos + 8), readU32(pos + 12));
+		record.major      = readU16(pos + 16);
+		record.minor      = readU16(pos + 18);
+		record.revision   = readU16(pos + 20);
+		record.build      = readU16(pos + 22);
+
+		return record;
+	}
+
+	// If a name has several records the last one is returned
+	std::optional<Record> Find(std::string_view name) const
+	{
+		const auto [first, last] = equalRange(name);
+		if (first == last)
+			return std::nullopt;
+
+		return At(last - 1);
+	}
+
+	bool FindEntry(std::string_view name, Entry& entry) const
+	{
+		const std::optional<Record> record = Find(name);
+		if (!record)
+			return false;
+
+		entry = toEntry(*record);
+		return true;
+	}
+
+	void SelectUpdate(std::string_view name, UpdateSelector& selector) const
+	{
+		const auto [first, last] = equalRange(name);
+
+		for (uint32_t i = first; i < last; i++)
+			selector.Offer(toEntry(At(i)));
+	}
+
+private:
+	// Binary search for the records with the given name, [first, last)
+	std::pair<uint32_t, uint32_t> equalRange(std::string_view name) const
+	{
+		if (!m_valid)
+			return { 0, 0 };
+
+		// First record not less than the name
+		uint32_t lo = 0;
+		uint32_t hi = m_count;
+		while (lo < hi)
+		{
+			const uint32_t mid = lo + (hi - lo) / 2;
+			if (nameAt(mid) < name)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		const uint32_t first = lo;
+
+		// First record greater than the name
+		hi = m_count;
+		while (lo < hi)
+		{
+			const uint32_t mid = lo + (hi - lo) / 2;
+			if (nameAt(mid) == name)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		return { first, lo };
+	}
+
+	std::string_view nameAt(const uint32_t& idx) const
+	{
+		const size_t pos = HEADER_SIZE + static_cast<size_t>(idx) * RECORD_SIZE;
+		return string(readU32(pos), readU32(pos + 4));
+	}
+
+	static Entry toEntry(const Record& record)
+	{
+		Entry entry;
+		entry.version = version::ResVersion(record.major, record.minor, record.revision, record.build);
+		ParseAttributes(entry, record.attributes);
+
+		return entry;
+	}
+
+	std::string_view string(const uint32_t& offset, const uint32_t& length) const
+	{
+		if (static_cast<uint64_t>(offset) + length > m_stringsSize)
+			return {};
+
+		return { reinterpret_cast<const char*>(m_data.data() + m_stringsOffset + offset), length };
+	}
+
+	uint16_t readU16(const size_t& pos) const
+	{
+		return static_cast<uint16_t>(m_data[pos] | (m_data[pos + 1] << 8));
+	}
+
+	uint32_t readU32(const size_t& pos) const
+	{
+		return static_cast<uint32_t>(m_data[pos]) | (static_cast<uint32_t>(m_data[pos + 1]) << 8) | (static_cast<uint32_t>(m_data[pos + 2]) << 16) | (static_cast<uint32_t>(m_data[pos + 3]) << 24);
+	}
+
+private:
+	std::span<const uint8_t> m_data;
+	uint32_t m_count       = 0;
+	uint32_t m_stringsSize = 0;
+	size_t m_stringsOffset = 0;
+	bool m_valid           = false;
+};
+
+// Collects the entries and writes them in the binary format, entries with the same name keep their order
+class BinaryManifestWriter
+{
+	struct Item
+	{
+		std::string name;
+		std::string attributes;
+		version::ResVersion version;
+	};
+
+public:
+	void Add(const std::string& name, const version::ResVersion& version, const std::string& attributes = "", const std::string& prerelease = "")
+	{
+		std::string attrs = attributes;
+		if (!prerelease.empty())
+			attrs += (attrs.empty() ? "prerelease=" : "\tprerelease=") + prerelease;
+
+		m_items.push_back({ name, attrs, version });
+	}
+
+	bool Write(std::ostream& out)
+	{
+		// Stable, so entries with the same name stay in the order they were added
+		std::stable_sort(m_items.begin(), m_items.end(), [](const Item& a, const Item& b) { return a.name < b.name; });
+
+		std::string strings;
+		std::vector<uint8_t> index;
+
+		for (const Item& item : m_items)
+		{
+			writeU32(index, static_cast<uint32_t>(strings.size()));
+			writeU32(index, static_cast<uint32_t>(item.name.size()));
+			strings += item.name;
+
+			writeU32(index, static_cast<uint32_t>(strings.size()));
+			writeU32(index, static_cast<uint32_t>(item.attributes.size()));
+			strings += item.attributes;
+
+			writeU16(index, item.version.GetMajor());
+			writeU16(index, item.version.GetMinor());
+			writeU16(index, item.version.GetRevision());
+			writeU16(index, item.version.GetBuild());
+		}
+
+		std::vector<uint8_t> header(BinaryManifest::MAGIC.begin(), BinaryManifest::MAGIC.end());
+		writeU32(header, static_cast<uint32_t>(m_items.size()));
+		writeU32(header, static_cast<uint32_t>(strings.size()));
+
+		out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+		out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size()));
+		out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+		return out.good();
+	}
+
+private:
+	static void writeU16(std::vector<uint8_t>& out, const uint16_t& value)
+	{
+		out.push_back(static_cast<uint8_t>(value));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+	}
+
+	static void writeU32(std::vector<uint8_t>& out, const uint32_t& value)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+			out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+	}
+
+private:
+	std::vector<Item> m_items;
+};
+
+} // namespace selfUpdater::manifest
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Downloader.hpp"
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+
+// zsync-style block reuse: the server publishes a signature of the binary, containing a weak rolling checksum
+// and a strong hash for every block. The client searches its installed binary for these blocks at any offset
+// and only downloads the blocks it couldn't find, using Range requests.
+//
+// Signature format, all integers are little-endian:
+//   header: "SUZSYNC1", u32 block size, u64 file size, u8[32] SHA-256 of the file
+//   blocks: u32 weak checksum, u8[16] truncated SHA-256, for every block (the last one zero padded)
+
+namespace selfUpdater::blocksync
+{
+
+static constexpr std::array<uint8_t, 8> MAGIC = { 'S', 'U', 'Z', 'S', 'Y', 'N', 'C', '1' };
+static constexpr uint32_t DEFAULT_BLOCK_SIZE  = 4096;
+static constexpr size_t STRONG_SIZE           = 16;
+static constexpr size_t HEADER_SIZE           = MAGIC.size() + 4 + 8 + hash::Sha256::DIGEST_SIZE;
+static constexpr size_t BLOCK_RECORD_SIZE     = 4 + STRONG_SIZE;
+
+inline const std::wstring SIGNATURE_EXT = L".zsig";
+
+using StrongHash = std::array<uint8_t, STRONG_SIZE>;
+
+// rsync rolling checksum, can be moved along the data one byte at a time
+class RollingChecksum
+{
+public:
+	void Init(const uint8_t* pData, const uint32_t& size)
+	{
+		m_a    = 0;
+		m_b    = 0;
+		m_size = size;
+
+		for (uint32_t i = 0; i < size; i++)
+		{
+			m_a += pData[i];
+			m_b += (size - i) * pData[i];
+		}
+	}
+
+	void Roll(const uint8_t& out, const uint8_t& in)
+	{
+		m_a += in - out;
+		m_b += m_a - m_size * out;
+	}
+
+	uint32_t Value() const
+	{
+		return (m_a & 0xFFFF) | (m_b << 16);
+	}
+
+private:
+	uint32_t m_a    = 0;
+	uint32_t m_b    = 0;
+	uint32_t m_size = 0;
+};
+
+inline StrongHash StrongHashOf(const uint8_t* pData, const size_t& size)
+{
+	const hash::Sha256::Digest digest = hash::Sha256::Hash(pData, size);
+
+	StrongHash strong;
+	std::copy_n(digest.begin(), strong.size(), strong.begin());
+	return strong;
+}
+
+struct Block
+{
+	uint32_t weak;
+	StrongHash strong;
+};
+
+class Signature
+{
+public:
+	static Signature Create(const uint8_t* pData, const uint64_t& size, const uint32_t& blockSize = DEFAULT_BLOCK_SIZE)
+	{
+		Signature sig;
+		sig.m_blockSize = blockSize;
+		sig.m_fileSize  = size;
+		sig.m_fileHash  = hash::Sha256::Hash(pData, size);
+
+		std::vector<uint8_t> padded(blockSize);
+		RollingChecksum checksum;
+
+		for (uint64_t pos = 0; pos < size; pos += blockSize)
+		{
+			const uint8_t* pBlock = pData + pos;
+
+			if (size - pos < blockSize)
+			{
+				std::fill(padded.begin(), padded.end(), 0);
+				std::memcpy(padded.data(), pBlock, size - pos);
+				pBlock = padded.data();
+			}
+
+			checksum.Init(pBlock, blockSize);
+			sig.m_blocks.push_back({ checksum.Value(), StrongHashOf(pBlock, blockSize) });
+		}
+
+		return sig;
+	}
+
+	bool Parse(std::span<const uint8_t> data)
+	{
+		if (data.size() < HEADER_SIZE || !std::equal(MAGIC.begin(), MAGIC.end(), data.begin()))
+			return false;
+
+		m_blockSize = static_cast<uint32_t>(readInt(data, MAGIC.size(), 4));
+		m_fileSize  = readInt(data, MAGIC.size() + 4, 8);
+		std::copy_n(data.begin() + MAGIC.size() + 12, m_fileHash.size(), m_fileHash.begin());
+
+		if (m_blockSize == 0)
+			return false;
+
+		const uint64_t blockCount = (m_fileSize + m_blockSize - 1) / m_blockSize;
+		if ((data.size() - HEADER_SIZE) / BLOCK_RECORD_SIZE != blockCount)
+			return false;
+
+		m_blocks.resize(static_cast<size_t>(blockCount));
+		for (size_t i = 0; i < m_blocks.size(); i++)
+		{
+			const size_t pos = HEADER_SIZE + i * BLOCK_RECORD_SIZE;
+			m_blocks[i].weak = static_cast<uint32_t>(readInt(data, pos, 4));
+			std::copy_n(data.begin() + pos + 4, STRONG_SIZE, m_blocks[i].strong.begin());
+		}
+
+		return true;
+	}
+
+	bool Write(std::ostream& out) const
+	{
+		out.write(reinterpret_cast<const char*>(MAGIC.data()), MAGIC.size());
+		writeInt(out, m_blockSize, 4);
+		writeInt(out, m_fileSize, 8);
+		out.write(reinterpret_cast<const char*>(m_fileHash.data()), m_fileHash.size());
+
+		for (const Block& block : m_blocks)
+		{
+			writeInt(out, block.weak, 4);
+			out.write(reinterpret_cast<const char*>(block.strong.data()), block.strong.size());
+		}
+
+		return out.good();
+	}
+
+	const uint32_t& BlockSize() const
+	{
+		return m_blockSize;
+	}
+
+	const uint64_t& FileSize() const
+	{
+		return m_fileSize;
+	}
+
+	const hash::Sha256::Digest& FileHash() const
+	{
+		return m_fileHash;
+	}
+
+	const std::vector<Block>& Blocks() const
+	{
+		return m_blocks;
+	}
+
+private:
+	static uint64_t readInt(std::span<const uint8_t> data, const size_t& pos, const uint32_t& bytes)
+	{
+		uint64_t value = 0;
+		for (uint32_t i = 0; i < bytes; i++)
+			value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+
+		return value;
+	}
+
+	static void writeInt(std::ostream& out, const uint64_t& value, const uint32_t& bytes)
+	{
+		for (uint32_t i = 0; i < bytes; i++)
+			out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+private:
+	uint32_t m_blockSize = 0;
+	uint64_t m_fileSize  = 0;
+	hash::Sha256::Digest m_fileHash;
+	std::vector<Block> m_blocks;
+};
+
+// Where each block of the target comes from
+struct Plan
+{
+	static constexpr uint64_t MISSING = UINT64_MAX;
+
+	std::vector<uint64_t> localOffsets; // Offset within the local file or MISSING
+	uint64_t reusedBytes = 0;
+
+	// Missing blocks merged into byte ranges, runs separated by only a few reusable blocks are joined to save requests
+	std::vector<downloader::Segment> MissingRanges(const Signature& sig, const uint32_t& maxGapBlocks = 2) const
+	{
+		std::vector<downloader::Segment> ranges;
+
+		for (size_t i = 0; i < localOffsets.size(); i++)
+		{
+			if (localOffsets[i] != MISSING)
+				continue;
+
+			const uint64_t begin = static_cast<uint64_t>(i) * sig.BlockSize();
+			const uint64_t end   = (std::min)(begin + sig.BlockSize(), sig.FileSize());
+
+			if (!ranges.empty() && begin - ranges.back().end <= static_cast<uint64_t>(maxGapBlocks) * sig.BlockSize())
+				ranges.back().end = end;
+			else
+				ranges.push_back({ begin, end });
+		}
+
+		return ranges;
+	}
+};
+
+// Searches the local data for the blocks of the signature at every byte offset
+inline Plan Match(const Signature& sig, std::span<const uint8_t> local)
+{
+	const uint32_t blockSize = sig.BlockSize();
+
+	Plan plan;
+	plan.localOffsets.assign(sig.Blocks().size(), Plan::MISSING);
+
+	// Zero padding allows the (padded) last block to match the end of the local file,
+	// only the last block of the local data is copied for it
+	const size_t localSize = local.size();
+	const size_t tailBegin = localSize - (std::min)(localSize, static_cast<size_t>(blockSize));
+
+	std::vector<uint8_t> tail(local.begin() + static_cast<std::ptrdiff_t>(tailBegin), local.end());
+	tail.resize(tail.size() + blockSize, 0);
+
+	auto window = [&](const size_t& pos) { return (pos + blockSize <= localSize) ? local.data() + pos : tail.data() + (pos - tailBegin); };
+
+	std::unordered_multimap<uint32_t, size_t> weakIndex;
+	weakIndex.reserve(sig.Blocks().size());
+	for (size_t i = 0; i < sig.Blocks().size(); i++)
+		weakIndex.emplace(sig.Blocks()[i].weak, i);
+
+	RollingChecksum checksum;
+	size_t pos       = 0;
+	bool initialized = false;
+
+	while (pos < localSize)
+	{
+		if (!initialized)
+		{
+			checksum.Init(window(pos), blockSize);
+			initialized = true;
+		}
+
+		bool matched   = false;
+		auto [it, end] = weakIndex.equal_range(checksum.Value());
+
+		if (it != end)
+		{
+			const StrongHash strong = StrongHashOf(window(pos), blockSize);
+
+			for (; it != end; ++it)
+			{
+				const size_t idx = it->second;
+				if (plan.localOffsets[idx] == Plan::MISSING && sig.Blocks()[idx].strong == strong)
+				{
+					plan.localOffsets[idx] = pos;
+					plan.reusedBytes += (std::min)(static_cast<uint64_t>(blockSize), sig.FileSize() - static_cast<uint64_t>(idx) * blockSize);
+					matched = true;
+				}
+			}
+		}
+
+		// After a match the next block most likely follows directly
+		if (matched)
+		{
+			pos += blockSize;
+			initialized = false;
+			continue;
+		}
+
+		checksum.Roll(local[pos], (pos + blockSize < localSize) ? local[pos + blockSize] : 0);
+		pos++;
+	}
+
+	return plan;
+}
+
+// Builds targetPath from the blocks of localPath and the missing ranges of url.
+// Returns false if no signature is available or the result doesn't match the signature.
+// If expectedHash is given, a signature describing a different file is rejected before anything is downloaded.
+inline bool Sync(const std::wstring& url, const std::wstring& localPath, const std::wstring& targetPath, downloader::ProgressCallBack cb = nullptr, const std::optional<hash::Sha256::Digest>& expectedHash = std::nullopt)
+{
+	std::vector<uint8_t> sigData;
+	downloader::VectorSink sigSink(sigData);
+	downloader::Response response;
+
+	if (!downloader::Downloader::Request(url + SIGNATURE_EXT, sigSink, response) || !response.IsSuccess())
+		return false;
+
+	Signature sig;
+	if (!sig.Parse(sigData))
+	{
+		std::cerr << "[BlockSync] Invalid signature file" << std::endl;
+		return false;
+	}
+
+	if (expectedHash && sig.FileHash() != *expectedHash)
+	{
+		std::cerr << "[BlockSync] Signature does not match the expected hash" << std::endl;
+		return false;
+	}
+
+	const utils::MappedFile local(localPath);
+	if (!local.IsOpen())
+	{
+		std::wcerr << std::format(L"[BlockSync] Failed to open {}", localPath) << std::endl;
+		return false;
+	}
+
+	const Plan plan = Match(sig, local.Span());
+	std::wcout << std::format(L"[BlockSync] Reusing {} of {} bytes from {}", plan.reusedBytes, sig.FileSize(), localPath) << std::endl;
+
+	// Write all reusable blocks, the missing ones are filled in place by the range requests
+	{
+		std::ofstream target(std::filesystem::path(targetPath), std::ios::binary | std::ios::trunc);
+		std::vector<uint8_t> block(sig.BlockSize());
+
+		for (size_t i = 0; i < plan.localOffsets.size(); i++)
+		{
+			const size_t size = static_cast<size_t>((std::min)(static_cast<uint64_t>(sig.BlockSize()), sig.FileSize() - static_cast<uint64_t>(i) * sig.BlockSize()));
+
+			// A matched block may be the padded last one of the local file
+			std::fill(block.begin(), block.end(), 0);
+			if (plan.localOffsets[i] != Plan::MISSING)
+				std::memcpy(block.data(), local.Data() + plan.localOffsets[i], static_cast<size_t>((std::min)(static_cast<uint64_t>(size), local.Size() - plan.localOffsets[i])));
+
+			target.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(size));
+		}
+
+		if (!target)
+		{
+			std::wcerr << std::format(L"[BlockSync] Failed to write {}", targetPath) << std::endl;
+			return false;
+		}
+	}
+
+	const std::vector<downloader::Segment> ranges = plan.MissingRanges(sig);
+	if (!ranges.empty() && !downloader::Downloader::DownloadRanges(url, ranges, targetPath, cb))
+		return false;
+
+	// Verify the assembled file as a whole, this also catches blocks that changed on the server in the meantime
+	std::ifstream result(std::filesystem::path(targetPath), std::ios::binary);
+	std::vector<uint8_t> buffer(64 * 1024);
+	hash::Sha256 sha;
+
+	while (result.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size())) || result.gcount() > 0)
+		sha.Update(buffer.data(), static_cast<size_t>(result.gcount()));
+
+	if (sha.Final() != sig.FileHash())
+	{
+		std::cerr << "[BlockSync] Assembled file does not match the signature" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace selfUpdater::blocksync
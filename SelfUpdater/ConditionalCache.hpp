@@ -0,0 +1,192 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Downloader.hpp"
+#include "Hedge.hpp"
+#include "Utils.hpp"
+
+namespace selfUpdater::downloader
+{
+
+// Persists the last response of a URL together with its validators (ETag/Last-Modified),
+// so it can be requested conditionally and a 304 Not Modified doesn't transfer the body again.
+class ConditionalCache
+{
+	static constexpr uint32_t HTTP_NOT_MODIFIED = 304;
+
+	struct Validators
+	{
+		std::wstring url;
+		std::wstring etag;
+		std::wstring lastModified;
+	};
+
+public:
+	enum class Result
+	{
+		Failed,
+		Modified,   // Data contains the new body
+		NotModified // The cached body is still current, data is left untouched
+	};
+
+public:
+	explicit ConditionalCache(const std::filesystem::path& directory) :
+		m_directory(directory)
+	{
+	}
+
+	// With a hedge a slow request is sent a second time, to hedgeUrl if given (e.g., a mirror) or to the same URL
+	Result Fetch(const std::wstring& url, std::vector<uint8_t>& data, Hedge* pHedge = nullptr, const std::wstring& hedgeUrl = L"")
+	{
+		m_retryAfter = std::nullopt;
+
+		Validators validators;
+		const bool cached = loadValidators(url, validators) && std::filesystem::exists(bodyPath(url));
+
+		std::wstring requestHeaders;
+		if (cached && !validators.etag.empty())
+			requestHeaders += std::format(L"If-None-Match: {}\r\n", validators.etag);
+		if (cached && !validators.lastModified.empty())
+			requestHeaders += std::format(L"If-Modified-Since: {}\r\n", validators.lastModified);
+
+		std::vector<uint8_t> body;
+		Response response;
+
+		if (!request(url, body, response, requestHeaders, pHedge, hedgeUrl))
+			return Result::Failed;
+
+		if (response.status == HTTP_NOT_MODIFIED && cached)
+			return Result::NotModified;
+
+		if (!response.IsSuccess())
+		{
+			// Usually sent with 429 Too Many Requests and 503 Service Unavailable
+			m_retryAfter = ParseRetryAfter(response.headers.Get(L"Retry-After").value_or(L""));
+
+			std::wcerr << std::format(L"Request for {} failed with HTTP status {}", url, response.status) << std::endl;
+			return Result::Failed;
+		}
+
+		validators.url          = url;
+		validators.etag         = std::wstring(response.headers.Get(L"ETag").value_or(L""));
+		validators.lastModified = std::wstring(response.headers.Get(L"Last-Modified").value_or(L""));
+
+		store(validators, body);
+
+		data = std::move(body);
+		return Result::Modified;
+	}
+
+	// How long the server asked to wait before the next request, set if the last Fetch() failed with a Retry-After header
+	const std::optional<std::chrono::seconds>& RetryAfter() const
+	{
+		return m_retryAfter;
+	}
+
+	// Loads the body stored by the last successful Fetch() of the URL
+	bool Load(const std::wstring& url, std::vector<uint8_t>& data) const
+	{
+		std::ifstream file(bodyPath(url), std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+		return file.good();
+	}
+
+private:
+	static bool request(const std::wstring& url, std::vector<uint8_t>& body, Response& response, const std::wstring& requestHeaders, Hedge* pHedge, const std::wstring& hedgeUrl)
+	{
+		if (pHedge != nullptr)
+			return pHedge->Request({ url, hedgeUrl.empty() ? url : hedgeUrl }, body, response, requestHeaders);
+
+		VectorSink sink(body);
+		return Downloader::Request(url, sink, response, requestHeaders);
+	}
+
+	bool loadValidators(const std::wstring& url, Validators& validators) const
+	{
+		std::ifstream file(validatorsPath(url));
+		if (!file)
+			return false;
+
+		std::string storedUrl, etag, lastModified;
+		if (!std::getline(file, storedUrl) || !std::getline(file, etag) || !std::getline(file, lastModified))
+			return false;
+
+		// Different URLs might share the same hash
+		if (utils::s2ws(storedUrl) != url)
+			return false;
+
+		validators.url          = url;
+		validators.etag         = utils::s2ws(etag);
+		validators.lastModified = utils::s2ws(lastModified);
+
+		return !validators.etag.empty() || !validators.lastModified.empty();
+	}
+
+	void store(const Validators& validators, const std::vector<uint8_t>& body) const
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(m_directory, ec);
+
+		// Drop the old validators first, they must never be paired with a different body
+		std::filesystem::remove(validatorsPath(validators.url), ec);
+
+		if (validators.etag.empty() && validators.lastModified.empty())
+			return;
+
+		std::ofstream bodyFile(bodyPath(validators.url), std::ios::binary | std::ios::trunc);
+		bodyFile.write(reinterpret_cast<const char*>(body.data()), static_cast<std::streamsize>(body.size()));
+		bodyFile.close();
+
+		if (!bodyFile)
+			return;
+
+		std::ofstream file(validatorsPath(validators.url), std::ios::trunc);
+		file << utils::ws2s(validators.url) << '\n'
+			 << utils::ws2s(validators.etag) << '\n'
+			 << utils::ws2s(validators.lastModified) << '\n';
+	}
+
+	std::filesystem::path validatorsPath(const std::wstring& url) const
+	{
+		return m_directory / std::format(L"{:016x}.validators", hashUrl(url));
+	}
+
+	std::filesystem::path bodyPath(const std::wstring& url) const
+	{
+		return m_directory / std::format(L"{:016x}.body", hashUrl(url));
+	}
+
+	// FNV-1a, the file names have to be stable across builds so std::hash can't be used
+	static uint64_t hashUrl(const std::wstring& url)
+	{
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (const wchar_t& c : url)
+		{
+			hash ^= static_cast<uint64_t>(c);
+			hash *= 0x100000001b3ULL;
+		}
+
+		return hash;
+	}
+
+private:
+	std::filesystem::path m_directory;
+	std::optional<std::chrono::seconds> m_retryAfter;
+};
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Version.hpp"
+
+// Version ranges as used by the requires= and blocked= attributes of the version file.
+//
+// A range is a list of alternatives separated by "||", each alternative is a list of comparators separated by spaces
+// that all have to match. Versions can be partial, missing parts match anything:
+//   1.2.3.4  =1.2    !=1.2.3    >=1.2    >1.2    <=2    <2.0.1
+//   ^1.2     same major version and at least 1.2
+//   ~1.2.3   same major and minor version and at least 1.2.3
+//   *        any version
+// Example: ">=1.2 <2 !=1.4.0 || >=3"
+//
+// Parts are given in the written order of the configured format, so "1.2.3" means major.minor.revision by default
+// and major.minor.build with SU_MS_VERSION_FORMAT.
+//
+// A range is compiled once into sorted, disjoint intervals of the packed version key, so matching a version is a
+// binary search over a handful of integers.
+
+namespace selfUpdater::version
+{
+
+class VersionRange
+{
+	static constexpr uint64_t MAX_KEY = (std::numeric_limits<uint64_t>::max)();
+
+	// Inclusive bounds
+	struct Interval
+	{
+		uint64_t lo;
+		uint64_t hi;
+	};
+
+public:
+	// An empty range, it doesn't contain any version
+	VersionRange() = default;
+
+	static VersionRange All()
+	{
+		VersionRange range;
+		range.m_intervals.push_back({ 0, MAX_KEY });
+		return range;
+	}
+
+	static bool Parse(std::string_view expr, VersionRange& range)
+	{
+		VersionRange result;
+		size_t pos = 0;
+
+		while (pos <= expr.size())
+		{
+			const size_t next                   = expr.find("||", pos);
+			const std::string_view alternative = expr.substr(pos, next == std::string_view::npos ? std::string_view::npos : next - pos);
+
+			VersionRange set;
+			if (!parseSet(alternative, set))
+				return false;
+
+			result = result.Union(set);
+
+			if (next == std::string_view::npos)
+				break;
+
+			pos = next + 2;
+		}
+
+		range = std::move(result);
+		return true;
+	}
+
+	bool Contains(const ResVersion& version) const
+	{
+		const uint64_t key = version.Key();
+
+		// First interval that ends at or after the key
+		const auto it = std::lower_bound(m_intervals.begin(), m_intervals.end(), key, [](const Interval& interval, const uint64_t& value) { return interval.hi < value; });
+		return it != m_intervals.end() && it->lo <= key;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_intervals.empty();
+	}
+
+	bool IsAll() const
+	{
+		return m_intervals.size() == 1 && m_intervals[0].lo == 0 && m_intervals[0].hi == MAX_KEY;
+	}
+
+	VersionRange Intersect(const VersionRange& other) const
+	{
+		VersionRange result;
+		size_t i = 0;
+		size_t j = 0;
+
+		while (i < m_intervals.size() && j < other.m_intervals.size())
+		{
+			const Interval& a = m_intervals[i];
+			const Interval& b = other.m_intervals[j];
+
+			const uint64_t lo = (std::max)(a.lo, b.lo);
+			const uint64_t hi = (std::min)(a.hi, b.hi);
+
+			if (lo <= hi)
+				result.m_intervals.push_back({ lo, hi });
+
+			if (a.hi < b.hi)
+				i++;
+			else
+				j++;
+		}
+
+		return result;
+	}
+
+	VersionRange Union(const VersionRange& other) const
+	{
+		std::vector<Interval> all = m_intervals;
+		all.insert(all.end(), other.m_intervals.begin(), other.m_intervals.end());
+		std::sort(all.begin(), all.end(), [](const Interval& a, const Interval& b) { return a.lo < b.lo; });
+
+		VersionRange result;
+		for (const Interval& interval : all)
+		{
+			// Merge overlapping and adjacent intervals
+			if (!result.m_intervals.empty() && (result.m_intervals.back().hi == MAX_KEY || interval.lo <= result.m_intervals.back().hi + 1))
+				result.m_intervals.back().hi = (std::max)(result.m_intervals.back().hi, interval.hi);
+			else
+				result.m_intervals.push_back(interval);
+		}
+
+		return result;
+	}
+
+	VersionRange Complement() const
+	{
+		VersionRange result;
+		uint64_t next = 0;
+		bool done     = false;
+
+		for (const Interval& interval : m_intervals)
+		{
+			if (interval.lo > next)
+				result.m_intervals.push_back({ next, interval.lo - 1 });
+
+			if (interval.hi == MAX_KEY)
+			{
+				done = true;
+				break;
+			}
+
+			next = interval.hi + 1;
+		}
+
+		if (!done)
+			result.m_intervals.push_back({ next, MAX_KEY });
+
+		return result;
+	}
+
+private:
+	// Comparators separated by whitespace, all of them have to match
+	static bool parseSet(std::string_view set, VersionRange& range)
+	{
+		VersionRange result = All();
+		bool any            = false;
+
+		size_t pos = 0;
+		while (true)
+		{
+			pos = set.find_first_not_of(" \t", pos);
+			if (pos == std::string_view::npos)
+				break;
+
+			const size_t end = set.find_first_of(" \t", pos);
+
+			VersionRange comparator;
+			if (!parseComparator(set.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos), comparator))
+				return false;
+
+			result = result.Intersect(comparator);
+			any    = true;
+
+			if (end == std::string_view::npos)
+				break;
+
+			pos = end;
+		}
+
+		if (!any)
+			return false;
+
+		range = std::move(result);
+		return true;
+	}
+
+	static bool parseComparator(std::string_view str, VersionRange& range)
+	{
+		std::string_view op;
+		for (const std::string_view candidate : { ">=", "<=", "!=", ">", "<", "=", "^", "~" })
+		{
+			if (str.starts_with(candidate))
+			{
+				op = candidate;
+				break;
+			}
+		}
+
+		str.remove_prefix(op.size());
+
+		// Lowest and highest key the partial version stands for
+		uint64_t lo    = 0;
+		uint64_t hi    = 0;
+		uint32_t count = 0;
+		if (!parsePartial(str, lo, hi, count))
+			return false;
+
+		if (op.empty() || op == "=")
+			range = interval(lo, hi);
+		else if (op == ">=")
+			range = interval(lo, MAX_KEY);
+		else if (op == ">")
+			range = (hi == MAX_KEY) ? VersionRange() : interval(hi + 1, MAX_KEY);
+		else if (op == "<=")
+			range = interval(0, hi);
+		else if (op == "<")
+			range = (lo == 0) ? VersionRange() : interval(0, lo - 1);
+		else if (op == "!=")
+			range = interval(lo, hi).Complement();
+		else
+		{
+			// ^ keeps the major version, ~ the major and minor version (or only the major version if no minor is given)
+			const uint32_t fixed = (op == "^" || count < 2) ? 1 : 2;
+			if (count < fixed)
+				return false;
+
+			const uint64_t mask = MAX_KEY >> (16 * fixed);
+			range               = interval(lo, (lo & ~mask) | mask);
+		}
+
+		return true;
+	}
+
+	// Parses up to four dot separated parts, "*"/"x" or missing parts are wildcards. Count is the number of fixed parts.
+	static bool parsePartial(std::string_view str, uint64_t& lo, uint64_t& hi, uint32_t& count)
+	{
+		lo    = 0;
+		hi    = 0;
+		count = 0;
+
+		if (str.empty())
+			return false;
+
+		bool wildcard = false;
+		uint32_t part = 0;
+
+		for (; part < 4 && !str.empty(); part++)
+		{
+			const size_t dot           = str.find('.');
+			const std::string_view num = str.substr(0, dot);
+			str                        = (dot == std::string_view::npos) ? std::string_view() : str.substr(dot + 1);
+
+			if (dot != std::string_view::npos && str.empty())
+				return false;
+
+			const uint32_t shift = 48 - 16 * part;
+
+			if (num == "*" || num == "x" || num == "X")
+			{
+				wildcard = true;
+				hi |= static_cast<uint64_t>(0xFFFF) << shift;
+				continue;
+			}
+
+			// Wildcards can only be followed by more wildcards
+			uint16_t value      = 0;
+			const auto [p, err] = std::from_chars(num.data(), num.data() + num.size(), value);
+			if (wildcard || err != std::errc() || p != num.data() + num.size())
+				return false;
+
+			lo |= static_cast<uint64_t>(value) << shift;
+			hi |= static_cast<uint64_t>(value) << shift;
+			count++;
+		}
+
+		if (!str.empty())
+			return false;
+
+		for (; part < 4; part++)
+			hi |= static_cast<uint64_t>(0xFFFF) << (48 - 16 * part);
+
+		return true;
+	}
+
+	static VersionRange interval(const uint64_t& lo, const uint64_t& hi)
+	{
+		VersionRange range;
+		range.m_intervals.push_back({ lo, hi });
+		return range;
+	}
+
+private:
+	std::vector<Interval> m_intervals;
+};
+
+// Prerelease tags are compared like in semantic versioning: a release (empty tag) is newer than any prerelease,
+// identifiers are separated by dots, numeric identifiers are compared as numbers and are older than alphanumeric ones
+inline int ComparePrerelease(std::string_view a, std::string_view b)
+{
+	if (a.empty() || b.empty())
+		return a.empty() ? (b.empty() ? 0 : 1) : -1;
+
+	while (!a.empty() && !b.empty())
+	{
+		const size_t dotA          = a.find('.');
+		const size_t dotB          = b.find('.');
+		const std::string_view idA = a.substr(0, dotA);
+		const std::string_view idB = b.substr(0, dotB);
+
+		a = (dotA == std::string_view::npos) ? std::string_view() : a.substr(dotA + 1);
+		b = (dotB == std::string_view::npos) ? std::string_view() : b.substr(dotB + 1);
+
+		uint64_t numA = 0;
+		uint64_t numB = 0;
+
+		const auto [pA, errA] = std::from_chars(idA.data(), idA.data() + idA.size(), numA);
+		const auto [pB, errB] = std::from_chars(idB.data(), idB.data() + idB.size(), numB);
+
+		const bool isNumA = (errA == std::errc() && pA == idA.data() + idA.size());
+		const bool isNumB = (errB == std::errc() && pB == idB.data() + idB.size());
+
+		if (isNumA && isNumB)
+		{
+			if (numA != numB)
+				return numA < numB ? -1 : 1;
+		}
+		else if (isNumA != isNumB)
+			return isNumA ? -1 : 1;
+		else if (const int cmp = idA.compare(idB); cmp != 0)
+			return cmp < 0 ? -1 : 1;
+
+		// Both ran out at the same time (e.g., "rc.1" vs. "rc.1"), otherwise the shorter one is older
+		if (a.empty() != b.empty())
+			return a.empty() ? -1 : 1;
+	}
+
+	return 0;
+}
+
+} // namespace selfUpdater::version
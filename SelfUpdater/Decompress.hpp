@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Sink.hpp"
+
+// Decoders are optional, define SU_WITH_ZSTD and/or SU_WITH_GZIP to enable them (requires libzstd/zlib).
+// MSVC links the libraries on its own, other compilers need -lzstd/-lz.
+#ifdef SU_WITH_ZSTD
+#include <zstd.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "zstd.lib")
+#endif
+#endif
+
+#ifdef SU_WITH_GZIP
+#include <zlib.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "zlib.lib")
+#endif
+#endif
+
+namespace selfUpdater::downloader
+{
+
+enum class Encoding
+{
+	Identity,
+	Gzip,
+	Zstd,
+	Auto // Detected from the magic bytes at the start of the data
+};
+
+inline Encoding ParseEncoding(std::string_view name)
+{
+	if (name == "zstd" || name == "zst")
+		return Encoding::Zstd;
+	if (name == "gzip" || name == "gz")
+		return Encoding::Gzip;
+	if (name == "auto")
+		return Encoding::Auto;
+
+	return Encoding::Identity;
+}
+
+inline bool IsEncodingSupported(const Encoding& encoding)
+{
+	switch (encoding)
+	{
+		case Encoding::Identity:
+		case Encoding::Auto:
+			return true;
+#ifdef SU_WITH_ZSTD
+		case Encoding::Zstd:
+			return true;
+#endif
+#ifdef SU_WITH_GZIP
+		case Encoding::Gzip:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+// Value for the Accept-Encoding request header, empty if no decoder is compiled in
+inline std::wstring AcceptEncoding()
+{
+	std::wstring value;
+#ifdef SU_WITH_ZSTD
+	value += L"zstd";
+#endif
+#ifdef SU_WITH_GZIP
+	value += value.empty() ? L"gzip" : L", gzip";
+#endif
+	return value;
+}
+
+// Decompresses the data while it is received and passes the result on to the target sink.
+// Output is produced straight into the memory prepared by the target, so only one input chunk is buffered.
+// The ProgressCallBack of the download reports the compressed bytes, outputCb reports the decompressed bytes written.
+class DecompressSink : public Sink
+{
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	static constexpr std::array<uint8_t, 2> GZIP_MAGIC = { 0x1F, 0x8B };
+	static constexpr std::array<uint8_t, 4> ZSTD_MAGIC = { 0x28, 0xB5, 0x2F, 0xFD };
+
+public:
+	DecompressSink(Sink& target, const Encoding& encoding, ProgressCallBack outputCb = nullptr) :
+		m_target(target),
+		m_encoding(encoding),
+		m_outputCb(outputCb),
+		m_input(CHUNK_SIZE)
+	{
+		if (m_encoding != Encoding::Auto)
+			init();
+	}
+
+	~DecompressSink()
+	{
+#ifdef SU_WITH_ZSTD
+		if (m_pZstd != nullptr)
+			ZSTD_freeDStream(m_pZstd);
+#endif
+#ifdef SU_WITH_GZIP
+		if (m_zlibInit)
+			inflateEnd(&m_zlib);
+#endif
+	}
+
+	DecompressSink(const DecompressSink&)            = delete;
+	DecompressSink& operator=(const DecompressSink&) = delete;
+
+	const Encoding& GetEncoding() const
+	{
+		return m_encoding;
+	}
+
+	const uint64_t& Written() const
+	{
+		return m_written;
+	}
+
+	bool OnResponse(const Response& response) override
+	{
+		return m_target.OnResponse(response);
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		if (m_failed)
+			return {};
+
+		// While detecting the encoding the first bytes are kept at the front of the buffer
+		return std::span<uint8_t>(m_input).subspan(m_pending, (std::min)(maxSize, m_input.size() - m_pending));
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		if (m_failed)
+			return false;
+
+		std::size_t available = m_pending + size;
+		m_pending             = 0;
+
+		if (m_encoding == Encoding::Auto)
+		{
+			if (available < ZSTD_MAGIC.size() && size > 0)
+			{
+				m_pending = available;
+				return true;
+			}
+
+			m_encoding = detect(available);
+			if (!init())
+				return false;
+		}
+
+		return decode(m_input.data(), available);
+	}
+
+	bool Finish() override
+	{
+		// Less than the magic size in total, it can only be uncompressed data
+		if (m_encoding == Encoding::Auto)
+		{
+			m_encoding = Encoding::Identity;
+			if (!decode(m_input.data(), m_pending))
+				return false;
+		}
+
+		if (m_encoding != Encoding::Identity && !m_streamEnd)
+			return fail("Compressed data is truncated");
+
+		return m_target.Finish();
+	}
+
+private:
+	Encoding detect(const std::size_t& size) const
+	{
+		if (size >= ZSTD_MAGIC.size() && std::equal(ZSTD_MAGIC.begin(), ZSTD_MAGIC.end(), m_input.begin()))
+			return Encoding::Zstd;
+		if (size >= GZIP_MAGIC.size() && std::equal(GZIP_MAGIC.begin(), GZIP_MAGIC.end(), m_input.begin()))
+			return Encoding::Gzip;
+
+		return Encoding::Identity;
+	}
+
+	bool init()
+	{
+		switch (m_encoding)
+		{
+			case Encoding::Identity:
+				return true;
+#ifdef SU_WITH_ZSTD
+			case Encoding::Zstd:
+				m_pZstd = ZSTD_createDStream();
+				if (m_pZstd == nullptr || ZSTD_isError(ZSTD_initDStream(m_pZstd)))
+					return fail("Failed to initialize zstd");
+				return true;
+#endif
+#ifdef SU_WITH_GZIP
+			case Encoding::Gzip:
+				// 15 + 32: maximum window size with automatic gzip/zlib header detection
+				if (inflateInit2(&m_zlib, 15 + 32) != Z_OK)
+					return fail("Failed to initialize zlib");
+				m_zlibInit = true;
+				return true;
+#endif
+			default:
+				return fail("Encoding is not supported by this build");
+		}
+	}
+
+	bool decode(const uint8_t* pData, const std::size_t& size)
+	{
+		switch (m_encoding)
+		{
+			case Encoding::Identity:
+				return output(pData, size);
+#ifdef SU_WITH_ZSTD
+			case Encoding::Zstd:
+				return decodeZstd(pData, size);
+#endif
+#ifdef SU_WITH_GZIP
+			case Encoding::Gzip:
+				return decodeGzip(pData, size);
+#endif
+			default:
+				return fail("Encoding is not supported by this build");
+		}
+	}
+
+#ifdef SU_WITH_ZSTD
+	bool decodeZstd(const uint8_t* pData, const std::size_t& size)
+	{
+		ZSTD_inBuffer in = { pData, size, 0 };
+
+		// Keep going while there is input left or the last call filled the whole output, i.e., might have more to flush
+		bool outputFull = false;
+		while (in.pos < in.size || outputFull)
+		{
+			std::span<uint8_t> buffer = m_target.Prepare(CHUNK_SIZE);
+			if (buffer.empty())
+				return fail("Target does not accept more data");
+
+			ZSTD_outBuffer out = { buffer.data(), buffer.size(), 0 };
+			const size_t ret   = ZSTD_decompressStream(m_pZstd, &out, &in);
+			if (ZSTD_isError(ret))
+				return fail(ZSTD_getErrorName(ret));
+
+			if (!commitOutput(out.pos))
+				return false;
+
+			// 0 means a frame was completely decoded and flushed, more frames may follow
+			m_streamEnd = (ret == 0);
+			outputFull  = (out.pos == out.size);
+		}
+
+		return true;
+	}
+#endif
+
+#ifdef SU_WITH_GZIP
+	bool decodeGzip(const uint8_t* pData, const std::size_t& size)
+	{
+		m_zlib.next_in  = const_cast<Bytef*>(pData);
+		m_zlib.avail_in = static_cast<uInt>(size);
+
+		// Keep going while there is input left or the last call filled the whole output, i.e., might have more to flush
+		bool outputFull = false;
+		while (m_zlib.avail_in > 0 || outputFull)
+		{
+			// Concatenated members (e.g., from pigz) decompress to the concatenated data, anything else after a member is an error
+			if (m_streamEnd)
+			{
+				if (m_zlib.avail_in == 0)
+					break;
+
+				if (inflateReset(&m_zlib) != Z_OK)
+					return fail("Failed to reset zlib");
+
+				m_streamEnd = false;
+			}
+
+			std::span<uint8_t> buffer = m_target.Prepare(CHUNK_SIZE);
+			if (buffer.empty())
+				return fail("Target does not accept more data");
+
+			m_zlib.next_out  = buffer.data();
+			m_zlib.avail_out = static_cast<uInt>(buffer.size());
+
+			const int ret = inflate(&m_zlib, Z_NO_FLUSH);
+			if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+			{
+				m_target.Commit(0);
+				return fail("Invalid gzip data");
+			}
+
+			const std::size_t produced = buffer.size() - m_zlib.avail_out;
+			if (!commitOutput(produced))
+				return false;
+
+			m_streamEnd = (ret == Z_STREAM_END);
+			outputFull  = (m_zlib.avail_out == 0);
+		}
+
+		return true;
+	}
+#endif
+
+	bool output(const uint8_t* pData, const std::size_t& size)
+	{
+		if (!m_target.Write(pData, size))
+			return fail("Target does not accept more data");
+
+		m_written += size;
+		if (m_outputCb)
+			m_outputCb(m_written, 0);
+
+		return true;
+	}
+
+	bool commitOutput(const std::size_t& size)
+	{
+		if (!m_target.Commit(size))
+			return fail("Target does not accept more data");
+
+		m_written += size;
+		if (m_outputCb && size > 0)
+			m_outputCb(m_written, 0);
+
+		return true;
+	}
+
+	bool fail(const char* pMsg)
+	{
+		if (!m_failed)
+			std::cerr << "[Decompress] " << pMsg << std::endl;
+
+		m_failed = true;
+		return false;
+	}
+
+private:
+	Sink& m_target;
+	Encoding m_encoding;
+	ProgressCallBack m_outputCb;
+
+	std::vector<uint8_t> m_input;
+	std::size_t m_pending = 0;
+	uint64_t m_written    = 0;
+	bool m_streamEnd      = false;
+	bool m_failed         = false;
+
+#ifdef SU_WITH_ZSTD
+	ZSTD_DStream* m_pZstd = nullptr;
+#endif
+#ifdef SU_WITH_GZIP
+	z_stream m_zlib = {};
+	bool m_zlibInit = false;
+#endif
+};
+
+} // namespace selfUpdater::downloader
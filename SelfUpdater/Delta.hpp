@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Hash.hpp"
+#include "Sink.hpp"
+
+// Delta patches describe a target file as a sequence of operations on a source file.
+// All integers are little-endian:
+//
+//   header: "SUDELTA1", u64 source size, u64 target size, u8[32] SHA-256 of the target
+//   ops:    0x01 COPY u64 source offset, u32 length   -> copies bytes of the source
+//           0x02 ADD  u32 length, u8[length]          -> inserts literal bytes
+//           0x00 END
+//
+// The target is written strictly sequentially, so a patch can be applied while it is being downloaded.
+
+namespace selfUpdater::delta
+{
+
+static constexpr std::array<uint8_t, 8> MAGIC = { 'S', 'U', 'D', 'E', 'L', 'T', 'A', '1' };
+
+enum Op : uint8_t
+{
+	OP_END  = 0x00,
+	OP_COPY = 0x01,
+	OP_ADD  = 0x02
+};
+
+class PatchWriter
+{
+public:
+	PatchWriter(std::ostream& out, const uint64_t& sourceSize, const uint64_t& targetSize, const hash::Sha256::Digest& targetHash) :
+		m_out(out)
+	{
+		m_out.write(reinterpret_cast<const char*>(MAGIC.data()), MAGIC.size());
+		writeInt(sourceSize, 8);
+		writeInt(targetSize, 8);
+		m_out.write(reinterpret_cast<const char*>(targetHash.data()), targetHash.size());
+	}
+
+	void Copy(const uint64_t& offset, uint64_t length)
+	{
+		for (uint64_t pos = offset; length > 0;)
+		{
+			const uint32_t chunk = static_cast<uint32_t>((std::min)(length, static_cast<uint64_t>(UINT32_MAX)));
+			m_out.put(static_cast<char>(OP_COPY));
+			writeInt(pos, 8);
+			writeInt(chunk, 4);
+
+			pos += chunk;
+			length -= chunk;
+		}
+	}
+
+	void Add(const uint8_t* pData, uint64_t length)
+	{
+		while (length > 0)
+		{
+			const uint32_t chunk = static_cast<uint32_t>((std::min)(length, static_cast<uint64_t>(UINT32_MAX)));
+			m_out.put(static_cast<char>(OP_ADD));
+			writeInt(chunk, 4);
+			m_out.write(reinterpret_cast<const char*>(pData), chunk);
+
+			pData += chunk;
+			length -= chunk;
+		}
+	}
+
+	bool End()
+	{
+		m_out.put(static_cast<char>(OP_END));
+		m_out.flush();
+		return m_out.good();
+	}
+
+private:
+	void writeInt(const uint64_t& value, const uint32_t& bytes)
+	{
+		for (uint32_t i = 0; i < bytes; i++)
+			m_out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+	}
+
+private:
+	std::ostream& m_out;
+};
+
+// Applies a patch while it is streamed into the sink.
+// The source is read on demand and the target written chunk-wise, so memory usage is independent of the file sizes.
+// Finish() only succeeds if the result has exactly the size and SHA-256 announced by the patch.
+class PatchSink : public downloader::Sink
+{
+	static constexpr size_t CHUNK_SIZE  = 64 * 1024;
+	static constexpr size_t HEADER_SIZE = MAGIC.size() + 8 + 8 + hash::Sha256::DIGEST_SIZE;
+
+	enum class State
+	{
+		Header,
+		Op,
+		CopyArgs,
+		AddLength,
+		AddData,
+		Done,
+		Failed
+	};
+
+public:
+	PatchSink(const std::filesystem::path& sourcePath, const std::filesystem::path& targetPath) :
+		m_source(sourcePath, std::ios::binary),
+		m_target(targetPath, std::ios::binary | std::ios::trunc),
+		m_buffer(CHUNK_SIZE),
+		m_copyBuffer(CHUNK_SIZE)
+	{
+		std::error_code ec;
+		m_sourceSize = std::filesystem::file_size(sourcePath, ec);
+
+		if (!m_source || !m_target || ec)
+			fail("Failed to open the source or target file");
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		return { m_buffer.data(), (std::min)(maxSize, m_buffer.size()) };
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		const uint8_t* pData = m_buffer.data();
+		std::size_t remaining = size;
+
+		while (remaining > 0 && m_state != State::Failed)
+		{
+			if (m_state == State::AddData)
+			{
+				const std::size_t chunk = static_cast<std::size_t>((std::min)(static_cast<uint64_t>(remaining), m_addRemaining));
+				writeTarget(pData, chunk);
+
+				pData += chunk;
+				remaining -= chunk;
+				m_addRemaining -= chunk;
+
+				if (m_addRemaining == 0 && m_state == State::AddData)
+					m_state = State::Op;
+
+				continue;
+			}
+
+			if (m_state == State::Done)
+			{
+				fail("Unexpected data after the end of the patch");
+				break;
+			}
+
+			// Collect the fixed size fields of the current state, they might be split across chunks
+			const std::size_t needed = fieldSize();
+			const std::size_t chunk  = (std::min)(remaining, needed - m_pendingSize);
+			std::memcpy(m_pending.data() + m_pendingSize, pData, chunk);
+
+			m_pendingSize += chunk;
+			pData += chunk;
+			remaining -= chunk;
+
+			if (m_pendingSize == needed)
+			{
+				m_pendingSize = 0;
+				handleField();
+			}
+		}
+
+		return m_state != State::Failed;
+	}
+
+	bool Finish() override
+	{
+		if (m_state != State::Done)
+			return fail("Patch is incomplete");
+
+		if (m_written != m_targetSize)
+			return fail("Patched file has the wrong size");
+
+		if (m_sha.Final() != m_targetHash)
+			return fail("Patched file has the wrong hash");
+
+		m_target.flush();
+		return m_target.good();
+	}
+
+	const uint64_t& TargetSize() const
+	{
+		return m_targetSize;
+	}
+
+	const hash::Sha256::Digest& TargetHash() const
+	{
+		return m_targetHash;
+	}
+
+private:
+	std::size_t fieldSize() const
+	{
+		switch (m_state)
+		{
+			case State::Header:
+				return HEADER_SIZE;
+			case State::CopyArgs:
+				return 12;
+			case State::AddLength:
+				return 4;
+			default:
+				return 1;
+		}
+	}
+
+	void handleField()
+	{
+		switch (m_state)
+		{
+			case State::Header:
+				if (std::memcmp(m_pending.data(), MAGIC.data(), MAGIC.size()) != 0)
+				{
+					fail("Invalid patch header");
+					return;
+				}
+
+				if (readInt(MAGIC.size(), 8) != m_sourceSize)
+				{
+					fail("Patch does not belong to the installed version");
+					return;
+				}
+
+				m_targetSize = readInt(MAGIC.size() + 8, 8);
+				std::memcpy(m_targetHash.data(), m_pending.data() + MAGIC.size() + 16, m_targetHash.size());
+				m_state = State::Op;
+				break;
+			case State::Op:
+				if (m_pending[0] == OP_END)
+					m_state = State::Done;
+				else if (m_pending[0] == OP_COPY)
+					m_state = State::CopyArgs;
+				else if (m_pending[0] == OP_ADD)
+					m_state = State::AddLength;
+				else
+					fail("Invalid patch operation");
+				break;
+			case State::CopyArgs:
+				copySource(readInt(0, 8), readInt(8, 4));
+				if (m_state != State::Failed)
+					m_state = State::Op;
+				break;
+			case State::AddLength:
+				m_addRemaining = readInt(0, 4);
+				m_state        = (m_addRemaining > 0) ? State::AddData : State::Op;
+				break;
+			default:
+				break;
+		}
+	}
+
+	void copySource(const uint64_t& offset, uint64_t length)
+	{
+		if (offset > m_sourceSize || length > m_sourceSize - offset)
+		{
+			fail("Patch references data outside of the source file");
+			return;
+		}
+
+		m_source.seekg(static_cast<std::streamoff>(offset));
+
+		while (length > 0 && m_state != State::Failed)
+		{
+			const std::size_t chunk = static_cast<std::size_t>((std::min)(length, static_cast<uint64_t>(m_copyBuffer.size())));
+			if (!m_source.read(reinterpret_cast<char*>(m_copyBuffer.data()), static_cast<std::streamsize>(chunk)))
+			{
+				fail("Failed to read the source file");
+				return;
+			}
+
+			writeTarget(m_copyBuffer.data(), chunk);
+			length -= chunk;
+		}
+	}
+
+	void writeTarget(const uint8_t* pData, const std::size_t& size)
+	{
+		if (size > m_targetSize - m_written)
+		{
+			fail("Patch produces more data than announced");
+			return;
+		}
+
+		m_target.write(reinterpret_cast<const char*>(pData), static_cast<std::streamsize>(size));
+		if (!m_target)
+		{
+			fail("Failed to write the target file");
+			return;
+		}
+
+		m_sha.Update(pData, size);
+		m_written += size;
+	}
+
+	uint64_t readInt(const std::size_t& pos, const uint32_t& bytes) const
+	{
+		uint64_t value = 0;
+		for (uint32_t i = 0; i < bytes; i++)
+			value |= static_cast<uint64_t>(m_pending[pos + i]) << (8 * i);
+
+		return value;
+	}
+
+	bool fail(const char* pMsg)
+	{
+		if (m_state != State::Failed)
+			std::cerr << "[Delta] " << pMsg << std::endl;
+
+		m_state = State::Failed;
+		return false;
+	}
+
+private:
+	std::ifstream m_source;
+	std::ofstream m_target;
+	std::vector<uint8_t> m_buffer;
+	std::vector<uint8_t> m_copyBuffer;
+
+	State m_state = State::Header;
+	std::array<uint8_t, HEADER_SIZE> m_pending;
+	std::size_t m_pendingSize = 0;
+	uint64_t m_addRemaining   = 0;
+
+	uint64_t m_sourceSize = 0;
+	uint64_t m_targetSize = 0;
+	uint64_t m_written    = 0;
+	hash::Sha256::Digest m_targetHash;
+	hash::Sha256 m_sha;
+};
+
+} // namespace selfUpdater::delta
@@ -1,274 +1,680 @@
 #pragma once
 
-#include <Windows.h>
-#include <Wininet.h>
-#include <atlbase.h> // CComPtr
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
 #include <format>
+#include <fstream>
 #include <functional>
 #include <iostream>
-#include <map>
+#include <mutex>
 #include <string>
-#include <urlmon.h>
+#include <optional>
+#include <stop_token>
+#include <thread>
 #include <vector>
 
+#include "Async.hpp"
+#include "Http.hpp"
+#include "Sink.hpp"
+#include "Throttle.hpp"
+#include "Transport.hpp"
 #include "Utils.hpp"
 
-#pragma comment(lib, "Wininet.lib")
-#pragma comment(lib, "urlmon.lib")
-
 namespace selfUpdater::downloader
 {
 
-using ProgressCallBack = std::function<void(const uint64_t&, const uint64_t&)>;
+enum class DownloadMode
+{
+	Default,
+	Resumable, // Keeps a .part file on failure and continues from it using HTTP Range requests
+	Segmented  // Fetches byte ranges over multiple connections in parallel
+};
 
-class DownloadProgress : public IBindStatusCallback
+// A range of bytes within a resource
+struct Segment
 {
-public:
-	HRESULT STDMETHODCALLTYPE QueryInterface(const IID&, void**)
-	{
-		return E_NOINTERFACE;
-	}
-	ULONG STDMETHODCALLTYPE AddRef(void)
+	uint64_t begin = 0;
+	uint64_t end   = 0; // Exclusive
+};
+
+class Downloader
+{
+	static constexpr size_t READ_SIZE          = 64 * 1024;
+	static constexpr uint32_t RESUME_ATTEMPTS = 3;
+
+	static constexpr uint32_t INITIAL_CONNECTIONS = 2;
+	static constexpr uint32_t MAX_CONNECTIONS     = 8;
+	static constexpr uint64_t MIN_SEGMENT_SIZE    = 1024 * 1024;
+	static constexpr uint64_t MAX_SEGMENT_SIZE    = 16 * 1024 * 1024;
+	static constexpr double CONNECTION_GAIN       = 1.1; // Minimal throughput increase required to keep adding connections
+
+	static constexpr std::chrono::milliseconds SAMPLE_INTERVAL = std::chrono::milliseconds(500);
+
+	static constexpr uint32_t HTTP_OK                    = 200;
+	static constexpr uint32_t HTTP_PARTIAL_CONTENT       = 206;
+	static constexpr uint32_t HTTP_RANGE_NOT_SATISFIABLE = 416;
+
+	inline static const std::wstring PART_SUFFIX  = L".part";
+	inline static const std::wstring STATE_SUFFIX = L".part.state";
+
+	// Information stored next to a .part file, required to safely continue the download
+	struct PartialState
 	{
-		return 1;
-	}
-	ULONG STDMETHODCALLTYPE Release(void)
+		std::wstring url;
+		std::wstring validator; // Strong ETag or Last-Modified of the response the .part file belongs to
+		uint64_t total = 0;
+	};
+
+	// State shared between the workers of a segmented download
+	struct SegmentedState
 	{
-		return 1;
-	}
-	HRESULT STDMETHODCALLTYPE OnStartBinding(DWORD dwReserved, IBinding* pib)
+		std::wstring url;
+		std::wstring validator;
+		std::filesystem::path filePath;
+
+		std::vector<Segment> segments;
+		std::atomic<size_t> next       = 0;
+		std::atomic<uint64_t> received = 0;
+		std::atomic<uint32_t> active   = 0;
+		std::atomic<bool> failed       = false;
+
+		// Notified when a worker exits, so the controller doesn't sleep past the end of the download
+		std::mutex mutex;
+		std::condition_variable cv;
+
+		RateLimiter* pLimiter = nullptr; // Shared by all connections
+	};
+
+	// Writes the body of a range request at the position of its segment, begin is advanced for every byte written
+	class SegmentSink : public Sink
 	{
-		return E_NOTIMPL;
-	}
-	virtual HRESULT STDMETHODCALLTYPE GetPriority(LONG* pnPriority)
+	public:
+		SegmentSink(std::fstream& file, SegmentedState& state, Segment& segment, std::vector<uint8_t>& buffer) :
+			m_file(file),
+			m_state(state),
+			m_segment(segment),
+			m_buffer(buffer)
+		{
+		}
+
+		std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+		{
+			const uint64_t remaining = m_segment.end - m_segment.begin;
+			return { m_buffer.data(), static_cast<size_t>((std::min)({ static_cast<uint64_t>(maxSize), static_cast<uint64_t>(m_buffer.size()), remaining })) };
+		}
+
+		bool Commit(const std::size_t& size) override
+		{
+			if (m_state.failed)
+				return false;
+
+			m_file.seekp(static_cast<std::streamoff>(m_segment.begin));
+			m_file.write(reinterpret_cast<const char*>(m_buffer.data()), static_cast<std::streamsize>(size));
+			if (!m_file)
+			{
+				std::cerr << "Failed to write the downloaded data" << std::endl;
+				m_state.failed = true;
+				return false;
+			}
+
+			m_segment.begin += size;
+			m_state.received += size;
+
+			return true;
+		}
+
+		bool Finish() override
+		{
+			m_file.flush();
+			return static_cast<bool>(m_file);
+		}
+
+	private:
+		std::fstream& m_file;
+		SegmentedState& m_state;
+		Segment& m_segment;
+		std::vector<uint8_t>& m_buffer;
+	};
+
+public:
+	// A throttle makes it a background download that leaves bandwidth to other traffic, see Throttle.hpp
+	static bool DownloadSync(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb = nullptr, const DownloadMode& mode = DownloadMode::Default, const Throttle& throttle = {})
 	{
-		return E_NOTIMPL;
+		std::optional<RateLimiter> limiter;
+		if (throttle.IsEnabled())
+			limiter.emplace(throttle, url);
+
+		RateLimiter* pLimiter = limiter ? &*limiter : nullptr;
+
+		if (mode == DownloadMode::Resumable)
+			return download2FileResumable(url, filePath, cb, pLimiter);
+
+		if (mode == DownloadMode::Segmented)
+			return download2FileSegmented(url, filePath, cb, pLimiter);
+
+		return download2File(url, filePath, cb, pLimiter);
 	}
-	virtual HRESULT STDMETHODCALLTYPE OnLowResource(DWORD reserved)
+
+	static bool DownloadSync(const std::wstring& url, std::vector<uint8_t>& data, Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr)
 	{
-		return S_OK;
+		VectorSink sink(data);
+		return DownloadSync(url, sink, pHeaders, cb);
 	}
-	virtual HRESULT STDMETHODCALLTYPE OnStopBinding(HRESULT hresult, LPCWSTR szError)
+
+	static bool DownloadSync(const std::wstring& url, Sink& sink, Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr, std::stop_token stopToken = {})
 	{
-		return E_NOTIMPL;
+		// Error pages are not passed on to the sink
+		ResponseSink checked([&](const Response& response) -> Sink* {
+			if (response.IsSuccess())
+				return &sink;
+
+			std::wcerr << std::format(L"Download of {} failed with HTTP status {}", url, response.status) << std::endl;
+			return nullptr;
+		});
+
+		Response response;
+		if (!Request(url, checked, response, L"", cb, stopToken))
+			return false;
+
+		if (pHeaders != nullptr)
+			*pHeaders = std::move(response.headers);
+
+		return true;
 	}
-	virtual HRESULT STDMETHODCALLTYPE GetBindInfo(DWORD* grfBINDF, BINDINFO* pbindinfo)
+
+	// Downloads the given byte ranges of the resource into an already existing file, each range is written at its own offset.
+	// All ranges go through the same transport, so the connections are kept alive between the requests.
+	static bool DownloadRanges(const std::wstring& url, const std::vector<Segment>& ranges, const std::wstring& filePath, ProgressCallBack cb = nullptr)
 	{
-		return E_NOTIMPL;
+		if (!std::filesystem::exists(filePath))
+		{
+			std::wcerr << std::format(L"Failed to open {}", filePath) << std::endl;
+			return false;
+		}
+
+		SegmentedState state;
+		state.url      = url;
+		state.segments = ranges;
+		state.filePath = filePath;
+
+		uint64_t total = 0;
+		for (const Segment& range : ranges)
+			total += range.end - range.begin;
+
+		return runSegments(Transport::GetDefault(), state, total, cb);
 	}
-	virtual HRESULT STDMETHODCALLTYPE OnDataAvailable(DWORD grfBSCF, DWORD dwSize, FORMATETC* pformatetc, STGMEDIUM* pstgmed)
+
+	// Performs a single GET request using the default transport, see Transport::Request()
+	static bool Request(const std::wstring& url, Sink& sink, Response& response, const std::wstring& requestHeaders = L"", ProgressCallBack cb = nullptr, std::stop_token stopToken = {})
 	{
-		return E_NOTIMPL;
+		return Transport::GetDefault()->Request(url, sink, response, requestHeaders, cb, std::move(stopToken));
 	}
-	virtual HRESULT STDMETHODCALLTYPE OnObjectAvailable(REFIID riid, IUnknown* punk)
+
+	// Opens the connection to the host of the URL in the background, e.g., while the user decides whether to update
+	static void Preconnect(const std::wstring& url)
 	{
-		return E_NOTIMPL;
+		std::shared_ptr<Transport> pTransport = Transport::GetDefault();
+		std::thread([pTransport, url]() { pTransport->Preconnect(url); }).detach();
 	}
 
-	virtual HRESULT STDMETHODCALLTYPE OnProgress(ULONG ulProgress, ULONG ulProgressMax, ULONG ulStatusCode, LPCWSTR szStatusText)
+private:
+	Downloader() = default;
+
+	static bool download2File(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb, RateLimiter* pLimiter)
 	{
-		// std::cout << std::format("Progress: {}/{} - {}", ulProgress, ulProgressMax, ulStatusCode) << std::endl;
+		bool success = false;
+		{
+			FileSink sink(filePath);
+			if (!sink.IsOpen())
+			{
+				std::wcerr << std::format(L"Failed to open {}", filePath) << std::endl;
+				return false;
+			}
+
+			if (pLimiter != nullptr)
+			{
+				ThrottledSink throttled(sink, *pLimiter);
+				success = DownloadSync(url, throttled, nullptr, cb);
+			}
+			else
+				success = DownloadSync(url, sink, nullptr, cb);
+		}
 
-		if (ulStatusCode == BINDSTATUS_DOWNLOADINGDATA || ulStatusCode == BINDSTATUS_BEGINDOWNLOADDATA || ulStatusCode == BINDSTATUS_ENDDOWNLOADDATA)
+		if (!success)
 		{
-			for (ProgressCallBack& callback : m_callbacks)
-				callback(static_cast<uint64_t>(ulProgress), static_cast<uint64_t>(ulProgressMax));
+			std::error_code ec;
+			std::filesystem::remove(filePath, ec);
 		}
 
-		return S_OK;
+		return success;
 	}
 
-	void AddCallback(ProgressCallBack callback)
+	static bool download2FileResumable(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb, RateLimiter* pLimiter)
 	{
-		if (callback != nullptr)
-			m_callbacks.push_back(callback);
+		for (uint32_t attempt = 0; attempt < RESUME_ATTEMPTS; attempt++)
+		{
+			if (resumeDownload(url, filePath, cb, pLimiter))
+				return true;
+
+			std::wcerr << std::format(L"Download of {} interrupted, attempt {}/{}", url, attempt + 1, RESUME_ATTEMPTS) << std::endl;
+		}
+
+		return false;
 	}
 
-private:
-	std::vector<ProgressCallBack> m_callbacks;
-};
+	static bool resumeDownload(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb, RateLimiter* pLimiter)
+	{
+		const std::wstring partPath  = filePath + PART_SUFFIX;
+		const std::wstring statePath = filePath + STATE_SUFFIX;
+
+		PartialState state;
+		uint64_t offset = 0;
+
+		// Only continue a partial download if it belongs to the same URL and the server gave us something to validate it against
+		if (loadPartialState(statePath, state) && state.url == url && !state.validator.empty() && std::filesystem::exists(partPath))
+			offset = std::filesystem::file_size(partPath);
+
+		std::wstring requestHeaders;
+		if (offset > 0)
+			requestHeaders = std::format(L"Range: bytes={}-\r\nIf-Range: {}\r\n", offset, state.validator);
+
+		std::optional<FileSink> file;
+		uint64_t total = 0;
+		bool complete  = false;
+		bool restart   = false;
+
+		ResponseSink sink([&](const Response& response) -> Sink* {
+			if (response.status == HTTP_RANGE_NOT_SATISFIABLE && offset > 0)
+			{
+				// The current size from "bytes */<size>", the stored total may belong to an older version of the resource
+				const std::wstring_view contentRange = response.headers.Get(L"Content-Range").value_or(L"");
+				const size_t slash                   = contentRange.find(L'/');
+				const uint64_t size                  = (slash != std::wstring_view::npos) ? ParseUInt64(contentRange.substr(slash + 1)) : 0;
+
+				// Everything was already downloaded, the previous attempt just failed before renaming the file
+				if (offset == state.total && (size == 0 || size == offset))
+				{
+					complete = true;
+					return nullptr;
+				}
+
+				// The .part file doesn't fit the resource (e.g., larger than it), it would fail the same way on every attempt
+				std::cerr << "Partial download does not match the resource, restarting the download" << std::endl;
+				removePartial(partPath, statePath);
+				restart = true;
+				return nullptr;
+			}
+
+			if (response.status == HTTP_PARTIAL_CONTENT && offset > 0)
+			{
+				uint64_t start = 0;
+				if (!ParseContentRange(response.headers.Get(L"Content-Range").value_or(L""), start, total) || start != offset)
+				{
+					std::cerr << "Server answered with an unexpected range, restarting the download" << std::endl;
+					removePartial(partPath, statePath);
+					return nullptr;
+				}
+			}
+			else if (response.status == HTTP_OK)
+			{
+				// Either a fresh download or the resource changed (If-Range mismatch), in both cases start from zero
+				offset = 0;
+				total  = ContentLength(response);
+			}
+			else
+			{
+				std::wcerr << std::format(L"Download of {} failed with HTTP status {}", url, response.status) << std::endl;
+				return nullptr;
+			}
+
+			state.url       = url;
+			state.validator = validator(response.headers);
+			state.total     = total;
+
+			if (!state.validator.empty())
+				savePartialState(statePath, state);
+			else
+				std::filesystem::remove(statePath);
+
+			file.emplace(partPath, offset > 0);
+			if (!file->IsOpen())
+			{
+				std::wcerr << std::format(L"Failed to open {}", partPath) << std::endl;
+				return nullptr;
+			}
+
+			return &*file;
+		});
+
+		// Progress includes the data that was already present before this request
+		ProgressCallBack progress = nullptr;
+		if (cb)
+			progress = [&](const uint64_t& received, const uint64_t&) { cb(offset + received, total); };
+
+		// Whatever was written so far stays in the .part file and is picked up by the next attempt
+		Response response;
+		const bool success = request(*Transport::GetDefault(), url, sink, response, requestHeaders, progress, pLimiter);
+		file.reset();
+
+		if (complete)
+			return finishPartial(partPath, statePath, filePath, state.total);
+
+		// Without the .part file no range is requested anymore, so this happens at most once
+		if (restart)
+			return resumeDownload(url, filePath, cb, pLimiter);
+
+		if (!success)
+			return false;
 
-class Downloader
-{
-	inline static const std::wstring USER_AGENT = L"Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:126.0) Gecko/20100101 Firefox/126.0";
+		return finishPartial(partPath, statePath, filePath, total);
+	}
 
-	struct ComInit
+	static bool download2FileSegmented(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb, RateLimiter* pLimiter)
 	{
-		HRESULT hr;
-		ComInit() :
-			hr(::CoInitialize(nullptr))
-		{}
+		std::shared_ptr<Transport> pTransport = Transport::GetDefault();
 
-		~ComInit()
+		SegmentedState state;
+		state.url      = url;
+		state.pLimiter = pLimiter;
+
+		// Probe for range support, the size and the validator using the first byte
+		uint64_t total = 0;
 		{
-			if (SUCCEEDED(hr)) ::CoUninitialize();
+			std::vector<uint8_t> first;
+			VectorSink firstSink(first);
+
+			ResponseSink probe([&](const Response& response) -> Sink* {
+				uint64_t start = 0;
+				if (response.status != HTTP_PARTIAL_CONTENT || !ParseContentRange(response.headers.Get(L"Content-Range").value_or(L""), start, total))
+				{
+					total = 0;
+					return nullptr;
+				}
+
+				state.validator = validator(response.headers);
+				return &firstSink;
+			});
+
+			Response response;
+			pTransport->Request(url, probe, response, L"Range: bytes=0-0\r\n");
 		}
-	};
 
-public:
-	using Headers = std::map<std::wstring, std::wstring>;
+		// Without range support, or for small files, a single connection is the better choice
+		if (total < 2 * MIN_SEGMENT_SIZE)
+			return download2FileResumable(url, filePath, cb, pLimiter);
 
-public:
-	static bool DownloadSync(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb = nullptr)
-	{
-		return download2File(url, filePath, cb);
-	}
+		const std::wstring partPath = filePath + PART_SUFFIX;
 
-	static bool DownloadSync(const std::wstring& url, std::vector<uint8_t>& data, Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr)
-	{
-		return download2Mem(url, data, pHeaders, cb);
-	}
-
-private:
-	Downloader() = default;
-
-	static bool download2File(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb)
-	{
-		DownloadProgress progress;
-		progress.AddCallback(cb);
+		if (!createPreallocatedFile(partPath, total))
+		{
+			std::wcerr << std::format(L"Failed to create {}", partPath) << std::endl;
+			return false;
+		}
 
-		DeleteUrlCacheEntry(url.c_str());
+		state.filePath = partPath;
 
-		HRESULT hr = URLDownloadToFile(NULL, url.c_str(), filePath.c_str(), 0, static_cast<IBindStatusCallback*>(&progress));
+		// Segments are handed out on demand, so faster connections simply take more of them
+		const uint64_t segmentSize = std::clamp(total / (MAX_CONNECTIONS * 4), MIN_SEGMENT_SIZE, MAX_SEGMENT_SIZE);
+		for (uint64_t begin = 0; begin < total; begin += segmentSize)
+			state.segments.push_back({ begin, (std::min)(begin + segmentSize, total) });
 
-		if (FAILED(hr))
+		if (!runSegments(pTransport, state, total, cb))
 		{
-			std::wcerr << std::format(L"Download of {} failed: rc={}", url, hr) << std::endl;
+			std::wcerr << std::format(L"Segmented download of {} failed", url) << std::endl;
+			std::error_code ec;
+			std::filesystem::remove(partPath, ec);
 			return false;
 		}
 
-		return true;
+		return finishPartial(partPath, filePath + STATE_SUFFIX, filePath, total);
 	}
 
-	static bool download2Mem(const std::wstring& url, std::vector<uint8_t>& data, Headers* pHeaders, ProgressCallBack cb)
+	// Runs the workers until all segments are done, returns true if every segment was written completely
+	static bool runSegments(std::shared_ptr<Transport> pTransport, SegmentedState& state, const uint64_t& total, ProgressCallBack cb)
 	{
-		data.clear();
-		ComInit init;
+		std::vector<std::thread> workers;
+		auto addWorker = [&]() {
+			state.active++;
+			workers.emplace_back(segmentWorker, pTransport, std::ref(state));
+		};
+
+		for (uint32_t i = 0; i < (std::min)(INITIAL_CONNECTIONS, static_cast<uint32_t>(state.segments.size())); i++)
+			addWorker();
+
+		// Keep opening connections as long as each one noticeably increases the total throughput,
+		// once the CDN or the local link is saturated more connections only add overhead
+		bool grow           = true;
+		double bestRate     = 0.0;
+		uint64_t lastBytes  = 0;
+		auto lastSampleTime = std::chrono::steady_clock::now();
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(state.mutex);
+				if (state.cv.wait_for(lock, SAMPLE_INTERVAL, [&]() { return state.active == 0; }))
+					break;
+			}
 
-		DownloadProgress progress;
-		progress.AddCallback(cb);
+			const auto now          = std::chrono::steady_clock::now();
+			const uint64_t received = state.received;
+			const double rate       = static_cast<double>(received - lastBytes) / std::chrono::duration<double>(now - lastSampleTime).count();
 
-		DeleteUrlCacheEntry(url.c_str());
+			lastBytes      = received;
+			lastSampleTime = now;
 
-		CComPtr<IStream> pStream;
+			if (cb)
+				cb(received, total);
 
-		HRESULT hr = URLOpenBlockingStreamW(nullptr, url.c_str(), &pStream, 0, static_cast<IBindStatusCallback*>(&progress));
-		if (FAILED(hr))
-		{
-			std::cerr << std::format("ERROR: Could not connect. HRESULT: {:#x}", hr) << std::endl;
-			return false;
+			if (!grow || workers.size() >= MAX_CONNECTIONS || state.next >= state.segments.size())
+				continue;
+
+			if (rate > bestRate * CONNECTION_GAIN)
+			{
+				bestRate = rate;
+				addWorker();
+			}
+			else
+				grow = false;
 		}
 
-		uint8_t buffer[4096];
+		for (std::thread& worker : workers)
+			worker.join();
 
-		do
-		{
-			DWORD bytesRead = 0;
+		if (state.failed || state.received != total)
+			return false;
 
-			hr = pStream->Read(buffer, sizeof(buffer), &bytesRead);
+		if (cb)
+			cb(total, total);
 
-			if (bytesRead > 0)
-				data.insert(data.end(), buffer, buffer + bytesRead);
+		return true;
+	}
 
-		} while (SUCCEEDED(hr) && hr != S_FALSE);
+	static void segmentWorker(std::shared_ptr<Transport> pTransport, SegmentedState& state)
+	{
+		std::vector<uint8_t> buffer(READ_SIZE);
 
-		if (FAILED(hr))
+		// Every worker has its own handle, so the positions of the writes don't interfere
+		std::fstream file(state.filePath, std::ios::in | std::ios::out | std::ios::binary);
+		if (!file)
 		{
-			std::cerr << std::format("ERROR: Download failed. HRESULT: {:#x}", hr) << std::endl;
-			return false;
+			std::wcerr << std::format(L"Failed to open {}", state.filePath.wstring()) << std::endl;
+			state.failed = true;
 		}
 
-		if (pHeaders != nullptr)
-			getResponseHeaders(url, pHeaders);
+		for (size_t i = state.next++; i < state.segments.size() && !state.failed; i = state.next++)
+		{
+			Segment segment = state.segments[i];
+
+			for (uint32_t attempt = 0; segment.begin < segment.end && !state.failed; attempt++)
+			{
+				if (attempt >= RESUME_ATTEMPTS)
+				{
+					state.failed = true;
+					break;
+				}
+
+				fetchSegment(*pTransport, state, file, segment, buffer);
+			}
+		}
 
-		return true;
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.active--;
+		state.cv.notify_all();
 	}
 
-	static ULONG getResourceSize(const std::wstring& url)
+	// Fetches the segment and advances its begin for every byte written, a retry therefore continues where the previous attempt stopped
+	static bool fetchSegment(Transport& transport, SegmentedState& state, std::fstream& file, Segment& segment, std::vector<uint8_t>& buffer)
 	{
+		std::wstring requestHeaders = std::format(L"Range: bytes={}-{}\r\n", segment.begin, segment.end - 1);
+		if (!state.validator.empty())
+			requestHeaders += std::format(L"If-Range: {}\r\n", state.validator);
+
+		SegmentSink segmentSink(file, state, segment, buffer);
+
+		// Anything but the requested range means the resource changed while downloading it, the segments don't fit together anymore
+		ResponseSink sink([&](const Response& response) -> Sink* {
+			uint64_t start = 0;
+			uint64_t total = 0;
+			if (response.status != HTTP_PARTIAL_CONTENT || !ParseContentRange(response.headers.Get(L"Content-Range").value_or(L""), start, total) || start != segment.begin)
+			{
+				std::cerr << "Server did not answer with the requested range, aborting the segmented download" << std::endl;
+				state.failed = true;
+				return nullptr;
+			}
+
+			return &segmentSink;
+		});
+
+		Response response;
+		return request(transport, state.url, sink, response, requestHeaders, nullptr, state.pLimiter);
 	}
 
-	static bool getResponseHeaders(const std::wstring& url, Headers* pHeaders)
+	// Performs the request, throttled if a rate limiter is given
+	static bool request(Transport& transport, const std::wstring& url, Sink& sink, Response& response, const std::wstring& requestHeaders, ProgressCallBack cb, RateLimiter* pLimiter)
 	{
-		pHeaders->clear();
+		if (pLimiter == nullptr)
+			return transport.Request(url, sink, response, requestHeaders, cb);
 
-		HINTERNET hInternet = InternetOpen(USER_AGENT.c_str(), INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
+		ThrottledSink throttled(sink, *pLimiter);
+		return transport.Request(url, throttled, response, requestHeaders, cb);
+	}
 
-		if (hInternet == NULL)
+	// Reserve the full size upfront, this avoids fragmentation and lets every worker write at its own offset
+	static bool createPreallocatedFile(const std::wstring& filePath, const uint64_t& size)
+	{
 		{
-			std::cerr << "Failed to open internet" << std::endl;
-			return false;
+			std::ofstream file(std::filesystem::path(filePath), std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
 		}
 
-		HINTERNET hUrl = InternetOpenUrl(hInternet, url.c_str(), NULL, 0, INTERNET_FLAG_RELOAD, 0);
-		if (hUrl == NULL)
+		std::error_code ec;
+		std::filesystem::resize_file(filePath, size, ec);
+
+		return !ec;
+	}
+
+	static bool finishPartial(const std::wstring& partPath, const std::wstring& statePath, const std::wstring& filePath, const uint64_t& total)
+	{
+		const uint64_t size = std::filesystem::file_size(partPath);
+		if (total != 0 && size != total)
 		{
-			std::cerr << "Failed to open URL" << std::endl;
-			InternetCloseHandle(hInternet);
+			std::cerr << std::format("Size of the joined download does not match: {} != {}", size, total) << std::endl;
+			removePartial(partPath, statePath);
 			return false;
 		}
 
-		// Query for the response header
-		DWORD dwSize = 0;
-		HttpQueryInfo(hUrl, HTTP_QUERY_RAW_HEADERS_CRLF, NULL, &dwSize, NULL);
-
-		std::wstring responseHeader;
-
-		if (GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+		std::error_code ec;
+		std::filesystem::rename(partPath, filePath, ec);
+		if (ec)
 		{
-			responseHeader = std::wstring(dwSize, L'\0');
-			HttpQueryInfo(hUrl, HTTP_QUERY_RAW_HEADERS_CRLF, &responseHeader[0], &dwSize, NULL);
+			std::cerr << std::format("Failed to move the finished download into place: {}", ec.message()) << std::endl;
+			return false;
 		}
 
-		// Query for the content length
-		dwSize = 0;
-		HttpQueryInfo(hUrl, HTTP_QUERY_CONTENT_LENGTH, NULL, &dwSize, NULL);
-
-		std::wstring contentLength;
+		std::filesystem::remove(statePath, ec);
+		return true;
+	}
 
-		if (GetLastError() == ERROR_INSUFFICIENT_BUFFER)
-		{
-			contentLength = std::wstring(dwSize, L'\0');
-			HttpQueryInfo(hUrl, HTTP_QUERY_CONTENT_LENGTH, &contentLength[0], &dwSize, NULL);
-		}
+	static void removePartial(const std::wstring& partPath, const std::wstring& statePath)
+	{
+		std::error_code ec;
+		std::filesystem::remove(partPath, ec);
+		std::filesystem::remove(statePath, ec);
+	}
 
-		InternetCloseHandle(hUrl);
-		InternetCloseHandle(hInternet);
+	static bool loadPartialState(const std::filesystem::path& statePath, PartialState& state)
+	{
+		std::ifstream file(statePath);
+		if (!file)
+			return false;
 
-		// Parse the headers
-		size_t pos = 0;
-		while (pos < responseHeader.size())
-		{
-			size_t end = responseHeader.find(L"\r\n", pos);
-			if (end == std::wstring::npos)
-				break;
+		std::string url, validator, total;
+		if (!std::getline(file, url) || !std::getline(file, validator) || !std::getline(file, total))
+			return false;
 
-			std::wstring line = responseHeader.substr(pos, end - pos);
-			pos               = end + 2;
+		state.url       = utils::s2ws(url);
+		state.validator = utils::s2ws(validator);
+		state.total     = std::strtoull(total.c_str(), nullptr, 10);
 
-			size_t colon = line.find(L":");
-			if (colon == std::wstring::npos)
-				continue;
+		return true;
+	}
 
-			std::wstring key   = line.substr(0, colon);
-			std::wstring value = line.substr(colon + 1);
-			utils::ltrim(value);
+	static void savePartialState(const std::filesystem::path& statePath, const PartialState& state)
+	{
+		std::ofstream file(statePath, std::ios::trunc);
+		file << utils::ws2s(state.url) << '\n'
+			 << utils::ws2s(state.validator) << '\n'
+			 << state.total << '\n';
+	}
 
-			(*pHeaders)[key] = value;
-		}
+	static std::wstring validator(const Headers& headers)
+	{
+		// Weak ETags are not allowed in If-Range, fall back to Last-Modified in that case
+		const std::wstring_view etag = headers.Get(L"ETag").value_or(L"");
+		if (!etag.empty() && !etag.starts_with(L"W/"))
+			return std::wstring(etag);
 
-		return true;
+		return std::wstring(headers.Get(L"Last-Modified").value_or(L""));
 	}
 };
 
-inline bool Download(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb = nullptr)
+inline bool Download(const std::wstring& url, const std::wstring& filePath, ProgressCallBack cb = nullptr, const DownloadMode& mode = DownloadMode::Default, const Throttle& throttle = {})
 {
-	return Downloader::DownloadSync(url, filePath, cb);
+	return Downloader::DownloadSync(url, filePath, cb, mode, throttle);
 }
 
-inline bool Download(const std::wstring& url, std::vector<uint8_t>& data, Downloader::Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr)
+inline bool Download(const std::wstring& url, std::vector<uint8_t>& data, Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr)
 {
 	return Downloader::DownloadSync(url, data, pHeaders, cb);
 }
 
+inline bool Download(const std::wstring& url, Sink& sink, Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr, std::stop_token stopToken = {})
+{
+	return Downloader::DownloadSync(url, sink, pHeaders, cb, std::move(stopToken));
+}
+
+// Awaitable variants, the download blocks a thread of the executor (the shared background threads if none is given)
+// and the awaiting coroutine continues there once it is done. Arguments are taken by value as they outlive the caller's expression.
+inline async::Task<bool> DownloadAsync(std::wstring url, std::wstring filePath, ProgressCallBack cb = nullptr, DownloadMode mode = DownloadMode::Default, std::shared_ptr<async::Executor> pExecutor = nullptr)
+{
+	if (pExecutor == nullptr)
+		pExecutor = async::GetBackgroundExecutor();
+
+	co_return co_await async::Run(*pExecutor, [&]() { return Downloader::DownloadSync(url, filePath, cb, mode); });
+}
+
+// The sink has to stay alive until the task is done, a stop request makes the task end early with false
+inline async::Task<bool> DownloadAsync(std::wstring url, Sink& sink, Headers* pHeaders = nullptr, ProgressCallBack cb = nullptr, std::shared_ptr<async::Executor> pExecutor = nullptr, std::stop_token stopToken = {})
+{
+	if (pExecutor == nullptr)
+		pExecutor = async::GetBackgroundExecutor();
+
+	co_return co_await async::Run(*pExecutor, [&]() { return Downloader::DownloadSync(url, sink, pHeaders, cb, stopToken); });
+}
+
 } // namespace selfUpdater::downloader
\ No newline at end of file
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace selfUpdater::hash
+{
+
+// Incremental SHA-256 (FIPS 180-4)
+class Sha256
+{
+	static constexpr std::array<uint32_t, 64> K = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+
+public:
+	static constexpr size_t DIGEST_SIZE = 32;
+	using Digest                        = std::array<uint8_t, DIGEST_SIZE>;
+
+public:
+	Sha256()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		m_state     = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+		m_length    = 0;
+		m_bufferLen = 0;
+	}
+
+	void Update(const uint8_t* pData, size_t size)
+	{
+		m_length += size;
+
+		if (m_bufferLen > 0)
+		{
+			const size_t chunk = (std::min)(size, m_buffer.size() - m_bufferLen);
+			std::memcpy(m_buffer.data() + m_bufferLen, pData, chunk);
+			m_bufferLen += chunk;
+			pData += chunk;
+			size -= chunk;
+
+			if (m_bufferLen < m_buffer.size())
+				return;
+
+			transform(m_buffer.data());
+			m_bufferLen = 0;
+		}
+
+		for (; size >= m_buffer.size(); pData += m_buffer.size(), size -= m_buffer.size())
+			transform(pData);
+
+		std::memcpy(m_buffer.data(), pData, size);
+		m_bufferLen = size;
+	}
+
+	Digest Final()
+	{
+		const uint64_t bitLength = m_length * 8;
+
+		const uint8_t pad = 0x80;
+		Update(&pad, 1);
+
+		const uint8_t zero = 0;
+		while (m_bufferLen != 56)
+			Update(&zero, 1);
+
+		uint8_t lengthBytes[8];
+		for (int32_t i = 0; i < 8; i++)
+			lengthBytes[i] = static_cast<uint8_t>(bitLength >> (56 - 8 * i));
+
+		Update(lengthBytes, sizeof(lengthBytes));
+
+		Digest digest;
+		for (size_t i = 0; i < m_state.size(); i++)
+		{
+			digest[i * 4 + 0] = static_cast<uint8_t>(m_state[i] >> 24);
+			digest[i * 4 + 1] = static_cast<uint8_t>(m_state[i] >> 16);
+			digest[i * 4 + 2] = static_cast<uint8_t>(m_state[i] >> 8);
+			digest[i * 4 + 3] = static_cast<uint8_t>(m_state[i]);
+		}
+
+		Reset();
+		return digest;
+	}
+
+	static Digest Hash(const uint8_t* pData, const size_t& size)
+	{
+		Sha256 sha;
+		sha.Update(pData, size);
+		return sha.Final();
+	}
+
+private:
+	static constexpr uint32_t rotr(const uint32_t& x, const uint32_t& n)
+	{
+		return (x >> n) | (x << (32 - n));
+	}
+
+	void transform(const uint8_t* pBlock)
+	{
+		uint32_t w[64];
+		for (uint32_t i = 0; i < 16; i++)
+			w[i] = (static_cast<uint32_t>(pBlock[i * 4]) << 24) | (static_cast<uint32_t>(pBlock[i * 4 + 1]) << 16) | (static_cast<uint32_t>(pBlock[i * 4 + 2]) << 8) | static_cast<uint32_t>(pBlock[i * 4 + 3]);
+
+		for (uint32_t i = 16; i < 64; i++)
+		{
+			const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i]              = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+		uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+
+		for (uint32_t i = 0; i < 64; i++)
+		{
+			const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+			const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		m_state[0] += a;
+		m_state[1] += b;
+		m_state[2] += c;
+		m_state[3] += d;
+		m_state[4] += e;
+		m_state[5] += f;
+		m_state[6] += g;
+		m_state[7] += h;
+	}
+
+private:
+	std::array<uint32_t, 8> m_state;
+	std::array<uint8_t, 64> m_buffer;
+	uint64_t m_length  = 0;
+	size_t m_bufferLen = 0;
+};
+
+template<size_t N>
+inline std::string ToHex(const std::array<uint8_t, N>& digest)
+{
+	static constexpr char HEX[] = "0123456789abcdef";
+
+	std::string str(N * 2, '0');
+	for (size_t i = 0; i < N; i++)
+	{
+		str[i * 2]     = HEX[digest[i] >> 4];
+		str[i * 2 + 1] = HEX[digest[i] & 0xF];
+	}
+
+	return str;
+}
+
+template<size_t N>
+inline bool FromHex(std::string_view str, std::array<uint8_t, N>& digest)
+{
+	if (str.size() != N * 2)
+		return false;
+
+	auto nibble = [](const char& c) -> int32_t {
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	};
+
+	for (size_t i = 0; i < N; i++)
+	{
+		const int32_t hi = nibble(str[i * 2]);
+		const int32_t lo = nibble(str[i * 2 + 1]);
+		if (hi < 0 || lo < 0)
+			return false;
+
+		digest[i] = static_cast<uint8_t>((hi << 4) | lo);
+	}
+
+	return true;
+}
+
+} // namespace selfUpdater::hash
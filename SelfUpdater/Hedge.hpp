@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Http.hpp"
+#include "Sink.hpp"
+#include "Transport.hpp"
+
+// Hedged requests for small responses like the version file, whose latency is dominated by the occasional slow connection.
+// If the response takes longer than a percentile of the recent latencies, the same request is sent again on a new
+// connection (or to the next mirror), as it is if the first one fails early. The first one to finish wins and the other
+// one is cancelled.
+// With the default 95th percentile at most about 5% of the requests are sent twice.
+
+namespace selfUpdater::downloader
+{
+
+struct HedgeOptions
+{
+	double percentile                    = 0.95;
+	std::chrono::milliseconds firstDelay = std::chrono::milliseconds(500); // Until enough latencies are known
+	std::chrono::milliseconds minDelay   = std::chrono::milliseconds(10);
+	std::chrono::milliseconds maxDelay   = std::chrono::seconds(5);
+	size_t window                        = 64; // Number of recent latencies the percentile is taken from
+	size_t minSamples                    = 8;
+};
+
+class Hedge
+{
+	struct Attempt
+	{
+		std::stop_source stop;
+		std::vector<uint8_t> data;
+		Response response;
+	};
+
+	// Shared with the request threads, a cancelled request may still run after Request() returned
+	struct State
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		Attempt attempts[2];
+		int32_t winner   = -1;
+		uint32_t started = 0;
+		uint32_t done    = 0;
+	};
+
+public:
+	explicit Hedge(const HedgeOptions& options = {}) :
+		m_options(options)
+	{
+	}
+
+	// How long the first request may take before the second one is sent
+	std::chrono::milliseconds Delay() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_latencies.size() < m_options.minSamples)
+			return m_options.firstDelay;
+
+		std::vector<std::chrono::milliseconds> sorted(m_latencies.begin(), m_latencies.end());
+		const size_t idx = (std::min)(static_cast<size_t>(m_options.percentile * static_cast<double>(sorted.size())), sorted.size() - 1);
+		std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(idx), sorted.end());
+
+		return std::clamp(sorted[idx], m_options.minDelay, m_options.maxDelay);
+	}
+
+	// Like Downloader::Request() into a vector, the second request goes to the next URL (the same one if only one is given)
+	bool Request(const std::vector<std::wstring>& urls, std::vector<uint8_t>& data, Response& response, const std::wstring& requestHeaders = L"")
+	{
+		if (urls.empty())
+			return false;
+
+		std::shared_ptr<State> pState = std::make_shared<State>();
+		const auto delay              = Delay();
+		const auto begin              = std::chrono::steady_clock::now();
+
+		start(pState, 0, urls[0], requestHeaders);
+
+		// The second request is sent once the delay passed, or right away if the first one failed before
+		std::unique_lock<std::mutex> lock(pState->mutex);
+		pState->cv.wait_for(lock, delay, [&]() { return pState->done > 0; });
+		if (pState->winner < 0)
+		{
+			start(pState, 1, urls[1 % urls.size()], requestHeaders);
+			m_hedged++;
+		}
+
+		pState->cv.wait(lock, [&]() { return pState->winner >= 0 || pState->done == pState->started; });
+		m_requests++;
+
+		if (pState->winner < 0)
+		{
+			response = pState->attempts[0].response;
+			return false;
+		}
+
+		for (Attempt& attempt : pState->attempts)
+			attempt.stop.request_stop();
+
+		Attempt& winner = pState->attempts[pState->winner];
+		data            = std::move(winner.data);
+		response        = std::move(winner.response);
+
+		if (pState->winner > 0)
+			m_hedgeWins++;
+
+		// Measured from the start of the first request, a hedge that wins doesn't hide how slow the first one was
+		addLatency(std::chrono::steady_clock::now() - begin);
+
+		return true;
+	}
+
+	uint64_t Requests() const
+	{
+		return m_requests;
+	}
+
+	// Requests that were sent a second time
+	uint64_t Hedged() const
+	{
+		return m_hedged;
+	}
+
+	// Requests where the second one finished first
+	uint64_t HedgeWins() const
+	{
+		return m_hedgeWins;
+	}
+
+private:
+	// The transport is kept alive by the request thread, it may be replaced in the meantime
+	static void start(std::shared_ptr<State> pState, const uint32_t& idx, const std::wstring& url, const std::wstring& requestHeaders)
+	{
+		pState->started++;
+
+		std::thread([pState, idx, url, requestHeaders, pTransport = Transport::GetDefault()]() {
+			Attempt& attempt = pState->attempts[idx];
+
+			std::vector<uint8_t> data;
+			VectorSink sink(data);
+			Response response;
+
+			const bool success = pTransport->Request(url, sink, response, requestHeaders, nullptr, attempt.stop.get_token());
+
+			std::lock_guard<std::mutex> lock(pState->mutex);
+			attempt.data     = std::move(data);
+			attempt.response = std::move(response);
+
+			pState->done++;
+			if (success && pState->winner < 0)
+				pState->winner = static_cast<int32_t>(idx);
+
+			pState->cv.notify_all();
+		}).detach();
+	}
+
+	void addLatency(const std::chrono::steady_clock::duration& latency)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_latencies.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(latency));
+		while (m_latencies.size() > m_options.window)
+			m_latencies.pop_front();
+	}
+
+private:
+	HedgeOptions m_options;
+
+	mutable std::mutex m_mutex;
+	std::deque<std::chrono::milliseconds> m_latencies;
+
+	std::atomic<uint64_t> m_requests  = 0;
+	std::atomic<uint64_t> m_hedged    = 0;
+	std::atomic<uint64_t> m_hedgeWins = 0;
+};
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace selfUpdater::downloader
+{
+
+// Header fields of a response.
+// The raw header block is stored once, the fields only keep offsets into it, so parsing doesn't allocate per line
+// and the object stays valid when copied or moved.
+class Headers
+{
+	struct Field
+	{
+		uint32_t nameBegin;
+		uint32_t nameSize;
+		uint32_t valueBegin;
+		uint32_t valueSize;
+	};
+
+public:
+	using Entry = std::pair<std::wstring_view, std::wstring_view>;
+
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type        = Entry;
+		using difference_type   = std::ptrdiff_t;
+		using pointer           = void;
+		using reference         = Entry;
+
+		Iterator(const Headers* pHeaders, const size_t& idx) :
+			m_pHeaders(pHeaders), m_idx(idx)
+		{
+		}
+
+		Entry operator*() const
+		{
+			return m_pHeaders->at(m_idx);
+		}
+
+		Iterator& operator++()
+		{
+			m_idx++;
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator it = *this;
+			m_idx++;
+			return it;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return m_idx == other.m_idx;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return m_idx != other.m_idx;
+		}
+
+	private:
+		const Headers* m_pHeaders;
+		size_t m_idx;
+	};
+
+public:
+	Headers() = default;
+
+	explicit Headers(std::wstring raw)
+	{
+		Parse(std::move(raw));
+	}
+
+	// Takes a CRLF (or LF) separated header block, the first line without a colon is treated as status line
+	void Parse(std::wstring raw)
+	{
+		clear();
+		m_raw = std::move(raw);
+
+		const std::wstring_view view = m_raw;
+		size_t pos                   = 0;
+
+		while (pos < view.size())
+		{
+			size_t end = view.find(L'\n', pos);
+			if (end == std::wstring_view::npos)
+				end = view.size();
+
+			size_t lineEnd = end;
+			if (lineEnd > pos && view[lineEnd - 1] == L'\r')
+				lineEnd--;
+
+			const size_t colon = view.find(L':', pos);
+			if (colon < lineEnd)
+			{
+				size_t valueBegin = colon + 1;
+				while (valueBegin < lineEnd && (view[valueBegin] == L' ' || view[valueBegin] == L'\t'))
+					valueBegin++;
+
+				size_t valueEnd = lineEnd;
+				while (valueEnd > valueBegin && (view[valueEnd - 1] == L' ' || view[valueEnd - 1] == L'\t'))
+					valueEnd--;
+
+				m_fields.push_back({ static_cast<uint32_t>(pos), static_cast<uint32_t>(colon - pos), static_cast<uint32_t>(valueBegin), static_cast<uint32_t>(valueEnd - valueBegin) });
+			}
+			else if (m_fields.empty() && m_statusSize == 0 && lineEnd > pos)
+			{
+				m_statusBegin = static_cast<uint32_t>(pos);
+				m_statusSize  = static_cast<uint32_t>(lineEnd - pos);
+			}
+
+			pos = end + 1;
+		}
+	}
+
+	void clear()
+	{
+		m_raw.clear();
+		m_fields.clear();
+		m_statusBegin = 0;
+		m_statusSize  = 0;
+	}
+
+	bool empty() const
+	{
+		return m_fields.empty();
+	}
+
+	size_t size() const
+	{
+		return m_fields.size();
+	}
+
+	Entry at(const size_t& idx) const
+	{
+		const Field& f = m_fields.at(idx);
+		return { view(f.nameBegin, f.nameSize), view(f.valueBegin, f.valueSize) };
+	}
+
+	Iterator begin() const
+	{
+		return Iterator(this, 0);
+	}
+
+	Iterator end() const
+	{
+		return Iterator(this, m_fields.size());
+	}
+
+	// Returns the value of the first field with the given name, names are compared case-insensitive
+	std::optional<std::wstring_view> Get(std::wstring_view name) const
+	{
+		for (const Field& f : m_fields)
+		{
+			if (equalsIgnoreCase(view(f.nameBegin, f.nameSize), name))
+				return view(f.valueBegin, f.valueSize);
+		}
+
+		return std::nullopt;
+	}
+
+	bool Contains(std::wstring_view name) const
+	{
+		return Get(name).has_value();
+	}
+
+	std::wstring_view StatusLine() const
+	{
+		return view(m_statusBegin, m_statusSize);
+	}
+
+	const std::wstring& Raw() const
+	{
+		return m_raw;
+	}
+
+private:
+	std::wstring_view view(const uint32_t& begin, const uint32_t& size) const
+	{
+		return std::wstring_view(m_raw).substr(begin, size);
+	}
+
+	static bool equalsIgnoreCase(std::wstring_view a, std::wstring_view b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		// Header names are plain ASCII
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			const wchar_t ca = (a[i] >= L'A' && a[i] <= L'Z') ? a[i] + (L'a' - L'A') : a[i];
+			const wchar_t cb = (b[i] >= L'A' && b[i] <= L'Z') ? b[i] + (L'a' - L'A') : b[i];
+			if (ca != cb)
+				return false;
+		}
+
+		return true;
+	}
+
+private:
+	std::wstring m_raw;
+	std::vector<Field> m_fields;
+	uint32_t m_statusBegin = 0;
+	uint32_t m_statusSize  = 0;
+};
+
+struct Response
+{
+	uint32_t status = 0;
+	Headers headers;
+
+	bool IsSuccess() const
+	{
+		return status >= 200 && status < 300;
+	}
+};
+
+inline uint64_t ParseUInt64(std::wstring_view str)
+{
+	uint64_t value = 0;
+	for (const wchar_t& c : str)
+	{
+		if (c < L'0' || c > L'9')
+			break;
+
+		value = value * 10 + static_cast<uint64_t>(c - L'0');
+	}
+
+	return value;
+}
+
+// 0 if the response has no Content-Length
+inline uint64_t ContentLength(const Response& response)
+{
+	return ParseUInt64(response.headers.Get(L"Content-Length").value_or(L""));
+}
+
+// Parses "bytes <start>-<end>/<total>", the total may be "*" if unknown
+inline bool ParseContentRange(std::wstring_view contentRange, uint64_t& start, uint64_t& total)
+{
+	const size_t unitEnd = contentRange.find(L' ');
+	const size_t dash    = contentRange.find(L'-', unitEnd);
+	const size_t slash   = contentRange.find(L'/', dash);
+	if (unitEnd == std::wstring_view::npos || dash == std::wstring_view::npos || slash == std::wstring_view::npos)
+		return false;
+
+	start = ParseUInt64(contentRange.substr(unitEnd + 1, dash - unitEnd - 1));
+	total = ParseUInt64(contentRange.substr(slash + 1)); // "*" yields 0
+
+	return true;
+}
+
+// Retry-After is either a number of seconds or an HTTP date (IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT"), a date is converted relative to now
+inline std::optional<std::chrono::seconds> ParseRetryAfter(std::wstring_view value, const std::chrono::system_clock::time_point& now = std::chrono::system_clock::now())
+{
+	auto number = [](std::wstring_view str, uint32_t& result) {
+		result = 0;
+		for (const wchar_t& c : str)
+		{
+			if (c < L'0' || c > L'9')
+				return false;
+
+			result = result * 10 + static_cast<uint32_t>(c - L'0');
+		}
+
+		return !str.empty();
+	};
+
+	uint32_t seconds = 0;
+	if (number(value, seconds))
+		return std::chrono::seconds(seconds);
+
+	// Everything after the day name has a fixed layout: "06 Nov 1994 08:49:37 GMT"
+	const size_t comma = value.find(L", ");
+	if (comma == std::wstring_view::npos || value.size() - comma - 2 != 24 || !value.ends_with(L" GMT"))
+		return std::nullopt;
+
+	const std::wstring_view date       = value.substr(comma + 2);
+	constexpr std::wstring_view MONTHS = L"JanFebMarAprMayJunJulAugSepOctNovDec";
+
+	const size_t month = MONTHS.find(date.substr(3, 3));
+	uint32_t day = 0, year = 0, hour = 0, minute = 0, second = 0;
+
+	if (month == std::wstring_view::npos || month % 3 != 0 || !number(date.substr(0, 2), day) || !number(date.substr(7, 4), year) || !number(date.substr(12, 2), hour) || !number(date.substr(15, 2), minute) || !number(date.substr(18, 2), second))
+		return std::nullopt;
+
+	const std::chrono::year_month_day ymd(std::chrono::year(static_cast<int>(year)), std::chrono::month(static_cast<uint32_t>(month / 3 + 1)), std::chrono::day(day));
+	if (!ymd.ok())
+		return std::nullopt;
+
+	const std::chrono::system_clock::time_point at = std::chrono::sys_days(ymd) + std::chrono::hours(hour) + std::chrono::minutes(minute) + std::chrono::seconds(second);
+
+	return (at > now) ? std::chrono::ceil<std::chrono::seconds>(at - now) : std::chrono::seconds(0);
+}
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,721 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Constraint.hpp"
+#include "Decompress.hpp"
+#include "Hash.hpp"
+#include "Utils.hpp"
+#include "Version.hpp"
+
+// The version file lists one executable per line:
+//   <name><TAB><version>[-<prerelease>][<TAB><key>=<value>]...
+// Empty lines and lines starting with '#' are ignored.
+// An executable can be listed multiple times (e.g., for different channels), the newest entry the installed version
+// is allowed to update to is used. Prerelease versions (e.g., 1.3.0-rc.1) are older than the release with the same number
+// and are never offered on the stable channel. An installed prerelease is offered the later prereleases and the release
+// of its version, its tag is given to the UpdateSelector.
+//
+// Known attributes:
+//   patch=<from version>:<file>  Delta patch (relative to the base URL) from the given version to this one, can be given multiple times
+//   payload=<encoding>:<file>    Compressed variant (zstd or gzip) of the full binary, can be given multiple times
+//   size=<bytes>                 Size of the binary
+//   sha256=<hex>                 SHA-256 of the binary, every download is verified against it before it is used
+//   channel=<name>[,<name>]...   Channels the entry is published on, without it the entry is on every channel
+//   requires=<range>             Only installed versions in the range may update to this entry, see Constraint.hpp
+//   blocked=<range>              Installed versions in the range must not update to this entry, can be given multiple times
+//   check-interval=<seconds>     Minimal time between two scheduled checks of clients listed in this line, see Scheduler.hpp
+//   rollout=<percent>            Share of the installations the entry is offered to (staged rollout), e.g., 12.5
+//   rollout-start=<time>         Start of the rollout as Unix time or UTC date (2024-05-01 or 2024-05-01T12:00:00Z)
+//   rollout-ramp=<duration>      The share grows linearly from 0 at the start to the rollout percentage, e.g., 86400, 12h or 3d
+//
+// Whether an installation is part of a rollout is decided from a hash of its installation ID and the version of the entry,
+// so the decision is stable across checks and every release starts with a different group of installations.
+// Installations that are not part of the rollout yet get the newest entry that is (if any). A rollout value that can't be
+// parsed stops the entry from being offered at all.
+//
+// Unknown attributes are ignored, so the file stays readable by older versions of the updater.
+// Older versions ignore channel=, requires= and blocked= as well, prerelease lines are skipped by them as invalid.
+
+namespace selfUpdater::manifest
+{
+
+struct Patch
+{
+	version::ResVersion from;
+	std::wstring file;
+};
+
+struct Payload
+{
+	downloader::Encoding encoding;
+	std::wstring file;
+};
+
+inline constexpr std::string_view STABLE_CHANNEL = "stable";
+
+// Share of the installations an entry is offered to, optionally ramped up over time
+struct Rollout
+{
+	static constexpr uint32_t BUCKETS = 10000; // 0.01% steps
+
+	double percent = 100.0;
+	std::optional<std::chrono::sys_seconds> start;
+	std::chrono::seconds ramp = std::chrono::seconds(0);
+	bool invalid              = false; // A rollout attribute couldn't be parsed, independent of the others the entry isn't offered
+
+	double PercentAt(const std::chrono::system_clock::time_point& now) const
+	{
+		if (invalid)
+			return 0.0;
+
+		if (!start)
+			return percent;
+
+		if (now < *start)
+			return 0.0;
+
+		if (ramp.count() <= 0 || now >= *start + ramp)
+			return percent;
+
+		return percent * std::chrono::duration<double>(now - *start).count() / std::chrono::duration<double>(ramp).count();
+	}
+
+	bool Includes(const uint32_t& bucket, const std::chrono::system_clock::time_point& now) const
+	{
+		return bucket < PercentAt(now) * (BUCKETS / 100);
+	}
+
+	// Position of the installation in the rollout of a version, uniformly distributed over [0, BUCKETS).
+	// All four parts of the version are hashed, so a release that only changes the build gets a different group.
+	static uint32_t Bucket(std::string_view installationId, const version::ResVersion& version, std::string_view prerelease)
+	{
+		const std::string key             = std::string(installationId) + '/' + std::to_string(version.Key()) + '-' + std::string(prerelease);
+		const hash::Sha256::Digest digest = hash::Sha256::Hash(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+
+		uint64_t value = 0;
+		for (size_t i = 0; i < sizeof(value); i++)
+			value = (value << 8) | digest[i];
+
+		return static_cast<uint32_t>(value % BUCKETS);
+	}
+};
+
+struct Entry
+{
+	version::ResVersion version;
+	std::string prerelease;
+	std::vector<Patch> patches;
+	std::vector<Payload> payloads;
+	std::optional<uint64_t> size;
+	std::optional<hash::Sha256::Digest> sha256;
+	std::vector<std::string> channels;
+	version::VersionRange allowed = version::VersionRange::All(); // requires= without the blocked= ranges
+	std::optional<uint32_t> checkInterval;                        // Seconds
+	std::optional<Rollout> rollout;
+
+	bool IsOnChannel(std::string_view channel) const
+	{
+		if (!prerelease.empty() && channel == STABLE_CHANNEL)
+			return false;
+
+		return channels.empty() || std::find(channels.begin(), channels.end(), channel) != channels.end();
+	}
+
+	// True if the installed version may update to this entry on the given channel, e.g., 1.3.0-rc.1 to 1.3.0-rc.2 or 1.3.0
+	bool IsUpdateFor(const version::ResVersion& installed, std::string_view channel, std::string_view installedPrerelease = {}) const
+	{
+		const bool newer = (version != installed) ? (version > installed) : (version::ComparePrerelease(prerelease, installedPrerelease) > 0);
+		return newer && IsOnChannel(channel) && allowed.Contains(installed);
+	}
+
+	// Without an installation ID only entries that are fully rolled out are taken
+	bool IsRolledOutTo(std::string_view installationId, const std::chrono::system_clock::time_point& now) const
+	{
+		if (!rollout)
+			return true;
+
+		if (installationId.empty())
+			return rollout->PercentAt(now) >= 100.0;
+
+		return rollout->Includes(Rollout::Bucket(installationId, version, prerelease), now);
+	}
+
+	bool IsNewerThan(const Entry& other) const
+	{
+		if (version != other.version)
+			return version > other.version;
+
+		return version::ComparePrerelease(prerelease, other.prerelease) > 0;
+	}
+
+	// True if the binary matches the size and hash given in the version file (if any)
+	bool Verify(const uint64_t& binarySize, const hash::Sha256::Digest& binaryHash) const
+	{
+		return (!size || *size == binarySize) && (!sha256 || *sha256 == binaryHash);
+	}
+
+	const Patch* FindPatch(const version::ResVersion& from) const
+	{
+		for (const Patch& patch : patches)
+		{
+			if (patch.from == from)
+				return &patch;
+		}
+
+		return nullptr;
+	}
+
+	// First payload this build is able to decode, in the order of the version file
+	const Payload* FindPayload() const
+	{
+		for (const Payload& payload : payloads)
+		{
+			if (downloader::IsEncodingSupported(payload.encoding))
+				return &payload;
+		}
+
+		return nullptr;
+	}
+};
+
+// All entries per name, in the order of the version file
+using Manifest = std::map<std::wstring, std::vector<Entry>>;
+
+// Splits a string_view lazily at a delimiter, the fields are views into the original string
+class Tokenizer
+{
+public:
+	class Iterator
+	{
+	public:
+		using value_type        = std::string_view;
+		using difference_type   = std::ptrdiff_t;
+		using iterator_category = std::forward_iterator_tag;
+
+		Iterator() = default;
+		Iterator(std::string_view rest, const char& delimiter) :
+			m_rest(rest),
+			m_delimiter(delimiter),
+			m_done(false)
+		{
+			advance();
+		}
+
+		std::string_view operator*() const
+		{
+			return m_current;
+		}
+
+		Iterator& operator++()
+		{
+			advance();
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator it = *this;
+			advance();
+			return it;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return m_done == other.m_done && (m_done || m_rest.data() == other.m_rest.data());
+		}
+
+	private:
+		void advance()
+		{
+			if (m_last)
+			{
+				m_done = true;
+				return;
+			}
+
+			const size_t pos = m_rest.find(m_delimiter);
+			m_current        = m_rest.substr(0, pos);
+			m_last           = (pos == std::string_view::npos);
+			m_rest           = m_last ? std::string_view() : m_rest.substr(pos + 1);
+		}
+
+	private:
+		std::string_view m_rest;
+		std::string_view m_current;
+		char m_delimiter = '\0';
+		bool m_last      = false;
+		bool m_done      = true;
+	};
+
+public:
+	Tokenizer(std::string_view str, const char& delimiter) :
+		m_str(str),
+		m_delimiter(delimiter)
+	{
+	}
+
+	Iterator begin() const
+	{
+		return Iterator(m_str, m_delimiter);
+	}
+
+	Iterator end() const
+	{
+		return Iterator();
+	}
+
+private:
+	std::string_view m_str;
+	char m_delimiter;
+};
+
+// Unix time or an UTC date: 2024-05-01, 2024-05-01T12:00Z or 2024-05-01T12:00:00Z
+inline bool ParseTime(std::string_view str, std::chrono::sys_seconds& time)
+{
+	int64_t seconds     = 0;
+	const auto [p, err] = std::from_chars(str.data(), str.data() + str.size(), seconds);
+	if (err == std::errc() && p == str.data() + str.size())
+	{
+		time = std::chrono::sys_seconds(std::chrono::seconds(seconds));
+		return true;
+	}
+
+	if (str.ends_with('Z'))
+		str.remove_suffix(1);
+
+	// Fields in the order of the format with the character that precedes them
+	uint32_t fields[6]               = {};
+	constexpr char SEPARATORS[]      = { '\0', '-', '-', 'T', ':', ':' };
+	constexpr size_t REQUIRED_FIELDS = 3;
+	size_t count                     = 0;
+
+	for (; count < 6 && !str.empty(); count++)
+	{
+		if (count > 0)
+		{
+			if (str.front() != SEPARATORS[count])
+				return false;
+
+			str.remove_prefix(1);
+		}
+
+		const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), fields[count]);
+		if (ec != std::errc())
+			return false;
+
+		str.remove_prefix(static_cast<size_t>(end - str.data()));
+	}
+
+	// A time needs at least hours and minutes
+	if (!str.empty() || count < REQUIRED_FIELDS || count == 4)
+		return false;
+
+	const std::chrono::year_month_day date(std::chrono::year(static_cast<int>(fields[0])), std::chrono::month(fields[1]), std::chrono::day(fields[2]));
+	if (!date.ok() || fields[3] > 23 || fields[4] > 59 || fields[5] > 60)
+		return false;
+
+	time = std::chrono::sys_days(date) + std::chrono::hours(fields[3]) + std::chrono::minutes(fields[4]) + std::chrono::seconds(fields[5]);
+	return true;
+}
+
+// Seconds with an optional unit: 90, 90s, 15m, 12h, 3d
+inline bool ParseDuration(std::string_view str, std::chrono::seconds& duration)
+{
+	uint64_t value      = 0;
+	const auto [p, err] = std::from_chars(str.data(), str.data() + str.size(), value);
+	if (err != std::errc())
+		return false;
+
+	const std::string_view unit = str.substr(static_cast<size_t>(p - str.data()));
+
+	if (unit.empty() || unit == "s")
+		duration = std::chrono::seconds(value);
+	else if (unit == "m")
+		duration = std::chrono::minutes(value);
+	else if (unit == "h")
+		duration = std::chrono::hours(value);
+	else if (unit == "d")
+		duration = std::chrono::hours(24 * value);
+	else
+		return false;
+
+	return true;
+}
+
+inline void ParseAttribute(Entry& entry, std::string_view key, std::string_view value)
+{
+	if (key == "patch")
+	{
+		const size_t colon = value.find(':');
+		if (colon == std::string_view::npos)
+			return;
+
+		Patch patch;
+		patch.from = version::ResVersion(value.substr(0, colon));
+		patch.file = utils::s2ws(std::string(value.substr(colon + 1)));
+
+		if (patch.from && !patch.file.empty())
+			entry.patches.push_back(patch);
+	}
+	else if (key == "payload")
+	{
+		const size_t colon = value.find(':');
+		if (colon == std::string_view::npos)
+			return;
+
+		Payload payload;
+		payload.encoding = downloader::ParseEncoding(value.substr(0, colon));
+		payload.file     = utils::s2ws(std::string(value.substr(colon + 1)));
+
+		if (payload.encoding != downloader::Encoding::Identity && payload.encoding != downloader::Encoding::Auto && !payload.file.empty())
+			entry.payloads.push_back(payload);
+	}
+	else if (key == "size")
+	{
+		uint64_t size       = 0;
+		const auto [p, err] = std::from_chars(value.data(), value.data() + value.size(), size);
+		if (err == std::errc() && p == value.data() + value.size())
+			entry.size = size;
+	}
+	else if (key == "sha256")
+	{
+		hash::Sha256::Digest digest;
+		if (hash::FromHex(value, digest))
+			entry.sha256 = digest;
+	}
+	else if (key == "channel")
+	{
+		for (const std::string_view channel : Tokenizer(value, ','))
+		{
+			if (!channel.empty())
+				entry.channels.emplace_back(channel);
+		}
+	}
+	else if (key == "requires" || key == "blocked")
+	{
+		// A range that can't be parsed blocks the entry, ignoring it could offer the update to versions it must not reach
+		version::VersionRange range;
+		if (!version::VersionRange::Parse(value, range))
+			entry.allowed = version::VersionRange();
+		else
+			entry.allowed = entry.allowed.Intersect(key == "requires" ? range : range.Complement());
+	}
+	else if (key == "prerelease")
+		entry.prerelease = value;
+	else if (key == "check-interval")
+	{
+		uint32_t seconds    = 0;
+		const auto [p, err] = std::from_chars(value.data(), value.data() + value.size(), seconds);
+		if (err == std::errc() && p == value.data() + value.size())
+			entry.checkInterval = seconds;
+	}
+	else if (key.starts_with("rollout"))
+	{
+		Rollout& rollout = entry.rollout ? *entry.rollout : entry.rollout.emplace();
+
+		bool valid = true;
+		if (key == "rollout")
+		{
+			const auto [p, err] = std::from_chars(value.data(), value.data() + value.size(), rollout.percent);
+			valid               = (err == std::errc() && p == value.data() + value.size() && rollout.percent >= 0.0 && rollout.percent <= 100.0);
+		}
+		else if (key == "rollout-start")
+		{
+			std::chrono::sys_seconds start;
+			valid = ParseTime(value, start);
+			if (valid)
+				rollout.start = start;
+		}
+		else if (key == "rollout-ramp")
+			valid = ParseDuration(value, rollout.ramp);
+
+		// Offering a broken rollout to everyone is worse than offering it to no one
+		if (!valid)
+			rollout.invalid = true;
+	}
+}
+
+// Attributes as stored in a line: <key>=<value> separated by tabs
+inline void ParseAttributes(Entry& entry, std::string_view attributes)
+{
+	if (attributes.empty())
+		return;
+
+	for (const std::string_view attr : Tokenizer(attributes, '\t'))
+	{
+		const size_t eq = attr.find('=');
+		if (eq != std::string_view::npos)
+			ParseAttribute(entry, attr.substr(0, eq), attr.substr(eq + 1));
+	}
+}
+
+struct ParseError
+{
+	uint32_t line;
+	const char* pMessage;
+};
+
+// A single entry of the text format, all views point into the parsed data
+struct Line
+{
+	uint32_t number;
+	std::string_view name;
+	std::string_view attributes;
+	std::string_view prerelease;
+	version::ResVersion version;
+};
+
+// Prerelease tags are dot separated identifiers of ASCII letters, digits and hyphens
+inline bool IsValidPrerelease(std::string_view tag)
+{
+	if (tag.empty() || tag.front() == '.' || tag.back() == '.' || tag.find("..") != std::string_view::npos)
+		return false;
+
+	return std::all_of(tag.begin(), tag.end(), [](const char& c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '.'; });
+}
+
+// Single pass over the text format without copying it.
+// Handles LF and CRLF line endings, a UTF-8 BOM, empty lines and lines starting with '#' (comments).
+// Malformed lines are skipped and recorded with their line number.
+class Parser
+{
+public:
+	explicit Parser(std::string_view data) :
+		m_rest(data)
+	{
+		if (m_rest.starts_with("\xEF\xBB\xBF"))
+			m_rest.remove_prefix(3);
+	}
+
+	bool Next(Line& line)
+	{
+		while (!m_rest.empty())
+		{
+			const size_t eol     = m_rest.find('\n');
+			std::string_view str = m_rest.substr(0, eol);
+			m_rest               = (eol == std::string_view::npos) ? std::string_view() : m_rest.substr(eol + 1);
+			m_lineNumber++;
+
+			// Trailing whitespace includes the '\r' of CRLF
+			while (!str.empty() && (str.back() == '\r' || str.back() == ' ' || str.back() == '\t'))
+				str.remove_suffix(1);
+
+			if (str.empty() || str.front() == '#')
+				continue;
+
+			const size_t nameEnd = str.find('\t');
+			if (nameEnd == std::string_view::npos || nameEnd == 0)
+			{
+				error("Expected <name><TAB><version>");
+				continue;
+			}
+
+			const size_t versionEnd     = str.find('\t', nameEnd + 1);
+			std::string_view versionStr = str.substr(nameEnd + 1, versionEnd == std::string_view::npos ? std::string_view::npos : versionEnd - nameEnd - 1);
+
+			const size_t dash = versionStr.find('-');
+			line.prerelease   = (dash == std::string_view::npos) ? std::string_view() : versionStr.substr(dash + 1);
+			versionStr        = versionStr.substr(0, dash);
+
+			if (!version::ResVersion::Parse(versionStr, line.version) || (dash != std::string_view::npos && !IsValidPrerelease(line.prerelease)))
+			{
+				error("Invalid version");
+				continue;
+			}
+
+			line.number     = m_lineNumber;
+			line.name       = str.substr(0, nameEnd);
+			line.attributes = (versionEnd == std::string_view::npos) ? std::string_view() : str.substr(versionEnd + 1);
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// Only allocates if there are errors
+	const std::vector<ParseError>& Errors() const
+	{
+		return m_errors;
+	}
+
+private:
+	void error(const char* pMessage)
+	{
+		m_errors.push_back({ m_lineNumber, pMessage });
+	}
+
+private:
+	std::string_view m_rest;
+	uint32_t m_lineNumber = 0;
+	std::vector<ParseError> m_errors;
+};
+
+inline std::string_view AsText(const std::vector<uint8_t>& data)
+{
+	return { reinterpret_cast<const char*>(data.data()), data.size() };
+}
+
+// Looks up a single entry without building the whole manifest, if a name is listed twice the last entry wins
+inline bool FindEntry(std::string_view data, std::string_view name, Entry& entry, std::vector<ParseError>* pErrors = nullptr)
+{
+	Parser parser(data);
+	Line line;
+	std::optional<Line> found;
+
+	while (parser.Next(line))
+	{
+		if (line.name == name)
+			found = line;
+	}
+
+	if (pErrors != nullptr)
+		*pErrors = parser.Errors();
+
+	if (!found)
+		return false;
+
+	entry            = Entry();
+	entry.version    = found->version;
+	entry.prerelease = found->prerelease;
+	ParseAttributes(entry, found->attributes);
+
+	return true;
+}
+
+// Keeps the newest entry the installed version may update to, the entries of all formats are passed to Offer
+class UpdateSelector
+{
+public:
+	UpdateSelector(const version::ResVersion& installed, std::string_view channel, std::string_view installationId = {}, const std::chrono::system_clock::time_point& now = std::chrono::system_clock::now()) :
+		m_installed(installed),
+		m_channel(channel),
+		m_installationId(installationId),
+		m_now(now)
+	{
+	}
+
+	// The prerelease tag of the installed version, empty for a release
+	void SetInstalledPrerelease(std::string_view prerelease)
+	{
+		m_installedPrerelease = prerelease;
+	}
+
+	void Offer(Entry&& entry)
+	{
+		m_listed = true;
+
+		// Applies independent of the version, the longest interval of all lines wins
+		if (entry.checkInterval)
+			m_checkInterval = (std::max)(m_checkInterval.value_or(0), *entry.checkInterval);
+
+		if (!entry.IsUpdateFor(m_installed, m_channel, m_installedPrerelease))
+			return;
+
+		if (!entry.IsRolledOutTo(m_installationId, m_now))
+		{
+			m_heldBack = true;
+			return;
+		}
+
+		if (!m_best || entry.IsNewerThan(*m_best))
+			m_best = std::move(entry);
+	}
+
+	// True if any entry was offered, even if none of them is an update
+	bool IsListed() const
+	{
+		return m_listed;
+	}
+
+	const std::optional<Entry>& Best() const
+	{
+		return m_best;
+	}
+
+	// True if an update was skipped because its rollout doesn't include this installation yet
+	bool IsHeldBack() const
+	{
+		return m_heldBack;
+	}
+
+	// Minimal interval between scheduled checks requested by the version file, in seconds
+	const std::optional<uint32_t>& CheckInterval() const
+	{
+		return m_checkInterval;
+	}
+
+private:
+	version::ResVersion m_installed;
+	std::string m_installedPrerelease;
+	std::string m_channel;
+	std::string m_installationId;
+	std::chrono::system_clock::time_point m_now;
+	std::optional<Entry> m_best;
+	std::optional<uint32_t> m_checkInterval;
+	bool m_listed   = false;
+	bool m_heldBack = false;
+};
+
+// Offers all entries for the name to the selector, the attributes are only parsed for the matching lines
+inline void SelectUpdate(std::string_view data, std::string_view name, UpdateSelector& selector, std::vector<ParseError>* pErrors = nullptr)
+{
+	Parser parser(data);
+	Line line;
+
+	while (parser.Next(line))
+	{
+		if (line.name != name)
+			continue;
+
+		Entry entry;
+		entry.version    = line.version;
+		entry.prerelease = line.prerelease;
+		ParseAttributes(entry, line.attributes);
+
+		selector.Offer(std::move(entry));
+	}
+
+	if (pErrors != nullptr)
+		*pErrors = parser.Errors();
+}
+
+inline Manifest Parse(std::string_view data, std::vector<ParseError>* pErrors = nullptr)
+{
+	Manifest manifest;
+	Parser parser(data);
+	Line line;
+
+	while (parser.Next(line))
+	{
+		Entry entry;
+		entry.version    = line.version;
+		entry.prerelease = line.prerelease;
+		ParseAttributes(entry, line.attributes);
+
+		manifest[utils::s2ws(std::string(line.name))].push_back(std::move(entry));
+	}
+
+	if (pErrors != nullptr)
+		*pErrors = parser.Errors();
+
+	return manifest;
+}
+
+inline Manifest Parse(const std::vector<uint8_t>& data)
+{
+	return Parse(AsText(data));
+}
+
+} // namespace selfUpdater::manifest
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace selfUpdater::utils
+{
+
+// Read-only memory mapping of a whole file, the pages are loaded by the OS on access instead of being copied
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::filesystem::path& filePath)
+	{
+		open(filePath);
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile&)            = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool IsOpen() const
+	{
+		return m_isOpen;
+	}
+
+	const uint8_t* Data() const
+	{
+		return m_pData;
+	}
+
+	const uint64_t& Size() const
+	{
+		return m_size;
+	}
+
+	std::span<const uint8_t> Span() const
+	{
+		return { m_pData, static_cast<size_t>(m_size) };
+	}
+
+private:
+#ifdef _WIN32
+	void open(const std::filesystem::path& filePath)
+	{
+		m_hFile = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (m_hFile == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_hFile, &size))
+			return;
+
+		m_size = static_cast<uint64_t>(size.QuadPart);
+
+		// Empty files can't be mapped
+		if (m_size == 0)
+		{
+			m_isOpen = true;
+			return;
+		}
+
+		m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_hMapping == NULL)
+			return;
+
+		m_pData  = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+		m_isOpen = (m_pData != nullptr);
+	}
+
+	void close()
+	{
+		if (m_pData != nullptr)
+			UnmapViewOfFile(m_pData);
+		if (m_hMapping != NULL)
+			CloseHandle(m_hMapping);
+		if (m_hFile != INVALID_HANDLE_VALUE)
+			CloseHandle(m_hFile);
+	}
+#else
+	void open(const std::filesystem::path& filePath)
+	{
+		m_fd = ::open(filePath.c_str(), O_RDONLY);
+		if (m_fd < 0)
+			return;
+
+		struct stat st;
+		if (fstat(m_fd, &st) != 0)
+			return;
+
+		m_size = static_cast<uint64_t>(st.st_size);
+
+		if (m_size == 0)
+		{
+			m_isOpen = true;
+			return;
+		}
+
+		void* pData = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+		if (pData == MAP_FAILED)
+			return;
+
+		// The file is usually read in parallel from several places, so ask for read-ahead of everything
+		madvise(pData, static_cast<size_t>(m_size), MADV_WILLNEED);
+
+		m_pData  = static_cast<const uint8_t*>(pData);
+		m_isOpen = true;
+	}
+
+	void close()
+	{
+		if (m_pData != nullptr)
+			munmap(const_cast<uint8_t*>(m_pData), static_cast<size_t>(m_size));
+		if (m_fd >= 0)
+			::close(m_fd);
+	}
+#endif
+
+private:
+	const uint8_t* m_pData = nullptr;
+	uint64_t m_size        = 0;
+	bool m_isOpen          = false;
+
+#ifdef _WIN32
+	HANDLE m_hFile    = INVALID_HANDLE_VALUE;
+	HANDLE m_hMapping = NULL;
+#else
+	int m_fd = -1;
+#endif
+};
+
+} // namespace selfUpdater::utils
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Downloader.hpp"
+#include "Http.hpp"
+#include "Sink.hpp"
+#include "Utils.hpp"
+
+// A list of base URLs serving the same files.
+// Every request reports its latency and throughput, the mirrors are ranked by the expected time to fetch a reference size
+// (divided by their weight). Mirrors that failed recently are moved to the end for a cool down that grows with every failure.
+// Download() fails over to the next mirror on errors and if the current one gets much slower than expected, the data
+// received so far is kept and the next mirror continues with a Range request.
+// Mirrors serve different ETags for the same file, so the continuation can't use If-Range. Verify the result
+// (e.g., with the SHA-256 of the version file) when using more than one mirror.
+
+namespace selfUpdater::downloader
+{
+
+class Mirrors
+{
+	static constexpr double EWMA_ALPHA              = 0.3;
+	static constexpr uint64_t REFERENCE_SIZE        = 4 * 1024 * 1024; // Size the mirrors are ranked for
+	static constexpr uint64_t MIN_THROUGHPUT_BYTES  = 64 * 1024;       // Smaller transfers only tell the latency
+	static constexpr double DEGRADED_FRACTION       = 0.2;             // Fail over below this share of the expected throughput
+	static constexpr uint32_t DEGRADED_WINDOWS      = 2;
+	static constexpr std::chrono::seconds WINDOW    = std::chrono::seconds(2);
+	static constexpr std::chrono::seconds COOL_DOWN = std::chrono::seconds(60);
+	static constexpr std::chrono::hours MAX_COOL_DOWN = std::chrono::hours(1);
+
+	static constexpr uint32_t HTTP_PARTIAL_CONTENT = 206;
+
+	struct Mirror
+	{
+		std::wstring baseUrl;
+		double weight = 1.0;
+
+		double rtt        = 0.0; // Seconds, 0 if unknown
+		double throughput = 0.0; // Bytes per second, 0 if unknown
+		uint32_t failures = 0;   // Consecutive
+		std::chrono::system_clock::time_point lastFailure;
+	};
+
+	// Forwards to the target and resumes at the already written offset, detects a degraded mirror while receiving
+	class FailoverSink : public Sink
+	{
+	public:
+		FailoverSink(Sink& target, uint64_t& written, const double& minRate) :
+			m_target(target),
+			m_written(written),
+			m_minRate(minRate),
+			m_windowStart(std::chrono::steady_clock::now())
+		{
+		}
+
+		bool OnResponse(const Response& response) override
+		{
+			uint64_t start = 0;
+			uint64_t total = 0;
+
+			if (m_written > 0 && response.status == HTTP_PARTIAL_CONTENT)
+			{
+				if (!ParseContentRange(response.headers.Get(L"Content-Range").value_or(L""), start, total) || start != m_written)
+					return false;
+			}
+			else if (response.IsSuccess())
+				m_skip = m_written; // The mirror ignored the range, skip what we already have
+			else
+				return false;
+
+			// The target only sees the first response
+			return m_written > 0 || m_target.OnResponse(response);
+		}
+
+		void OnSizeHint(const uint64_t& size) override
+		{
+			if (m_written == 0)
+				m_target.OnSizeHint(size);
+		}
+
+		std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+		{
+			m_skipping = (m_skip > 0);
+			if (m_skipping)
+			{
+				m_discard.resize((std::min)({ maxSize, static_cast<size_t>(m_skip), READ_SIZE }));
+				return m_discard;
+			}
+
+			return m_target.Prepare(maxSize);
+		}
+
+		bool Commit(const std::size_t& size) override
+		{
+			if (m_skipping)
+			{
+				m_skip -= size;
+				return true;
+			}
+
+			if (!m_target.Commit(size))
+				return false;
+
+			m_written += size;
+			m_windowBytes += size;
+
+			return !isDegraded();
+		}
+
+		bool Finish() override
+		{
+			return m_target.Finish();
+		}
+
+		bool IsDegraded() const
+		{
+			return m_degraded;
+		}
+
+	private:
+		bool isDegraded()
+		{
+			const auto now     = std::chrono::steady_clock::now();
+			const auto elapsed = now - m_windowStart;
+			if (m_minRate <= 0.0 || elapsed < WINDOW)
+				return false;
+
+			const double rate = static_cast<double>(m_windowBytes) / std::chrono::duration<double>(elapsed).count();
+			m_slowWindows     = (rate < m_minRate) ? m_slowWindows + 1 : 0;
+			m_windowBytes     = 0;
+			m_windowStart     = now;
+			m_degraded        = (m_slowWindows >= DEGRADED_WINDOWS);
+
+			return m_degraded;
+		}
+
+	private:
+		static constexpr size_t READ_SIZE = 64 * 1024;
+
+		Sink& m_target;
+		uint64_t& m_written;
+		double m_minRate;
+
+		uint64_t m_skip = 0;
+		bool m_skipping = false;
+		std::vector<uint8_t> m_discard;
+
+		std::chrono::steady_clock::time_point m_windowStart;
+		uint64_t m_windowBytes  = 0;
+		uint32_t m_slowWindows  = 0;
+		bool m_degraded         = false;
+	};
+
+public:
+	void Add(const std::wstring& baseUrl, const double& weight = 1.0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Mirror mirror;
+		mirror.baseUrl = baseUrl;
+		mirror.weight  = (weight > 0.0) ? weight : 1.0;
+		m_mirrors.push_back(mirror);
+	}
+
+	bool IsEmpty() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_mirrors.empty();
+	}
+
+	size_t Size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_mirrors.size();
+	}
+
+	std::wstring BaseUrl(const size_t& idx) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_mirrors.at(idx).baseUrl;
+	}
+
+	// Indices of the mirrors, best first. Mirrors without measurements keep their order behind the measured ones.
+	std::vector<size_t> Order() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const auto now = std::chrono::system_clock::now();
+
+		// A mirror without a sample of a metric is assumed to be as bad as the worst one that has it,
+		// otherwise serving a payload once would rank a mirror behind all that never did
+		double worstRtt        = 0.0;
+		double worstThroughput = 0.0;
+		for (const Mirror& mirror : m_mirrors)
+		{
+			worstRtt = (std::max)(worstRtt, mirror.rtt);
+			if (mirror.throughput > 0.0)
+				worstThroughput = (worstThroughput > 0.0) ? (std::min)(worstThroughput, mirror.throughput) : mirror.throughput;
+		}
+
+		std::vector<size_t> order(m_mirrors.size());
+		std::iota(order.begin(), order.end(), 0);
+
+		std::stable_sort(order.begin(), order.end(), [&](const size_t& a, const size_t& b) {
+			const bool coolingA = isCoolingDown(m_mirrors[a], now);
+			const bool coolingB = isCoolingDown(m_mirrors[b], now);
+			if (coolingA != coolingB)
+				return coolingB;
+
+			return cost(m_mirrors[a], worstRtt, worstThroughput) < cost(m_mirrors[b], worstRtt, worstThroughput);
+		});
+
+		return order;
+	}
+
+	// Base URL of the best mirror, empty if there are no mirrors
+	std::wstring Best() const
+	{
+		const std::vector<size_t> order = Order();
+		return order.empty() ? std::wstring() : BaseUrl(order.front());
+	}
+
+	// True until every mirror was measured at least once
+	bool NeedsProbe() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return std::any_of(m_mirrors.begin(), m_mirrors.end(), [](const Mirror& mirror) { return mirror.rtt == 0.0 && mirror.throughput == 0.0 && mirror.failures == 0; });
+	}
+
+	void ReportSuccess(const size_t& idx, const uint64_t& bytes, const std::chrono::steady_clock::duration& elapsed)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Mirror& mirror        = m_mirrors.at(idx);
+		const double seconds  = (std::max)(std::chrono::duration<double>(elapsed).count(), 1e-6);
+		mirror.failures       = 0;
+
+		if (bytes < MIN_THROUGHPUT_BYTES)
+			mirror.rtt = ewma(mirror.rtt, seconds);
+		else
+			mirror.throughput = ewma(mirror.throughput, static_cast<double>(bytes) / seconds);
+	}
+
+	void ReportFailure(const size_t& idx)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Mirror& mirror     = m_mirrors.at(idx);
+		mirror.lastFailure = std::chrono::system_clock::now();
+		mirror.failures++;
+	}
+
+	// Fetches the path from all mirrors in parallel to measure them, e.g., with the version file
+	void Probe(const std::wstring& path)
+	{
+		std::vector<std::thread> probes;
+
+		for (size_t idx = 0; idx < Size(); idx++)
+		{
+			probes.emplace_back([this, idx, url = std::format(L"{}/{}", BaseUrl(idx), path)]() {
+				std::vector<uint8_t> data;
+				VectorSink sink(data);
+				Response response;
+
+				const auto start = std::chrono::steady_clock::now();
+				if (Downloader::Request(url, sink, response) && response.IsSuccess())
+					ReportSuccess(idx, data.size(), std::chrono::steady_clock::now() - start);
+				else
+					ReportFailure(idx);
+			});
+		}
+
+		for (std::thread& probe : probes)
+			probe.join();
+	}
+
+	// Downloads base URL/path into the sink, failing over to the next mirror on errors or if the current one degrades
+	bool Download(const std::wstring& path, Sink& sink, ProgressCallBack cb = nullptr)
+	{
+		const std::vector<size_t> order = Order();
+		uint64_t written                = 0;
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const size_t idx       = order[i];
+			const std::wstring url = std::format(L"{}/{}", BaseUrl(idx), path);
+
+			// Only give up on a slow mirror if there is another one to continue with
+			const double minRate = (i + 1 < order.size()) ? DEGRADED_FRACTION * expectedThroughput(idx) : 0.0;
+
+			FailoverSink failover(sink, written, minRate);
+			const std::wstring requestHeaders = (written > 0) ? std::format(L"Range: bytes={}-\r\n", written) : L"";
+
+			ProgressCallBack progress = nullptr;
+			if (cb)
+				progress = [&, offset = written](const uint64_t& received, const uint64_t& total) { cb(offset + received, total > 0 ? offset + total : 0); };
+
+			const uint64_t before = written;
+			const auto start      = std::chrono::steady_clock::now();
+
+			Response response;
+			if (Downloader::Request(url, failover, response, requestHeaders, progress) && !failover.IsDegraded())
+			{
+				ReportSuccess(idx, written - before, std::chrono::steady_clock::now() - start);
+				return true;
+			}
+
+			ReportFailure(idx);
+
+			if (failover.IsDegraded())
+				std::wcerr << std::format(L"Mirror {} got too slow, continuing at {} bytes with the next one", BaseUrl(idx), written) << std::endl;
+			else
+				std::wcerr << std::format(L"Download from mirror {} failed (HTTP status {})", BaseUrl(idx), response.status) << std::endl;
+		}
+
+		return false;
+	}
+
+	// Stats are stored per base URL, mirrors that are not configured anymore are dropped
+	bool Load(const std::filesystem::path& filePath)
+	{
+		std::ifstream file(filePath);
+		if (!file)
+			return false;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			// <url>\t<rtt>\t<throughput>\t<failures>\t<last failure, Unix time>
+			std::vector<std::string> fields;
+			std::istringstream stream(line);
+			for (std::string field; std::getline(stream, field, '\t');)
+				fields.push_back(field);
+
+			if (fields.size() != 5)
+				continue;
+
+			for (Mirror& mirror : m_mirrors)
+			{
+				if (utils::ws2s(mirror.baseUrl) != fields[0])
+					continue;
+
+				mirror.rtt         = std::strtod(fields[1].c_str(), nullptr);
+				mirror.throughput  = std::strtod(fields[2].c_str(), nullptr);
+				mirror.failures    = static_cast<uint32_t>(std::strtoul(fields[3].c_str(), nullptr, 10));
+				mirror.lastFailure = std::chrono::system_clock::time_point(std::chrono::seconds(std::strtoll(fields[4].c_str(), nullptr, 10)));
+			}
+		}
+
+		return true;
+	}
+
+	bool Save(const std::filesystem::path& filePath) const
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(filePath.parent_path(), ec);
+
+		std::ofstream file(filePath, std::ios::trunc);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const Mirror& mirror : m_mirrors)
+			file << std::format("{}\t{}\t{}\t{}\t{}\n", utils::ws2s(mirror.baseUrl), mirror.rtt, mirror.throughput, mirror.failures, std::chrono::duration_cast<std::chrono::seconds>(mirror.lastFailure.time_since_epoch()).count());
+
+		return file.good();
+	}
+
+private:
+	double expectedThroughput(const size_t& idx) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_mirrors.at(idx).throughput;
+	}
+
+	// Expected seconds to fetch the reference size, unknown mirrors come last.
+	// Missing samples are replaced by the worst known ones, a metric no mirror has a sample for is left out.
+	static double cost(const Mirror& mirror, const double& worstRtt, const double& worstThroughput)
+	{
+		if (mirror.rtt == 0.0 && mirror.throughput == 0.0)
+			return std::numeric_limits<double>::infinity();
+
+		const double rtt        = (mirror.rtt > 0.0) ? mirror.rtt : worstRtt;
+		const double throughput = (mirror.throughput > 0.0) ? mirror.throughput : worstThroughput;
+		const double transfer   = (throughput > 0.0) ? static_cast<double>(REFERENCE_SIZE) / throughput : 0.0;
+		return (rtt + transfer) / mirror.weight;
+	}
+
+	static bool isCoolingDown(const Mirror& mirror, const std::chrono::system_clock::time_point& now)
+	{
+		if (mirror.failures == 0)
+			return false;
+
+		const auto coolDown = (std::min)(std::chrono::duration_cast<std::chrono::seconds>(COOL_DOWN * std::pow(2.0, (std::min)(mirror.failures - 1, 16u))), std::chrono::duration_cast<std::chrono::seconds>(MAX_COOL_DOWN));
+		return now - mirror.lastFailure < coolDown;
+	}
+
+	static double ewma(const double& current, const double& sample)
+	{
+		return (current == 0.0) ? sample : current + EWMA_ALPHA * (sample - current);
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::vector<Mirror> m_mirrors;
+};
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+#include "MappedFile.hpp"
+
+// Reads VS_FIXEDFILEINFO straight from the resources of a PE image (exe/dll), without any Windows API.
+// The file is mapped and only the headers, the resource directory and the version resource are touched.
+
+namespace selfUpdater::version
+{
+
+struct FixedFileInfo
+{
+	uint32_t fileVersionMS;
+	uint32_t fileVersionLS;
+	uint32_t productVersionMS;
+	uint32_t productVersionLS;
+};
+
+class PeReader
+{
+	static constexpr uint16_t MZ_SIGNATURE          = 0x5A4D;
+	static constexpr uint32_t PE_SIGNATURE          = 0x00004550;
+	static constexpr uint16_t PE32_MAGIC            = 0x10B;
+	static constexpr uint16_t PE32_PLUS_MAGIC       = 0x20B;
+	static constexpr uint32_t RESOURCE_DIRECTORY    = 2;
+	static constexpr uint32_t RT_VERSION_ID         = 16;
+	static constexpr uint32_t SUBDIRECTORY_FLAG     = 0x80000000;
+	static constexpr uint32_t FIXED_INFO_SIGNATURE  = 0xFEEF04BD;
+	static constexpr uint64_t FIXED_INFO_SIZE       = 52;
+	static constexpr size_t SECTION_HEADER_SIZE     = 40;
+	static constexpr size_t VS_VERSION_INFO_KEY_LEN = 16; // "VS_VERSION_INFO" including the terminator, in UTF-16 characters
+
+public:
+	explicit PeReader(std::span<const uint8_t> image) :
+		m_image(image)
+	{
+	}
+
+	bool ReadFixedFileInfo(FixedFileInfo& info)
+	{
+		uint32_t resourceRva = 0;
+		if (!findResourceDirectory(resourceRva))
+			return false;
+
+		uint64_t resourceBase = 0;
+		if (!rvaToOffset(resourceRva, resourceBase))
+			return false;
+
+		// Resource tree: type -> name -> language, the first name and language are used like GetFileVersionInfo does
+		uint64_t entry = 0;
+		if (!findEntry(resourceBase, resourceBase, RT_VERSION_ID, true, entry))
+			return false;
+
+		for (uint32_t level = 0; level < 2; level++)
+		{
+			if (!findEntry(resourceBase, entry, 0, false, entry))
+				return false;
+		}
+
+		// Leaf: IMAGE_RESOURCE_DATA_ENTRY with the RVA and size of the data
+		uint64_t data = 0;
+		if (!has(entry, 8) || !rvaToOffset(u32(entry), data))
+			return false;
+
+		const uint64_t size = u32(entry + 4);
+		if (!has(data, size))
+			return false;
+
+		return parseVersionInfo(data, size, info);
+	}
+
+private:
+	bool findResourceDirectory(uint32_t& rva)
+	{
+		if (!has(0, 0x40) || u16(0) != MZ_SIGNATURE)
+			return false;
+
+		const uint64_t pe = u32(0x3C);
+		if (!has(pe, 24) || u32(pe) != PE_SIGNATURE)
+			return false;
+
+		const uint64_t coff           = pe + 4;
+		const uint16_t sectionCount   = u16(coff + 2);
+		const uint16_t optionalSize   = u16(coff + 16);
+		const uint64_t optional       = coff + 20;
+		const uint64_t sectionHeaders = optional + optionalSize;
+
+		if (!has(optional, 2))
+			return false;
+
+		// The data directories start at a different offset for 32 and 64 bit images
+		uint64_t directories = 0;
+		uint64_t countField  = 0;
+		switch (u16(optional))
+		{
+			case PE32_MAGIC:
+				countField  = optional + 92;
+				directories = optional + 96;
+				break;
+			case PE32_PLUS_MAGIC:
+				countField  = optional + 108;
+				directories = optional + 112;
+				break;
+			default:
+				return false;
+		}
+
+		if (!has(countField, 4) || u32(countField) <= RESOURCE_DIRECTORY)
+			return false;
+
+		const uint64_t resource = directories + RESOURCE_DIRECTORY * 8;
+		if (resource + 8 > sectionHeaders || !has(resource, 8))
+			return false;
+
+		m_sections     = sectionHeaders;
+		m_sectionCount = sectionCount;
+		rva            = u32(resource);
+
+		return rva != 0;
+	}
+
+	bool rvaToOffset(const uint32_t& rva, uint64_t& offset) const
+	{
+		for (uint32_t i = 0; i < m_sectionCount; i++)
+		{
+			const uint64_t section = m_sections + i * SECTION_HEADER_SIZE;
+			if (!has(section, SECTION_HEADER_SIZE))
+				return false;
+
+			const uint32_t virtualSize    = u32(section + 8);
+			const uint32_t virtualAddress = u32(section + 12);
+			const uint32_t rawSize        = u32(section + 16);
+			const uint32_t rawPointer     = u32(section + 20);
+
+			if (rva >= virtualAddress && rva - virtualAddress < (std::max)(virtualSize, rawSize))
+			{
+				// Parts of a section beyond its raw data are zero filled in memory and not present in the file
+				if (rva - virtualAddress >= rawSize)
+					return false;
+
+				offset = static_cast<uint64_t>(rawPointer) + (rva - virtualAddress);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Searches an IMAGE_RESOURCE_DIRECTORY for an ID (or takes the first entry), result is the file offset of the subdirectory or data entry
+	bool findEntry(const uint64_t& base, const uint64_t& directory, const uint32_t& id, const bool& matchId, uint64_t& result) const
+	{
+		if (!has(directory, 16))
+			return false;
+
+		const uint32_t count = static_cast<uint32_t>(u16(directory + 12)) + u16(directory + 14);
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint64_t entry = directory + 16 + i * 8;
+			if (!has(entry, 8))
+				return false;
+
+			const uint32_t name   = u32(entry);
+			const uint32_t target = u32(entry + 4);
+
+			// Named entries (high bit set) come first and can't match an ID
+			if (matchId && ((name & SUBDIRECTORY_FLAG) != 0 || name != id))
+				continue;
+
+			// Offsets are relative to the start of the resource section, only the language level points to a data entry
+			result = base + (target & ~SUBDIRECTORY_FLAG);
+			return true;
+		}
+
+		return false;
+	}
+
+	// VS_VERSIONINFO: u16 length, u16 value length, u16 type, L"VS_VERSION_INFO", padding to 32 bit, VS_FIXEDFILEINFO
+	bool parseVersionInfo(const uint64_t& data, const uint64_t& size, FixedFileInfo& info) const
+	{
+		const uint64_t value = data + ((6 + VS_VERSION_INFO_KEY_LEN * 2 + 3) & ~static_cast<uint64_t>(3));
+
+		if (value + FIXED_INFO_SIZE > data + size || u16(data + 2) < FIXED_INFO_SIZE || u32(value) != FIXED_INFO_SIGNATURE)
+			return false;
+
+		info.fileVersionMS    = u32(value + 8);
+		info.fileVersionLS    = u32(value + 12);
+		info.productVersionMS = u32(value + 16);
+		info.productVersionLS = u32(value + 20);
+
+		return true;
+	}
+
+	bool has(const uint64_t& offset, const uint64_t& size) const
+	{
+		return offset <= m_image.size() && size <= m_image.size() - offset;
+	}
+
+	uint16_t u16(const uint64_t& offset) const
+	{
+		return static_cast<uint16_t>(m_image[offset] | (m_image[offset + 1] << 8));
+	}
+
+	uint32_t u32(const uint64_t& offset) const
+	{
+		return static_cast<uint32_t>(m_image[offset]) | (static_cast<uint32_t>(m_image[offset + 1]) << 8) | (static_cast<uint32_t>(m_image[offset + 2]) << 16) | (static_cast<uint32_t>(m_image[offset + 3]) << 24);
+	}
+
+private:
+	std::span<const uint8_t> m_image;
+	uint64_t m_sections     = 0;
+	uint32_t m_sectionCount = 0;
+};
+
+inline bool ReadFixedFileInfo(const std::filesystem::path& filePath, FixedFileInfo& info)
+{
+	utils::MappedFile file(filePath);
+	if (!file.IsOpen())
+		return false;
+
+	return PeReader(file.Span()).ReadFixedFileInfo(info);
+}
+
+} // namespace selfUpdater::version
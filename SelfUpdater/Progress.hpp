@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+#include "Sink.hpp"
+
+// Progress of any number of concurrent downloads, delivered to the subscribers at a fixed rate.
+// The download threads only add to atomic counters through the callback of Track(), they never take a lock or wait for
+// a subscriber. A single reporter thread reads the counters, derives the throughput and the ETA and calls the subscribers
+// with a snapshot whenever something changed, at most once per interval.
+
+namespace selfUpdater::downloader
+{
+
+class ProgressAggregator
+{
+	static constexpr double RATE_ALPHA = 0.3; // Smoothing of the throughput
+
+	// Shared with the sources, a callback may outlive the aggregator
+	struct Counters
+	{
+		std::atomic<uint64_t> bytes  = 0;
+		std::atomic<uint64_t> total  = 0;
+		std::atomic<uint32_t> active = 0;
+	};
+
+	// One download, the deltas of its callback are added to the counters
+	class Source
+	{
+	public:
+		explicit Source(std::shared_ptr<Counters> pCounters) :
+			m_pCounters(std::move(pCounters))
+		{
+			m_pCounters->active++;
+		}
+
+		// A download that didn't complete is taken out again, e.g., a failed attempt before a fallback
+		~Source()
+		{
+			if (m_total > 0 && m_received < m_total)
+			{
+				m_pCounters->bytes -= m_received;
+				m_pCounters->total -= m_total;
+			}
+
+			m_pCounters->active--;
+		}
+
+		Source(const Source&)            = delete;
+		Source& operator=(const Source&) = delete;
+
+		// Progress may go backwards (a restarted download), the unsigned arithmetic wraps around to the right result
+		void Update(const uint64_t& received, const uint64_t& total)
+		{
+			m_pCounters->bytes += received - m_received;
+			m_pCounters->total += total - m_total;
+
+			m_received = received;
+			m_total    = total;
+		}
+
+	private:
+		std::shared_ptr<Counters> m_pCounters;
+		uint64_t m_received = 0;
+		uint64_t m_total    = 0; // 0 if unknown
+	};
+
+public:
+	struct Snapshot
+	{
+		uint64_t bytes        = 0;
+		uint64_t total        = 0; // Sum of the known sizes
+		double bytesPerSecond = 0.0;
+		std::optional<std::chrono::seconds> eta;
+		uint32_t active = 0; // Downloads that are still running
+	};
+
+	using Subscriber = std::function<void(const Snapshot&)>;
+
+public:
+	explicit ProgressAggregator(const std::chrono::milliseconds& interval = std::chrono::milliseconds(100)) :
+		m_interval(interval),
+		m_pCounters(std::make_shared<Counters>())
+	{
+		m_reporter = std::jthread([this](std::stop_token stopToken) { report(stopToken); });
+	}
+
+	ProgressAggregator(const ProgressAggregator&)            = delete;
+	ProgressAggregator& operator=(const ProgressAggregator&) = delete;
+
+	// Callback for one download, pass it to any of the download functions.
+	// Sources without a known size always count, everything else only while running or once complete.
+	ProgressCallBack Track()
+	{
+		std::shared_ptr<Source> pSource = std::make_shared<Source>(m_pCounters);
+		return [pSource](const uint64_t& received, const uint64_t& total) { pSource->Update(received, total); };
+	}
+
+	// Subscribers are called on the reporter thread, a slow one delays the others but never a download
+	uint64_t Subscribe(Subscriber subscriber)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_subscribers.emplace(++m_lastId, std::move(subscriber));
+		return m_lastId;
+	}
+
+	void Unsubscribe(const uint64_t& id)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_subscribers.erase(id);
+	}
+
+	// The last snapshot delivered to the subscribers
+	Snapshot Current() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_last;
+	}
+
+private:
+	void report(std::stop_token stopToken)
+	{
+		auto lastTime      = std::chrono::steady_clock::now();
+		uint64_t lastBytes = 0;
+
+		while (!stopToken.stop_requested())
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cv.wait_for(lock, stopToken, m_interval, []() { return false; });
+			}
+
+			Snapshot snapshot;
+			snapshot.bytes  = m_pCounters->bytes.load(std::memory_order_relaxed);
+			snapshot.total  = m_pCounters->total.load(std::memory_order_relaxed);
+			snapshot.active = m_pCounters->active.load(std::memory_order_relaxed);
+
+			const auto now       = std::chrono::steady_clock::now();
+			const double seconds = std::chrono::duration<double>(now - lastTime).count();
+			const double sample  = (snapshot.bytes > lastBytes && seconds > 0.0) ? static_cast<double>(snapshot.bytes - lastBytes) / seconds : 0.0;
+
+			lastTime  = now;
+			lastBytes = snapshot.bytes;
+
+			std::map<uint64_t, Subscriber> subscribers;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				snapshot.bytesPerSecond = (snapshot.active > 0) ? m_last.bytesPerSecond + RATE_ALPHA * (sample - m_last.bytesPerSecond) : 0.0;
+				if (snapshot.total > snapshot.bytes && snapshot.bytesPerSecond > 0.0)
+					snapshot.eta = std::chrono::seconds(static_cast<int64_t>(static_cast<double>(snapshot.total - snapshot.bytes) / snapshot.bytesPerSecond + 0.5));
+
+				const bool changed = (snapshot.bytes != m_last.bytes || snapshot.total != m_last.total || snapshot.active != m_last.active);
+				m_last             = snapshot;
+
+				if (!changed)
+					continue;
+
+				subscribers = m_subscribers;
+			}
+
+			for (const auto& [id, subscriber] : subscribers)
+				subscriber(snapshot);
+		}
+	}
+
+private:
+	std::chrono::milliseconds m_interval;
+	std::shared_ptr<Counters> m_pCounters;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable_any m_cv;
+	std::map<uint64_t, Subscriber> m_subscribers;
+	uint64_t m_lastId = 0;
+	Snapshot m_last   = {};
+
+	std::jthread m_reporter; // Last, so it is stopped and joined before anything it uses is destroyed
+};
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Periodic update checks that don't synchronize a fleet of clients:
+//   - the first check happens at a random point within the startup delay, so a mass restart doesn't cause a burst
+//   - every interval is randomized by +-jitter
+//   - failures back off exponentially (with jitter), up to the maximal backoff
+//   - a Retry-After of the server and the check-interval= of the version file are never undercut
+// Policy only does the math and takes the current time as argument, Scheduler runs the checks on a single worker thread
+// and gets the time from a Clock, so both can be tested with a ManualClock.
+
+namespace selfUpdater::schedule
+{
+
+using Duration  = std::chrono::milliseconds;
+using TimePoint = std::chrono::steady_clock::time_point;
+
+struct Options
+{
+	Duration interval     = std::chrono::hours(6);
+	Duration startupDelay = std::chrono::minutes(5); // The first check is at a random point in [0, startupDelay]
+	double jitter         = 0.1;                     // Fraction of the interval
+	Duration minBackoff   = std::chrono::minutes(1);
+	Duration maxBackoff   = std::chrono::hours(6);
+	double backoffFactor  = 2.0;
+};
+
+// What a check reports back to the schedule
+struct Outcome
+{
+	bool success = false; // The version file was fetched, independent of whether there is an update
+	std::optional<Duration> retryAfter;
+	std::optional<Duration> minInterval;
+};
+
+class Policy
+{
+public:
+	explicit Policy(const Options& options = {}, const uint64_t& seed = std::random_device()()) :
+		m_options(options),
+		m_random(seed)
+	{
+	}
+
+	TimePoint First(const TimePoint& now)
+	{
+		return now + uniform(Duration(0), m_options.startupDelay);
+	}
+
+	TimePoint Next(const Outcome& outcome, const TimePoint& now)
+	{
+		// The minimal interval of the version file stays in effect until it sends a different one
+		if (outcome.success)
+			m_minInterval = outcome.minInterval.value_or(Duration(0));
+
+		Duration delay;
+		if (outcome.success)
+		{
+			m_failures = 0;
+
+			const auto spread = std::chrono::duration_cast<Duration>(m_options.interval * m_options.jitter);
+			delay             = uniform(m_options.interval - spread, m_options.interval + spread);
+		}
+		else
+		{
+			m_failures++;
+
+			// Half of the backoff is fixed, the other half random, so retries after a shared outage spread out as well
+			const Duration backoff = this->backoff();
+			delay                  = uniform(backoff / 2, backoff);
+		}
+
+		delay = (std::max)({ delay, m_minInterval, outcome.retryAfter.value_or(Duration(0)) });
+
+		return now + delay;
+	}
+
+	uint32_t Failures() const
+	{
+		return m_failures;
+	}
+
+private:
+	Duration backoff() const
+	{
+		double backoff = static_cast<double>(m_options.minBackoff.count());
+		for (uint32_t i = 1; i < m_failures && backoff < static_cast<double>(m_options.maxBackoff.count()); i++)
+			backoff *= m_options.backoffFactor;
+
+		return (std::min)(Duration(static_cast<Duration::rep>(backoff)), m_options.maxBackoff);
+	}
+
+	Duration uniform(const Duration& lo, const Duration& hi)
+	{
+		if (hi <= lo)
+			return (std::max)(lo, Duration(0));
+
+		std::uniform_int_distribution<Duration::rep> dist((std::max)(lo, Duration(0)).count(), hi.count());
+		return Duration(dist(m_random));
+	}
+
+private:
+	Options m_options;
+	std::mt19937_64 m_random;
+	uint32_t m_failures    = 0;
+	Duration m_minInterval = Duration(0);
+};
+
+class Clock
+{
+public:
+	virtual ~Clock() = default;
+
+	virtual TimePoint Now() = 0;
+
+	// Waits until the deadline or until the condition variable is notified, the lock is held when it returns
+	virtual void WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, const TimePoint& deadline) = 0;
+};
+
+class SteadyClock : public Clock
+{
+public:
+	TimePoint Now() override
+	{
+		return std::chrono::steady_clock::now();
+	}
+
+	void WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, const TimePoint& deadline) override
+	{
+		cv.wait_until(lock, deadline);
+	}
+};
+
+// Time only moves on Advance(), waiting threads are woken up to check their deadline again
+class ManualClock : public Clock
+{
+	struct Waiter
+	{
+		std::mutex* pMutex;
+		std::condition_variable* pCv;
+	};
+
+public:
+	explicit ManualClock(const TimePoint& start = TimePoint()) :
+		m_now(start)
+	{
+	}
+
+	TimePoint Now() override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_now;
+	}
+
+	void WaitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, const TimePoint& deadline) override
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			if (m_now >= deadline)
+				return;
+
+			m_waiters.push_back({ lock.mutex(), &cv });
+		}
+
+		cv.wait(lock);
+
+		std::lock_guard<std::mutex> guard(m_mutex);
+		std::erase_if(m_waiters, [&](const Waiter& waiter) { return waiter.pCv == &cv; });
+	}
+
+	void Advance(const Duration& duration)
+	{
+		std::vector<Waiter> waiters;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_now += duration;
+			waiters = m_waiters;
+		}
+
+		// Taking the mutex of the waiter guarantees it either sees the new time or is already waiting for the notification
+		for (const Waiter& waiter : waiters)
+		{
+			std::lock_guard<std::mutex> lock(*waiter.pMutex);
+			waiter.pCv->notify_all();
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	TimePoint m_now;
+	std::vector<Waiter> m_waiters;
+};
+
+// Runs the check on one long-lived worker thread until it is stopped
+class Scheduler
+{
+public:
+	using Check = std::function<Outcome()>;
+
+public:
+	explicit Scheduler(Check check, const Options& options = {}, std::shared_ptr<Clock> pClock = nullptr, const uint64_t& seed = std::random_device()()) :
+		m_check(std::move(check)),
+		m_policy(options, seed),
+		m_pClock(pClock ? std::move(pClock) : std::make_shared<SteadyClock>())
+	{
+	}
+
+	~Scheduler()
+	{
+		Stop();
+	}
+
+	Scheduler(const Scheduler&)            = delete;
+	Scheduler& operator=(const Scheduler&) = delete;
+
+	void Start()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_running)
+			return;
+
+		m_running = true;
+		m_stop    = false;
+		m_next    = m_policy.First(m_pClock->Now());
+		m_thread  = std::thread(&Scheduler::run, this);
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_running)
+				return;
+
+			m_stop    = true;
+			m_running = false;
+			m_cv.notify_all();
+		}
+
+		// The check may end the process (std::exit() after starting the new version), the worker can't join itself then
+		if (m_thread.get_id() == std::this_thread::get_id())
+			m_thread.detach();
+		else if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	// Checks right away, the regular schedule continues from there. If a check is running, another one follows it.
+	void CheckNow()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_checking)
+			m_pending = true;
+		else
+			m_next = m_pClock->Now();
+
+		m_cv.notify_all();
+	}
+
+	TimePoint NextCheck() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_next;
+	}
+
+	uint32_t Failures() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_policy.Failures();
+	}
+
+	uint32_t Checks() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_checks;
+	}
+
+private:
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (!m_stop)
+		{
+			if (m_pClock->Now() < m_next)
+			{
+				m_pClock->WaitUntil(lock, m_cv, m_next);
+				continue;
+			}
+
+			m_checking = true;
+			lock.unlock();
+			const Outcome outcome = m_check();
+			lock.lock();
+			m_checking = false;
+
+			m_checks++;
+			m_next = m_policy.Next(outcome, m_pClock->Now());
+
+			// CheckNow() was called during the check, it may have been too early to see what changed
+			if (m_pending)
+			{
+				m_pending = false;
+				m_next    = m_pClock->Now();
+			}
+		}
+	}
+
+private:
+	Check m_check;
+	Policy m_policy;
+	std::shared_ptr<Clock> m_pClock;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::thread m_thread;
+	TimePoint m_next  = {};
+	uint32_t m_checks = 0;
+	bool m_running    = false;
+	bool m_stop       = false;
+	bool m_checking   = false;
+	bool m_pending    = false; // CheckNow() while m_checking
+};
+
+} // namespace selfUpdater::schedule
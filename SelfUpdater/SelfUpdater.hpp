@@ -1,14 +1,29 @@
 #pragma once
 
 #include <Windows.h>
+#include <atomic>
 #include <filesystem>
 #include <format>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <fstream>
 #include <map>
-
+#include <mutex>
+#include <random>
+
+#include "Async.hpp"
+#include "BinaryManifest.hpp"
+#include "BlockSync.hpp"
+#include "ConditionalCache.hpp"
+#include "Decompress.hpp"
+#include "Delta.hpp"
 #include "Downloader.hpp"
+#include "Hedge.hpp"
+#include "Manifest.hpp"
+#include "Mirrors.hpp"
+#include "Progress.hpp"
+#include "Scheduler.hpp"
 #include "Utils.hpp"
 #include "Version.hpp"
 
@@ -20,6 +35,16 @@
 #define SU_VERSION_FILENAME L"versions.txt"
 #endif
 
+// Directory for persistent data like the cached version file, empty means a folder in the temp directory
+#ifndef SU_CACHE_DIR
+#define SU_CACHE_DIR L""
+#endif
+
+// Release channel of this installation, entries of the version file can be limited to channels (see Manifest.hpp)
+#ifndef SU_CHANNEL
+#define SU_CHANNEL L"stable"
+#endif
+
 #ifndef SU_GITHUB_BASE_URL
 #define SU_GITHUB_BASE_URL L"https://github.com/{}/{}/releases/latest/download/"
 #endif
@@ -28,16 +53,32 @@
 
 class SelfUpdater
 {
-	static inline const std::wstring TEMP_PREFIX = L"_U_";
-
-	using VerMap  = std::map<std::string, selfUpdater::version::ResVersion>;
-	using VerMapW = std::map<std::wstring, selfUpdater::version::ResVersion>;
+	static inline const std::wstring TEMP_PREFIX          = L"_U_";
+	static inline const std::wstring CACHE_DIR_NAME       = L"SelfUpdater";
+	static inline const std::wstring INSTALLATION_ID_FILE = L"installation.id";
+	static inline const std::wstring MIRRORS_FILE         = L"mirrors.txt";
 
 public:
 	static inline std::wstring s_baseUrl         = SU_BASE_URL;
 	static inline std::wstring s_versionFilename = SU_VERSION_FILENAME;
+	static inline std::wstring s_cacheDir        = SU_CACHE_DIR;
+	static inline std::wstring s_channel         = SU_CHANNEL;
+	static inline std::string s_prerelease       = std::string(selfUpdater::version::EMBEDDED_PRERELEASE); // Tag of the running version, empty for a release
+	static inline std::string s_installationId   = ""; // Empty means generated once and stored in the cache directory
 	static inline HWND s_mainHWnd                = nullptr;
 
+	// Base URLs serving the same files as s_baseUrl, if set they are used instead of it
+	static inline selfUpdater::downloader::Mirrors s_mirrors;
+
+	// Sends the request for the version file a second time if it is slower than usual, nullptr disables it
+	static inline std::shared_ptr<selfUpdater::downloader::Hedge> s_pHedge = nullptr;
+
+	// Limits the bandwidth of update downloads, disabled by default
+	static inline selfUpdater::downloader::Throttle s_throttle = {};
+
+	// Where checks continue and the update callback runs, nullptr uses the shared background threads
+	static inline std::shared_ptr<selfUpdater::async::Executor> s_pExecutor = nullptr;
+
 	using UpdateCallBack = std::function<void(void)>;
 
 	enum class UpdateType
@@ -80,16 +121,103 @@ public:
 		s_baseUrl = baseUrl;
 	}
 
+	// Requests go to the fastest healthy mirror and fail over to the next one, see Mirrors.hpp.
+	// A higher weight prefers the mirror over others that are equally fast.
+	static void AddMirror(const std::wstring& baseUrl, const double& weight = 1.0)
+	{
+		s_mirrors.Add(baseUrl, weight);
+	}
+
+	// Cuts the tail latency of checks, see Hedge.hpp. The hedge keeps the latencies of the previous checks.
+	static void EnableHedging(const selfUpdater::downloader::HedgeOptions& options = {})
+	{
+		s_pHedge = std::make_shared<selfUpdater::downloader::Hedge>(options);
+	}
+
+	// E.g., { .bytesPerSecond = 512 * 1024, .adaptive = true } to download in the background without slowing down other traffic
+	static void SetThrottle(const selfUpdater::downloader::Throttle& throttle)
+	{
+		s_throttle = throttle;
+	}
+
 	static void SetVersionFilename(const std::wstring& filename)
 	{
 		s_versionFilename = filename;
 	}
 
+	static void SetCacheDirectory(const std::wstring& directory)
+	{
+		s_cacheDir = directory;
+	}
+
+	static void SetChannel(const std::wstring& channel)
+	{
+		s_channel = channel;
+	}
+
+	// E.g., "rc.1" so a prerelease build is offered the next prerelease and the release of its version
+	static void SetPrerelease(const std::string& prerelease)
+	{
+		s_prerelease = prerelease;
+	}
+
+	// Decides in which stage of a rollout this installation gets an update, see Manifest.hpp
+	static void SetInstallationId(const std::string& installationId)
+	{
+		s_installationId = installationId;
+	}
+
+	// E.g., a FunctionExecutor posting to the event loop of the host, network requests never run on it
+	static void SetExecutor(std::shared_ptr<selfUpdater::async::Executor> pExecutor)
+	{
+		s_pExecutor = std::move(pExecutor);
+	}
+
+	// Progress of the update downloads, e.g., for a progress bar: GetProgress().Subscribe([](const auto& snapshot) { ... })
+	static selfUpdater::downloader::ProgressAggregator& GetProgress()
+	{
+		static selfUpdater::downloader::ProgressAggregator progress;
+		return progress;
+	}
+
+	static std::filesystem::path GetCacheDirectory()
+	{
+		if (!s_cacheDir.empty())
+			return s_cacheDir;
+
+		return std::filesystem::temp_directory_path() / CACHE_DIR_NAME;
+	}
+
+	// co_await SelfUpdater::Check() yields true if an update is available, the callback set by CheckForUpdates() is called before.
+	// The requests run on the background threads, the awaiting coroutine continues on the executor.
+	static selfUpdater::async::Task<bool> Check()
+	{
+		return GetInstance().check();
+	}
+
+	// co_await SelfUpdater::Update() downloads and starts the new version, the process exits if that succeeds
+	static selfUpdater::async::Task<bool> Update()
+	{
+		co_return co_await selfUpdater::async::Run(*selfUpdater::async::GetBackgroundExecutor(), []() { return GetInstance().doUpdate(); });
+	}
+
+	// Starts Check(), Blocking waits for the result. Blocking must not be used from the thread the executor runs on.
 	static bool CheckForUpdates(const UpdateType& type = UpdateType::Console, const UpdateMode& mode = UpdateMode::NonBlocking, const UpdateCallBack& cb = nullptr)
 	{
 		return GetInstance().checkForUpdates(type, mode, cb);
 	}
 
+	// Checks periodically in the background, see Scheduler.hpp. The callback is called for every check that finds an update.
+	static void StartScheduler(const UpdateType& type = UpdateType::Console, const selfUpdater::schedule::Options& options = {}, const UpdateCallBack& cb = nullptr, std::shared_ptr<selfUpdater::schedule::Clock> pClock = nullptr)
+	{
+		GetInstance().startScheduler(type, options, cb, std::move(pClock));
+	}
+
+	static void StopScheduler()
+	{
+		GetInstance().stopScheduler();
+	}
+
 	static bool WaitUntilDone()
 	{
 		return GetInstance().waitUntilDone();
@@ -150,13 +278,15 @@ private:
 
 	bool checkForUpdates(const UpdateType& type = UpdateType::Console, const UpdateMode& mode = UpdateMode::NonBlocking, const UpdateCallBack& cb = nullptr)
 	{
+		UpdateCallBack callback = nullptr;
+
 		switch (type)
 		{
 			case UpdateType::Window:
-				m_callback = UpdateAvailableWindow;
+				callback = UpdateAvailableWindow;
 				break;
 			case UpdateType::Console:
-				m_callback = UpdateAvailableConsole;
+				callback = UpdateAvailableConsole;
 				break;
 			case UpdateType::Custom:
 				if (cb == nullptr)
@@ -164,32 +294,23 @@ private:
 					std::cerr << "Custom update callback is null" << std::endl;
 					return false;
 				}
-				m_callback = cb;
+				callback = cb;
 				break;
 			default:
 				std::cerr << "Unknown update type" << std::endl;
 				break;
 		}
 
-		// std::exit() called from within std::async does not terminate the main process (at least using MSVC).
-		// Therefore, we have to build part of it from scratch.
-		// The thread is detached to prevent it from crashing the application when exit is called within it.
-		// The promise is used to get the result of the thread and to allow for a blocking wait on it, e.g., when waiting until the update evaluation is done.
-
-		std::promise<bool> resultPromise;
-		m_updateThrdRes = resultPromise.get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_checkMutex);
 
-		std::thread([this, promise = std::move(resultPromise)]() mutable {
-			try
-			{
-				bool result = this->checkForUpdatesThrd();
-				promise.set_value(result);
-			}
-			catch (...)
+			// A check that is still running is shared instead of starting another one
+			if (!m_check.valid() || m_check.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
 			{
-				promise.set_exception(std::current_exception());
+				m_callback = callback;
+				m_check    = selfUpdater::async::Start(check()).share();
 			}
-		}).detach();
+		}
 
 		if (mode == UpdateMode::Blocking)
 			return waitUntilDone();
@@ -199,32 +320,81 @@ private:
 
 	bool waitUntilDone()
 	{
+		std::shared_future<bool> check;
+		{
+			std::lock_guard<std::mutex> lock(m_checkMutex);
+			check = m_check;
+		}
+
+		if (!check.valid())
+			return false;
+
 		bool res = false;
 		try
 		{
-			// Blocks until result is set or thread exits
-			res = m_updateThrdRes.get();
+			// Blocks until the check is done
+			res = check.get();
 		}
 		catch (const std::exception& e)
 		{
-			std::cerr << "Exception from update thread: " << e.what() << "\n";
+			std::cerr << "Exception from update check: " << e.what() << "\n";
 		}
 
 		return res;
 	}
 
+	void startScheduler(const UpdateType& type, const selfUpdater::schedule::Options& options, const UpdateCallBack& cb, std::shared_ptr<selfUpdater::schedule::Clock> pClock)
+	{
+		stopScheduler();
+
+		auto scheduledCheck = [this, type, cb]() {
+			checkForUpdates(type, UpdateMode::Blocking, cb);
+			return m_outcome;
+		};
+
+		m_pScheduler = std::make_unique<selfUpdater::schedule::Scheduler>(scheduledCheck, options, std::move(pClock));
+		m_pScheduler->Start();
+	}
+
+	void stopScheduler()
+	{
+		if (m_pScheduler)
+			m_pScheduler->Stop();
+	}
+
+	selfUpdater::async::Task<bool> check()
+	{
+		if (m_isTemp)
+			co_return true;
+
+		const std::shared_ptr<selfUpdater::async::Executor> pExecutor = s_pExecutor ? s_pExecutor : selfUpdater::async::GetBackgroundExecutor();
+
+		// The requests block, so they never run on the executor of the host
+		const bool found = co_await selfUpdater::async::Run(*selfUpdater::async::GetBackgroundExecutor(), [this]() { return findUpdate(); });
+
+		// The callback usually asks the user, it runs where the host wants it to
+		co_await selfUpdater::async::Schedule(*pExecutor);
+
+		if (found && m_callback)
+			m_callback();
+
+		co_return found;
+	}
+
 	bool doUpdate()
 	{
-		if (s_baseUrl.empty())
+		if (s_baseUrl.empty() && s_mirrors.IsEmpty())
 		{
 			std::cerr << "Base URL is not set. Please set it using SelfUpdater::SetBaseUrl()" << std::endl;
 			return false;
 		}
 
-		std::wstring url = std::format(L"{}/{}", s_baseUrl, m_exeName);
+		std::wstring url = std::format(L"{}/{}", baseUrl(), m_exeName);
 		m_tempExePath    = std::format(L"{}\\{}{}", std::filesystem::temp_directory_path().wstring(), TEMP_PREFIX, m_exeName);
 
-		bool res = selfUpdater::downloader::Download(url, m_tempExePath);
+		bool res = downloadPatch() || downloadBlockSync(url) || downloadCompressed(url) || downloadFull(url);
+		saveMirrors();
+
 		if (!res)
 		{
 			std::cerr << "Failed to download the new version" << std::endl;
@@ -256,55 +426,319 @@ private:
 		}
 	}
 
+	// Builds the new version from a delta patch against the running executable, if the version file offers one
+	bool downloadPatch()
+	{
+		const selfUpdater::manifest::Patch* pPatch = m_update.FindPatch(m_version);
+		if (pPatch == nullptr)
+			return false;
+
+		selfUpdater::delta::PatchSink sink(m_fullExePath, m_tempExePath);
+		if (!download(pPatch->file, sink, GetProgress().Track()))
+		{
+			std::cerr << "Failed to apply the delta patch, falling back to the full download" << std::endl;
+			return false;
+		}
+
+		// The patch carries its own target hash, which was verified while applying it
+		if (!m_update.Verify(sink.TargetSize(), sink.TargetHash()))
+		{
+			std::cerr << "Delta patch does not produce the binary from the version file, falling back to the full download" << std::endl;
+			return false;
+		}
+
+		std::wcout << std::format(L"Applied delta patch: {}", pPatch->file) << std::endl;
+		return true;
+	}
+
+	// Reuses the blocks of the running executable and only downloads the missing ones, if the server publishes a signature
+	bool downloadBlockSync(const std::wstring& url)
+	{
+		if (!selfUpdater::blocksync::Sync(url, m_fullExePath, m_tempExePath, GetProgress().Track(), m_update.sha256))
+			return false;
+
+		std::cout << "Assembled the new version from the installed one" << std::endl;
+		return true;
+	}
+
+	// Downloads a compressed variant and decompresses it while receiving, either announced by the version file
+	// or negotiated with the server using Accept-Encoding
+	bool downloadCompressed(const std::wstring& url)
+	{
+		using namespace selfUpdater::downloader;
+
+		const selfUpdater::manifest::Payload* pPayload = m_update.FindPayload();
+		if (pPayload == nullptr && AcceptEncoding().empty())
+			return false;
+
+		uint64_t received   = 0;
+		ProgressCallBack cb = [&received](const uint64_t& cur, const uint64_t&) { received = cur; };
+
+		// Progress is reported in decompressed bytes, against the size of the binary if the version file gives it
+		ProgressCallBack outputCb = [track = GetProgress().Track(), total = m_update.size.value_or(0)](const uint64_t& written, const uint64_t&) { track(written, total); };
+
+		FileSink file(m_tempExePath);
+		HashingSink verified(file, m_update.size, m_update.sha256);
+		DecompressSink sink(verified, pPayload ? pPayload->encoding : Encoding::Auto, outputCb);
+
+		bool res;
+		if (pPayload != nullptr)
+			res = download(pPayload->file, sink, cb);
+		else
+		{
+			res = throttled(url, sink, [&](Sink& target) {
+				Response response;
+				return Downloader::Request(url, target, response, std::format(L"Accept-Encoding: {}\r\n", AcceptEncoding()), cb) && response.IsSuccess();
+			});
+		}
+
+		if (!res)
+		{
+			std::cerr << "Failed to download the compressed version, falling back to the full download" << std::endl;
+			return false;
+		}
+
+		std::cout << std::format("Received {} bytes, decompressed to {} bytes", received, sink.Written()) << std::endl;
+		return true;
+	}
+
+	// Downloads the binary as is, hashing it while it is received if the version file provides the expected values
+	bool downloadFull(const std::wstring& url)
+	{
+		if (!m_update.size && !m_update.sha256 && s_mirrors.IsEmpty())
+			return selfUpdater::downloader::Download(url, m_tempExePath, GetProgress().Track(), selfUpdater::downloader::DownloadMode::Default, s_throttle);
+
+		selfUpdater::downloader::FileSink file(m_tempExePath);
+		selfUpdater::downloader::HashingSink sink(file, m_update.size, m_update.sha256);
+
+		return download(m_exeName, sink, GetProgress().Track());
+	}
+
+	// Downloads a file next to the version file, from the mirrors if there are any
+	bool download(const std::wstring& file, selfUpdater::downloader::Sink& sink, selfUpdater::downloader::ProgressCallBack cb = nullptr)
+	{
+		const std::wstring url = std::format(L"{}/{}", baseUrl(), file);
+
+		return throttled(url, sink, [&](selfUpdater::downloader::Sink& target) {
+			if (s_mirrors.IsEmpty())
+				return selfUpdater::downloader::Download(url, target, nullptr, cb);
+
+			return s_mirrors.Download(file, target, cb);
+		});
+	}
+
+	// Runs the download with the sink throttled as set by SetThrottle(), the adaptive mode samples the round trip time to the URL
+	static bool throttled(const std::wstring& url, selfUpdater::downloader::Sink& sink, const std::function<bool(selfUpdater::downloader::Sink&)>& download)
+	{
+		if (!s_throttle.IsEnabled())
+			return download(sink);
+
+		selfUpdater::downloader::RateLimiter limiter(s_throttle, url);
+		selfUpdater::downloader::ThrottledSink throttledSink(sink, limiter);
+
+		return download(throttledSink);
+	}
+
+	// The base URL for requests that can't fail over, i.e., the best mirror if there are any
+	std::wstring baseUrl()
+	{
+		if (s_mirrors.IsEmpty())
+			return s_baseUrl;
+
+		loadMirrors();
+		return s_mirrors.Best();
+	}
+
+	// The measurements of earlier runs are loaded once, mirrors without any are probed with the version file
+	void loadMirrors()
+	{
+		if (m_mirrorsLoaded.exchange(true))
+			return;
+
+		s_mirrors.Load(GetCacheDirectory() / MIRRORS_FILE);
+
+		if (s_mirrors.NeedsProbe())
+			s_mirrors.Probe(s_versionFilename);
+	}
+
+	void saveMirrors() const
+	{
+		if (!s_mirrors.IsEmpty())
+			s_mirrors.Save(GetCacheDirectory() / MIRRORS_FILE);
+	}
+
 	void cleanUp()
 	{
 		if (!m_tempExePath.empty() && std::filesystem::exists(m_tempExePath))
 			std::filesystem::remove(m_tempExePath);
 	}
 
-	bool checkForUpdatesThrd()
+	// Fetches the version file and stores the best update in m_update, returns true if there is one
+	bool findUpdate()
 	{
-		if (m_isTemp)
-			return true;
-
 		std::cout << "Checking for updates ..." << std::endl;
 
-		std::wstring url = std::format(L"{}/{}", s_baseUrl, s_versionFilename);
+		m_outcome = {};
+		if (!fetchVersions())
+			return false;
+
+		selfUpdater::manifest::UpdateSelector selector(m_version, selfUpdater::utils::ws2s(s_channel), getInstallationId());
+		selector.SetInstalledPrerelease(s_prerelease);
+		selectUpdate(selector);
 
-		std::vector<uint8_t> versionData;
+		m_outcome.success = true;
+		if (selector.CheckInterval())
+			m_outcome.minInterval = std::chrono::seconds(*selector.CheckInterval());
 
-		bool res = selfUpdater::downloader::Download(url, versionData);
-		if (res)
+		if (!selector.IsListed())
 		{
-			VerMapW versions = parseVersionFileDataW(versionData);
+			std::wcerr << std::format(L"Couldn't find the version info for {} in the version file", m_exeName) << std::endl;
+			return false;
+		}
 
-			selfUpdater::version::ResVersion newVer;
+		if (!selector.Best())
+		{
+			std::cout << (selector.IsHeldBack() ? "No new version available, the rollout of the latest version doesn't include this installation yet" : "No new version available") << std::endl;
+			return false;
+		}
 
-			for (const auto& [name, ver] : versions)
-			{
-				if (name == m_exeName)
-					newVer = ver;
-			}
+		const selfUpdater::manifest::Entry& entry = *selector.Best();
+
+		std::cout << std::format("New version available: {} -> {}\n", versionString(m_version, s_prerelease), versionString(entry.version, entry.prerelease));
+
+		m_update = entry;
+
+		// The download usually follows shortly, have the connection ready by then
+		selfUpdater::downloader::Downloader::Preconnect(std::format(L"{}/{}", baseUrl(), m_exeName));
+
+		return true;
+	}
+
+	// With all four parts, an update may only differ in the build, e.g., 1.3.0-rc.1 Build #2
+	static std::string versionString(const selfUpdater::version::ResVersion& version, const std::string& prerelease)
+	{
+		std::string str = version.ToString(4);
+		if (!prerelease.empty())
+			str.insert(selfUpdater::version::ResVersion::MS_FORMAT ? str.size() : version.ToString(3).size(), "-" + prerelease);
+
+		return str;
+	}
+
+	// Tries the mirrors in order of their score until one delivers the version file
+	bool fetchVersions()
+	{
+		if (s_mirrors.IsEmpty())
+			return fetchVersions(std::format(L"{}/{}", s_baseUrl, s_versionFilename));
+
+		loadMirrors();
+
+		const std::vector<size_t> order = s_mirrors.Order();
 
-			if (!newVer)
+		bool res = false;
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const size_t idx = order[i];
+
+			// A hedged request goes to the next mirror
+			const std::wstring url      = std::format(L"{}/{}", s_mirrors.BaseUrl(idx), s_versionFilename);
+			const std::wstring hedgeUrl = std::format(L"{}/{}", s_mirrors.BaseUrl(order[(i + 1) % order.size()]), s_versionFilename);
+
+			// A 304 only tells the round trip time, the cached version file wasn't transferred
+			const auto start  = std::chrono::steady_clock::now();
+			uint64_t received = 0;
+			if (fetchVersions(url, hedgeUrl, &received))
 			{
-				std::wcerr << std::format(L"Couldn't find the version info for {} in the version file", m_exeName) << std::endl;
-				return false;
+				s_mirrors.ReportSuccess(idx, received, std::chrono::steady_clock::now() - start);
+				m_outcome.retryAfter.reset();
+				res = true;
+				break;
 			}
 
-			if (newVer <= m_version)
-			{
-				std::cout << "No new version available" << std::endl;
+			s_mirrors.ReportFailure(idx);
+		}
+
+		saveMirrors();
+		return res;
+	}
+
+	// Updates m_versionData, the version file is only downloaded again if it changed since the last check.
+	// pReceived is set to the size of the body received, 0 if the cached version file is used.
+	bool fetchVersions(const std::wstring& url, const std::wstring& hedgeUrl = L"", uint64_t* pReceived = nullptr)
+	{
+		selfUpdater::downloader::ConditionalCache cache(GetCacheDirectory());
+		std::vector<uint8_t> versionData;
+
+		switch (cache.Fetch(url, versionData, s_pHedge.get(), hedgeUrl))
+		{
+			case selfUpdater::downloader::ConditionalCache::Result::Modified:
+				if (pReceived != nullptr)
+					*pReceived = versionData.size();
+				break;
+			case selfUpdater::downloader::ConditionalCache::Result::NotModified:
+				// Loaded by a previous check of this process, nothing to do
+				if (m_versionsUrl == url)
+					return true;
+
+				if (!cache.Load(url, versionData))
+				{
+					std::cerr << "Failed to load the cached version file" << std::endl;
+					return false;
+				}
+				break;
+			default:
+				m_outcome.retryAfter = cache.RetryAfter();
 				return false;
-			}
+		}
 
-			std::cout << std::format("New version available: {} -> {}\n", m_version.ToString(), newVer.ToString());
+		m_versionData = std::move(versionData);
+		m_versionsUrl = url;
 
-			if (m_callback)
-				m_callback();
+		return true;
+	}
+
+	// Offers all entries for this executable to the selector, it keeps the newest one this version may update to
+	void selectUpdate(selfUpdater::manifest::UpdateSelector& selector) const
+	{
+		if (selfUpdater::manifest::BinaryManifest::IsBinary(m_versionData))
+		{
+			selfUpdater::manifest::BinaryManifest(m_versionData).SelectUpdate(selfUpdater::utils::ws2s(m_exeName), selector);
+			return;
 		}
 
-		return res;
+		std::vector<selfUpdater::manifest::ParseError> errors;
+		selfUpdater::manifest::SelectUpdate(selfUpdater::manifest::AsText(m_versionData), selfUpdater::utils::ws2s(m_exeName), selector, &errors);
+
+		for (const selfUpdater::manifest::ParseError& error : errors)
+			std::cerr << std::format("Version file line {}: {}", error.line, error.pMessage) << std::endl;
+	}
+
+	// A random ID that is kept in the cache directory, so the installation stays in the same rollout stage across runs
+	const std::string& getInstallationId()
+	{
+		if (!s_installationId.empty())
+			return s_installationId;
+
+		if (!m_installationId.empty())
+			return m_installationId;
+
+		const std::filesystem::path idPath = GetCacheDirectory() / INSTALLATION_ID_FILE;
+
+		std::ifstream in(idPath);
+		if (std::getline(in, m_installationId) && !m_installationId.empty())
+			return m_installationId;
+
+		std::random_device rd;
+		std::array<uint8_t, 16> id;
+		for (uint8_t& byte : id)
+			byte = static_cast<uint8_t>(rd());
+
+		m_installationId = selfUpdater::hash::ToHex(id);
+
+		std::error_code ec;
+		std::filesystem::create_directories(idPath.parent_path(), ec);
+		std::ofstream(idPath, std::ios::trunc) << m_installationId << '\n';
+
+		return m_installationId;
 	}
 
 	void init()
@@ -408,39 +842,6 @@ private:
 		}
 	}
 
-	static VerMap parseVersionFileData(const std::vector<uint8_t>& data)
-	{
-		VerMap versions;
-		std::string versionString(data.begin(), data.end());
-		std::vector<std::string> lines = selfUpdater::utils::Split(versionString, "\n");
-		for (const std::string& l : lines)
-		{
-			std::vector<std::string> parts = selfUpdater::utils::Split(l, "\t");
-			if (parts.size() == 2)
-			{
-				std::string name = parts[0];
-				selfUpdater::version::ResVersion ver(parts[1]);
-				if (ver)
-					versions[name] = ver;
-			}
-		}
-
-		return versions;
-	}
-
-	static VerMapW parseVersionFileDataW(const std::vector<uint8_t>& data)
-	{
-		VerMapW versions;
-		const VerMap vv = parseVersionFileData(data);
-		for (const auto& [name, ver] : vv)
-		{
-			std::wstring wName = selfUpdater::utils::s2ws(name);
-			versions[wName]    = ver;
-		}
-
-		return versions;
-	}
-
 private:
 	selfUpdater::version::ResVersion m_version = {};
 
@@ -452,6 +853,16 @@ private:
 	UpdateCallBack m_callback  = nullptr;
 
 	bool m_isTemp = false;
+	std::atomic<bool> m_mirrorsLoaded = false;
+
+	std::mutex m_checkMutex;
+	std::shared_future<bool> m_check = {};
+
+	std::unique_ptr<selfUpdater::schedule::Scheduler> m_pScheduler = nullptr;
+	selfUpdater::schedule::Outcome m_outcome                        = {};
 
-	std::future<bool> m_updateThrdRes = {};
+	std::vector<uint8_t> m_versionData    = {};
+	std::wstring m_versionsUrl            = L"";
+	std::string m_installationId          = "";
+	selfUpdater::manifest::Entry m_update = {};
 };
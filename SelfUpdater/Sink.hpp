@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Hash.hpp"
+#include "Http.hpp"
+
+namespace selfUpdater::downloader
+{
+
+using ProgressCallBack = std::function<void(const uint64_t&, const uint64_t&)>;
+
+// A sink consumes the body of a download while it is being received.
+// The downloader asks the sink for writable memory using Prepare() and reads straight into it,
+// afterwards Commit() tells the sink how many of the prepared bytes were actually filled.
+// This way a sink decides on its own how much memory is used, e.g., a file sink only needs a single chunk.
+class Sink
+{
+public:
+	virtual ~Sink() = default;
+
+	// Called once the status and the headers are known, before any data. Returning false skips the body and fails the request.
+	virtual bool OnResponse([[maybe_unused]] const Response& response)
+	{
+		return true;
+	}
+
+	// Called before the first Prepare() if the size of the resource is known
+	virtual void OnSizeHint([[maybe_unused]] const uint64_t& size)
+	{
+	}
+
+	// Returns a buffer of at most maxSize bytes, an empty span signals that the sink can't take any more data
+	virtual std::span<uint8_t> Prepare(const std::size_t& maxSize) = 0;
+
+	// Marks the first size bytes of the last prepared buffer as filled, returning false aborts the download
+	virtual bool Commit(const std::size_t& size) = 0;
+
+	// Called once after the last byte has been committed
+	virtual bool Finish()
+	{
+		return true;
+	}
+
+	// Helper to push already existing data into the sink, e.g., when sinks are chained
+	bool Write(const uint8_t* pData, std::size_t size)
+	{
+		while (size > 0)
+		{
+			std::span<uint8_t> buffer = Prepare(size);
+			if (buffer.empty())
+				return false;
+
+			const std::size_t chunk = (std::min)(size, buffer.size());
+			std::memcpy(buffer.data(), pData, chunk);
+
+			if (!Commit(chunk))
+				return false;
+
+			pData += chunk;
+			size -= chunk;
+		}
+
+		return true;
+	}
+};
+
+// Appends the data to a vector, the size hint is used to allocate the final size upfront.
+// The hint comes from the server, so at most MAX_RESERVE is allocated before the data actually arrives.
+template<typename Vector>
+class BasicVectorSink : public Sink
+{
+	static constexpr std::size_t MIN_GROWTH  = 64 * 1024;
+	static constexpr std::size_t MAX_RESERVE = 8 * 1024 * 1024;
+
+public:
+	explicit BasicVectorSink(Vector& data) :
+		m_data(data)
+	{
+		m_data.clear();
+	}
+
+	void OnSizeHint(const uint64_t& size) override
+	{
+		m_data.reserve(static_cast<std::size_t>((std::min)(size, static_cast<uint64_t>(MAX_RESERVE))));
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		m_used = m_data.size();
+
+		// Without (or with a wrong) size hint grow geometrically instead of chunk by chunk
+		if (m_data.capacity() == m_used)
+			m_data.reserve(m_used + (std::max)(m_used, MIN_GROWTH));
+
+		const std::size_t size = (std::min)(maxSize, m_data.capacity() - m_used);
+		m_data.resize(m_used + size);
+
+		return { m_data.data() + m_used, size };
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		m_data.resize(m_used + size);
+		return true;
+	}
+
+private:
+	Vector& m_data;
+	std::size_t m_used = 0;
+};
+
+using VectorSink    = BasicVectorSink<std::vector<uint8_t>>;
+using PmrVectorSink = BasicVectorSink<std::pmr::vector<uint8_t>>;
+
+// Writes into a caller provided buffer, the download fails if the buffer is too small
+class SpanSink : public Sink
+{
+public:
+	explicit SpanSink(std::span<uint8_t> buffer) :
+		m_buffer(buffer)
+	{
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		return m_buffer.subspan(m_size, (std::min)(maxSize, m_buffer.size() - m_size));
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		m_size += size;
+		return true;
+	}
+
+	std::span<uint8_t> Data() const
+	{
+		return m_buffer.first(m_size);
+	}
+
+	const std::size_t& Size() const
+	{
+		return m_size;
+	}
+
+private:
+	std::span<uint8_t> m_buffer;
+	std::size_t m_size = 0;
+};
+
+// Streams the data into a file, only a single chunk is kept in memory
+class FileSink : public Sink
+{
+	static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+public:
+	explicit FileSink(const std::filesystem::path& filePath, const bool& append = false) :
+		m_file(filePath, std::ios::binary | (append ? std::ios::app : std::ios::trunc)),
+		m_buffer(CHUNK_SIZE)
+	{
+	}
+
+	bool IsOpen() const
+	{
+		return m_file.is_open();
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		if (!m_file)
+			return {};
+
+		return { m_buffer.data(), (std::min)(maxSize, m_buffer.size()) };
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		m_file.write(reinterpret_cast<const char*>(m_buffer.data()), static_cast<std::streamsize>(size));
+		return m_file.good();
+	}
+
+	bool Finish() override
+	{
+		m_file.flush();
+		return m_file.good();
+	}
+
+private:
+	std::ofstream m_file;
+	std::vector<uint8_t> m_buffer;
+};
+
+// Hands every received chunk to a consumer.
+// The consumer is called on the download thread, while it blocks no further data is read (backpressure),
+// returning false aborts the download.
+class CallbackSink : public Sink
+{
+	static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+public:
+	using Consumer = std::function<bool(std::span<const uint8_t>)>;
+
+	explicit CallbackSink(Consumer consumer, const std::size_t& chunkSize = CHUNK_SIZE) :
+		m_consumer(std::move(consumer)),
+		m_buffer(chunkSize)
+	{
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		return { m_buffer.data(), (std::min)(maxSize, m_buffer.size()) };
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		return m_consumer(std::span<const uint8_t>(m_buffer.data(), size));
+	}
+
+private:
+	Consumer m_consumer;
+	std::vector<uint8_t> m_buffer;
+};
+
+// Hashes the data on its way into the target sink, the bytes are hashed straight from the target's buffer.
+// Finish() fails if the size or the SHA-256 doesn't match the expected values, a too large download is aborted right away.
+class HashingSink : public Sink
+{
+public:
+	HashingSink(Sink& target, const std::optional<uint64_t>& expectedSize, const std::optional<hash::Sha256::Digest>& expectedHash) :
+		m_target(target),
+		m_expectedSize(expectedSize),
+		m_expectedHash(expectedHash)
+	{
+	}
+
+	bool OnResponse(const Response& response) override
+	{
+		return m_target.OnResponse(response);
+	}
+
+	void OnSizeHint(const uint64_t& size) override
+	{
+		m_target.OnSizeHint(size);
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		m_prepared = m_target.Prepare(maxSize);
+		return m_prepared;
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		m_sha.Update(m_prepared.data(), size);
+		m_size += size;
+
+		if (m_expectedSize && m_size > *m_expectedSize)
+			return fail("Download is larger than expected");
+
+		return m_target.Commit(size);
+	}
+
+	bool Finish() override
+	{
+		if (!m_target.Finish())
+			return false;
+
+		if (m_expectedSize && m_size != *m_expectedSize)
+			return fail("Download has the wrong size");
+
+		m_digest = m_sha.Final();
+		if (m_expectedHash && m_digest != *m_expectedHash)
+			return fail("Download has the wrong hash");
+
+		return true;
+	}
+
+	// Only valid after Finish()
+	const hash::Sha256::Digest& Digest() const
+	{
+		return m_digest;
+	}
+
+	const uint64_t& Size() const
+	{
+		return m_size;
+	}
+
+private:
+	bool fail(const char* pMsg)
+	{
+		std::cerr << "[Integrity] " << pMsg << std::endl;
+		return false;
+	}
+
+private:
+	Sink& m_target;
+	std::optional<uint64_t> m_expectedSize;
+	std::optional<hash::Sha256::Digest> m_expectedHash;
+
+	std::span<uint8_t> m_prepared;
+	hash::Sha256 m_sha;
+	hash::Sha256::Digest m_digest = {};
+	uint64_t m_size               = 0;
+};
+
+// Decides where the body goes once the response is known, e.g., to reject an unexpected status before anything is written.
+// The handler returns the sink for the body or nullptr to skip it, everything else is forwarded to that sink.
+class ResponseSink : public Sink
+{
+public:
+	using Handler = std::function<Sink*(const Response&)>;
+
+	explicit ResponseSink(Handler handler) :
+		m_handler(std::move(handler))
+	{
+	}
+
+	bool OnResponse(const Response& response) override
+	{
+		m_pTarget = m_handler(response);
+		return m_pTarget != nullptr && m_pTarget->OnResponse(response);
+	}
+
+	void OnSizeHint(const uint64_t& size) override
+	{
+		if (m_pTarget != nullptr)
+			m_pTarget->OnSizeHint(size);
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		return (m_pTarget != nullptr) ? m_pTarget->Prepare(maxSize) : std::span<uint8_t>();
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		return m_pTarget != nullptr && m_pTarget->Commit(size);
+	}
+
+	bool Finish() override
+	{
+		return m_pTarget != nullptr && m_pTarget->Finish();
+	}
+
+private:
+	Handler m_handler;
+	Sink* m_pTarget = nullptr;
+};
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+#include "Http.hpp"
+#include "Sink.hpp"
+#include "Transport.hpp"
+
+// Background downloads that leave bandwidth to the application.
+//   RateLimiter   Token bucket shared by all connections of a download, optionally adapted to the delay on the path
+//   ThrottledSink Takes tokens for every chunk it receives, while it waits nothing is read and TCP slows the sender down
+// The adaptive mode follows LEDBAT (RFC 6817): the round trip time to the server is sampled during the download,
+// the lowest one is taken as the base delay. Once the queuing delay above it exceeds the target, other traffic is waiting
+// behind ours and the rate goes down, below the target it slowly goes up again (up to bytesPerSecond, if set).
+
+namespace selfUpdater::downloader
+{
+
+struct Throttle
+{
+	uint64_t bytesPerSecond               = 0; // 0 is unlimited, in adaptive mode the upper limit
+	bool adaptive                         = false;
+	std::chrono::milliseconds targetDelay = std::chrono::milliseconds(100); // Queuing delay the adaptive mode tolerates
+	uint64_t minBytesPerSecond            = 16 * 1024;                      // The adaptive mode never goes below this
+
+	bool IsEnabled() const
+	{
+		return bytesPerSecond > 0 || adaptive;
+	}
+};
+
+class RateLimiter
+{
+	static constexpr std::chrono::milliseconds BURST_TIME     = std::chrono::milliseconds(50); // Tokens never pile up beyond this
+	static constexpr uint64_t MIN_BURST                       = 4 * 1024;
+	static constexpr std::chrono::milliseconds PROBE_INTERVAL = std::chrono::milliseconds(500);
+	static constexpr std::chrono::seconds MEASURE_WINDOW      = std::chrono::seconds(1);
+	static constexpr size_t CURRENT_DELAY_SAMPLES             = 3;   // The minimum of the last samples filters out outliers
+	static constexpr double GAIN                              = 0.2; // Rate change per sample at a queuing delay of 0 or twice the target
+
+public:
+	// In adaptive mode the round trip time is sampled with tiny range requests to probeUrl, without one the rate stays fixed
+	explicit RateLimiter(const Throttle& throttle, const std::wstring& probeUrl = L"") :
+		m_throttle(throttle),
+		m_rate(static_cast<double>(throttle.bytesPerSecond)),
+		m_last(std::chrono::steady_clock::now()),
+		m_windowStart(m_last)
+	{
+		m_tokens = burst();
+
+		if (throttle.adaptive && !probeUrl.empty())
+			m_probe = std::jthread([this, probeUrl](std::stop_token stopToken) { probe(probeUrl, stopToken); });
+	}
+
+	RateLimiter(const RateLimiter&)            = delete;
+	RateLimiter& operator=(const RateLimiter&) = delete;
+
+	// Largest chunk a read should take at once, keeps the data flowing evenly instead of in bursts
+	size_t MaxChunk() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return (m_rate > 0.0) ? static_cast<size_t>(burst()) : SIZE_MAX;
+	}
+
+	// Takes the tokens for bytes that were received, blocks until the rate allows it
+	void Acquire(const size_t& bytes)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		const auto now = std::chrono::steady_clock::now();
+		measure(bytes, now);
+
+		if (m_rate <= 0.0)
+			return;
+
+		m_tokens = (std::min)(m_tokens + std::chrono::duration<double>(now - m_last).count() * m_rate, burst());
+		m_last   = now;
+		m_tokens -= static_cast<double>(bytes);
+
+		if (m_tokens >= 0.0)
+			return;
+
+		const auto wait = std::chrono::duration<double>(-m_tokens / m_rate);
+		lock.unlock();
+
+		std::this_thread::sleep_for(wait);
+	}
+
+	// Adapts the rate to a round trip time measured while downloading
+	void OnDelaySample(const std::chrono::steady_clock::duration& rtt)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_baseDelay = (m_baseDelay == std::chrono::steady_clock::duration::zero()) ? rtt : (std::min)(m_baseDelay, rtt);
+
+		m_delays.push_back(rtt);
+		if (m_delays.size() > CURRENT_DELAY_SAMPLES)
+			m_delays.pop_front();
+
+		const auto queuing     = *std::min_element(m_delays.begin(), m_delays.end()) - m_baseDelay;
+		const double target    = std::chrono::duration<double>(m_throttle.targetDelay).count();
+		const double offTarget = std::clamp((target - std::chrono::duration<double>(queuing).count()) / target, -1.0, 1.0);
+
+		// Without a fixed limit the adaptation starts from what the download currently gets
+		double rate = (m_rate > 0.0) ? m_rate : m_measuredRate;
+		if (rate <= 0.0)
+			return;
+
+		rate *= 1.0 + GAIN * offTarget;
+		rate = (std::max)(rate, static_cast<double>(m_throttle.minBytesPerSecond));
+
+		// Without a limit, the rate must not run away from the actual throughput while the path is idle
+		if (m_throttle.bytesPerSecond > 0)
+			rate = (std::min)(rate, static_cast<double>(m_throttle.bytesPerSecond));
+		else if (m_measuredRate > 0.0)
+			rate = (std::min)(rate, 2.0 * m_measuredRate);
+
+		m_rate = rate;
+	}
+
+	// Current limit in bytes per second, 0 is unlimited
+	double Rate() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_rate;
+	}
+
+	// Throughput over the last measuring window
+	double MeasuredRate() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_measuredRate;
+	}
+
+private:
+	double burst() const
+	{
+		return (std::max)(m_rate * std::chrono::duration<double>(BURST_TIME).count(), static_cast<double>(MIN_BURST));
+	}
+
+	void measure(const size_t& bytes, const std::chrono::steady_clock::time_point& now)
+	{
+		m_windowBytes += bytes;
+
+		const auto elapsed = now - m_windowStart;
+		if (elapsed < MEASURE_WINDOW)
+			return;
+
+		m_measuredRate = static_cast<double>(m_windowBytes) / std::chrono::duration<double>(elapsed).count();
+		m_windowBytes  = 0;
+		m_windowStart  = now;
+	}
+
+	// Time to first byte of a one byte range request, sent on its own connection so it queues behind the download
+	void probe(const std::wstring& url, std::stop_token stopToken)
+	{
+		std::shared_ptr<Transport> pTransport = Transport::GetDefault();
+
+		while (!stopToken.stop_requested())
+		{
+			uint8_t byte = 0;
+			SpanSink byteSink(std::span<uint8_t>(&byte, 1));
+			ResponseSink sink([&](const Response& response) -> Sink* { return (response.status == 206) ? &byteSink : nullptr; });
+
+			Response response;
+			const auto start = std::chrono::steady_clock::now();
+			if (!pTransport->Request(url, sink, response, L"Range: bytes=0-0\r\n", nullptr, stopToken))
+			{
+				// The server doesn't support ranges, the rate stays as it is
+				if (response.status != 0)
+					return;
+			}
+			else
+				OnDelaySample(std::chrono::steady_clock::now() - start);
+
+			std::unique_lock<std::mutex> lock(m_probeMutex);
+			m_probeCv.wait_for(lock, stopToken, PROBE_INTERVAL, []() { return false; });
+		}
+	}
+
+private:
+	Throttle m_throttle;
+
+	mutable std::mutex m_mutex;
+	double m_rate;
+	double m_tokens = 0.0;
+	std::chrono::steady_clock::time_point m_last;
+
+	std::chrono::steady_clock::time_point m_windowStart;
+	uint64_t m_windowBytes = 0;
+	double m_measuredRate  = 0.0;
+
+	std::chrono::steady_clock::duration m_baseDelay = {};
+	std::deque<std::chrono::steady_clock::duration> m_delays;
+
+	std::mutex m_probeMutex;
+	std::condition_variable_any m_probeCv;
+	std::jthread m_probe; // Last, so the probe is stopped and joined before anything it uses is destroyed
+};
+
+// Limits the rate at which the target receives data
+class ThrottledSink : public Sink
+{
+public:
+	ThrottledSink(Sink& target, RateLimiter& limiter) :
+		m_target(target),
+		m_limiter(limiter)
+	{
+	}
+
+	bool OnResponse(const Response& response) override
+	{
+		return m_target.OnResponse(response);
+	}
+
+	void OnSizeHint(const uint64_t& size) override
+	{
+		m_target.OnSizeHint(size);
+	}
+
+	std::span<uint8_t> Prepare(const std::size_t& maxSize) override
+	{
+		return m_target.Prepare((std::min)(maxSize, m_limiter.MaxChunk()));
+	}
+
+	bool Commit(const std::size_t& size) override
+	{
+		if (!m_target.Commit(size))
+			return false;
+
+		m_limiter.Acquire(size);
+		return true;
+	}
+
+	bool Finish() override
+	{
+		return m_target.Finish();
+	}
+
+private:
+	Sink& m_target;
+	RateLimiter& m_limiter;
+};
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,889 @@
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <Wininet.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Http.hpp"
+#include "Sink.hpp"
+#include "Utils.hpp"
+
+#ifdef _WIN32
+#pragma comment(lib, "Wininet.lib")
+#endif
+
+// The transport performs the HTTP requests of the downloader. It lives as long as the process (or until it is replaced),
+// so all requests share one session and connections to the update server are kept alive between them.
+//   WinInetTransport  Default on Windows, supports http and https
+//   SocketTransport   Default on other platforms, plain http over POSIX sockets, e.g., for a local update server
+// A custom transport can be installed with Transport::SetDefault().
+// Requests can be cancelled from another thread with a std::stop_token, the request then fails as soon as possible.
+
+namespace selfUpdater::downloader
+{
+
+// The parts of an http(s) URL needed to open a connection
+struct Url
+{
+	std::string scheme;
+	std::string host;
+	uint16_t port = 0;
+	std::string target; // Path and query, at least "/"
+
+	static bool Parse(std::string_view url, Url& result)
+	{
+		const size_t schemeEnd = url.find("://");
+		if (schemeEnd == std::string_view::npos)
+			return false;
+
+		result.scheme = std::string(url.substr(0, schemeEnd));
+		for (char& c : result.scheme)
+			c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+		if (result.scheme != "http" && result.scheme != "https")
+			return false;
+
+		url.remove_prefix(schemeEnd + 3);
+
+		const size_t authorityEnd        = url.find_first_of("/?#");
+		const std::string_view authority = url.substr(0, authorityEnd);
+		result.target                    = (authorityEnd == std::string_view::npos) ? "/" : std::string(url.substr(authorityEnd));
+
+		if (result.target.front() != '/')
+			result.target.insert(result.target.begin(), '/');
+
+		// The fragment is never sent to the server
+		const size_t fragment = result.target.find('#');
+		if (fragment != std::string::npos)
+			result.target.resize(fragment);
+
+		// IPv6 literals are enclosed in brackets: http://[::1]:8080/
+		const size_t hostEnd = authority.starts_with('[') ? authority.find(']') + 1 : authority.rfind(':');
+		const size_t colon   = authority.find(':', (hostEnd == std::string_view::npos || hostEnd == 0) ? 0 : hostEnd);
+
+		result.host = std::string(authority.substr(0, colon));
+		result.port = (result.scheme == "https") ? 443 : 80;
+
+		if (colon != std::string_view::npos)
+		{
+			const std::string_view portStr = authority.substr(colon + 1);
+			const auto [p, err]            = std::from_chars(portStr.data(), portStr.data() + portStr.size(), result.port);
+			if (err != std::errc() || p != portStr.data() + portStr.size())
+				return false;
+		}
+
+		return !result.host.empty();
+	}
+
+	// Host and port, the key for reusing connections
+	std::string Origin() const
+	{
+		return std::format("{}:{}", host, port);
+	}
+
+	// Resolves a Location header against this URL, dot segments of relative paths are left to the server
+	std::string Resolve(std::string_view location) const
+	{
+		if (location.find("://") != std::string_view::npos)
+			return std::string(location);
+
+		if (location.starts_with("//"))
+			return std::format("{}:{}", scheme, location);
+
+		if (location.starts_with('/'))
+			return std::format("{}://{}:{}{}", scheme, host, port, location);
+
+		// Relative to the directory of the target
+		const std::string_view path = std::string_view(target).substr(0, target.find('?'));
+		return std::format("{}://{}:{}{}{}", scheme, host, port, path.substr(0, path.rfind('/') + 1), location);
+	}
+};
+
+class Transport
+{
+protected:
+	inline static const std::wstring USER_AGENT = L"Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:126.0) Gecko/20100101 Firefox/126.0";
+	static constexpr size_t READ_SIZE           = 64 * 1024;
+
+public:
+	virtual ~Transport() = default;
+
+	// Performs a single GET request, the status, the headers and the body all come from the same response.
+	// The body is written to the sink independent of the status (unless the sink rejects it), returns false only if the request itself failed.
+	// Request headers are given as "<name>: <value>\r\n" lines.
+	virtual bool Request(const std::wstring& url, Sink& sink, Response& response, const std::wstring& requestHeaders = L"", ProgressCallBack cb = nullptr, std::stop_token stopToken = {}) = 0;
+
+	// Resolves the host and opens a connection ahead of time, so the next request to it doesn't wait for the handshake
+	virtual void Preconnect([[maybe_unused]] const std::wstring& url)
+	{
+	}
+
+	static std::shared_ptr<Transport> GetDefault();
+
+	static void SetDefault(std::shared_ptr<Transport> pTransport)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_pDefault = std::move(pTransport);
+	}
+
+protected:
+	// Reads the body into the sink, read returns the number of bytes read, 0 at the end of the body and a negative value on errors
+	static bool transfer(const std::function<int64_t(uint8_t*, const size_t&)>& read, Sink& sink, const uint64_t& total, ProgressCallBack cb, const std::stop_token& stopToken)
+	{
+		if (total > 0)
+			sink.OnSizeHint(total);
+
+		uint64_t received = 0;
+
+		while (true)
+		{
+			std::span<uint8_t> buffer = sink.Prepare(READ_SIZE);
+			if (buffer.empty())
+			{
+				// The sink is full, which is only fine if the body is at its end
+				uint8_t probe;
+				const int64_t probeRead = read(&probe, 1);
+				if (probeRead == 0)
+					break;
+
+				std::cerr << "ERROR: Download exceeds the capacity of the sink" << std::endl;
+				return false;
+			}
+
+			const int64_t bytesRead = stopToken.stop_requested() ? -1 : read(buffer.data(), buffer.size());
+			if (bytesRead < 0)
+			{
+				// Leaves the sink consistent with what it received, e.g., for Mirrors to continue from there
+				sink.Commit(0);
+
+				if (!stopToken.stop_requested())
+					std::cerr << "ERROR: Download failed while receiving the data" << std::endl;
+
+				return false;
+			}
+
+			// Every Prepare() is completed by a Commit(), also at the end of the body
+			if (!sink.Commit(static_cast<size_t>(bytesRead)))
+			{
+				std::cerr << "ERROR: Download aborted by the sink" << std::endl;
+				return false;
+			}
+
+			if (bytesRead == 0)
+				break;
+
+			received += static_cast<uint64_t>(bytesRead);
+
+			if (cb)
+				cb(received, total);
+		}
+
+		return sink.Finish();
+	}
+
+private:
+	static inline std::mutex s_mutex;
+	static inline std::shared_ptr<Transport> s_pDefault;
+};
+
+#ifdef _WIN32
+// One WinINet session for all requests, WinINet keeps the connections of a session alive and reuses them on its own.
+// A cancelled request ends after the next read, WinINet has no way to abort the synchronous InternetOpenUrl() call.
+class WinInetTransport : public Transport
+{
+	struct InternetHandle
+	{
+		HINTERNET h;
+		InternetHandle(HINTERNET handle = NULL) :
+			h(handle)
+		{}
+
+		~InternetHandle()
+		{
+			if (h != NULL) InternetCloseHandle(h);
+		}
+
+		InternetHandle(const InternetHandle&)            = delete;
+		InternetHandle& operator=(const InternetHandle&) = delete;
+
+		operator HINTERNET() const
+		{
+			return h;
+		}
+	};
+
+public:
+	WinInetTransport() :
+		m_hInternet(InternetOpen(USER_AGENT.c_str(), INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0))
+	{
+	}
+
+	bool Request(const std::wstring& url, Sink& sink, Response& response, const std::wstring& requestHeaders = L"", ProgressCallBack cb = nullptr, std::stop_token stopToken = {}) override
+	{
+		if (m_hInternet == NULL)
+		{
+			std::cerr << "Failed to open internet" << std::endl;
+			return false;
+		}
+
+		InternetHandle hUrl = InternetOpenUrl(m_hInternet, url.c_str(), requestHeaders.empty() ? NULL : requestHeaders.c_str(), static_cast<DWORD>(requestHeaders.size()), INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_KEEP_CONNECTION, 0);
+		if (hUrl == NULL)
+		{
+			std::cerr << std::format("Failed to open URL, error: {}", GetLastError()) << std::endl;
+			return false;
+		}
+
+		response.status = queryStatusCode(hUrl);
+		response.headers.Parse(queryInfo(hUrl, HTTP_QUERY_RAW_HEADERS_CRLF));
+
+		if (stopToken.stop_requested() || !sink.OnResponse(response))
+			return false;
+
+		auto read = [&](uint8_t* pBuffer, const size_t& size) -> int64_t {
+			DWORD bytesRead = 0;
+			if (!InternetReadFile(hUrl, pBuffer, static_cast<DWORD>(size), &bytesRead))
+				return -1;
+
+			return bytesRead;
+		};
+
+		return transfer(read, sink, ContentLength(response), cb, stopToken);
+	}
+
+	// A HEAD request opens the connection, closing the request hands it back to the session for the next request
+	void Preconnect(const std::wstring& url) override
+	{
+		Url parsed;
+		if (m_hInternet == NULL || !Url::Parse(utils::ws2s(url), parsed))
+			return;
+
+		InternetHandle hConnect = InternetConnect(m_hInternet, utils::s2ws(parsed.host).c_str(), parsed.port, NULL, NULL, INTERNET_SERVICE_HTTP, 0, 0);
+		if (hConnect == NULL)
+			return;
+
+		const DWORD flags      = INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_KEEP_CONNECTION | (parsed.scheme == "https" ? INTERNET_FLAG_SECURE : 0);
+		InternetHandle hRequest = HttpOpenRequest(hConnect, L"HEAD", utils::s2ws(parsed.target).c_str(), NULL, NULL, NULL, flags, 0);
+		if (hRequest != NULL)
+			HttpSendRequest(hRequest, NULL, 0, NULL, 0);
+	}
+
+private:
+	static DWORD queryStatusCode(HINTERNET hUrl)
+	{
+		DWORD status = 0;
+		DWORD size   = sizeof(status);
+		if (!HttpQueryInfo(hUrl, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &status, &size, NULL))
+			return 0;
+
+		return status;
+	}
+
+	static std::wstring queryInfo(HINTERNET hUrl, const DWORD& infoLevel)
+	{
+		DWORD size = 0;
+		if (HttpQueryInfo(hUrl, infoLevel, NULL, &size, NULL) || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+			return {};
+
+		std::wstring value(size / sizeof(wchar_t) + 1, L'\0');
+		if (!HttpQueryInfo(hUrl, infoLevel, &value[0], &size, NULL))
+			return {};
+
+		value.resize(std::wcslen(value.c_str()));
+		return value;
+	}
+
+private:
+	InternetHandle m_hInternet;
+};
+#else
+// HTTP/1.1 over plain TCP sockets with a pool of keep-alive connections per host.
+// Resolved addresses are cached, Preconnect() resolves the host and parks an open connection in the pool.
+// Redirects are followed, https is not supported (use a custom transport, e.g., based on libcurl, for that).
+class SocketTransport : public Transport
+{
+	static constexpr size_t MAX_IDLE_PER_HOST = 8;
+	static constexpr uint32_t MAX_REDIRECTS   = 5;
+	static constexpr uint32_t TIMEOUT_SECONDS = 30;
+
+	class Connection
+	{
+	public:
+		Connection() = default;
+		explicit Connection(const int& fd) :
+			m_fd(fd)
+		{
+		}
+
+		~Connection()
+		{
+			Close();
+		}
+
+		Connection(Connection&& other) noexcept :
+			m_fd(std::exchange(other.m_fd, -1)),
+			m_buffer(std::move(other.m_buffer)),
+			m_pos(std::exchange(other.m_pos, 0))
+		{
+		}
+
+		Connection& operator=(Connection&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Close();
+				m_fd     = std::exchange(other.m_fd, -1);
+				m_buffer = std::move(other.m_buffer);
+				m_pos    = std::exchange(other.m_pos, 0);
+			}
+
+			return *this;
+		}
+
+		bool IsOpen() const
+		{
+			return m_fd >= 0;
+		}
+
+		int Fd() const
+		{
+			return m_fd;
+		}
+
+		void Close()
+		{
+			if (m_fd >= 0)
+				::close(m_fd);
+
+			m_fd = -1;
+			m_buffer.clear();
+			m_pos = 0;
+		}
+
+		bool Send(std::string_view data)
+		{
+			while (!data.empty())
+			{
+				const ssize_t sent = ::send(m_fd, data.data(), data.size(), SEND_FLAGS);
+				if (sent <= 0)
+					return false;
+
+				data.remove_prefix(static_cast<size_t>(sent));
+			}
+
+			return true;
+		}
+
+		// Bytes left over from reading the headers are returned first
+		int64_t Read(uint8_t* pBuffer, const size_t& size)
+		{
+			if (m_pos < m_buffer.size())
+			{
+				const size_t chunk = (std::min)(size, m_buffer.size() - m_pos);
+				std::memcpy(pBuffer, m_buffer.data() + m_pos, chunk);
+				m_pos += chunk;
+				return static_cast<int64_t>(chunk);
+			}
+
+			const ssize_t received = ::recv(m_fd, pBuffer, size, 0);
+			return (received < 0) ? -1 : received;
+		}
+
+		// Reads a line terminated by LF, the CR of CRLF is removed
+		bool ReadLine(std::string& line)
+		{
+			line.clear();
+
+			while (true)
+			{
+				if (m_pos == m_buffer.size())
+				{
+					m_buffer.resize(READ_SIZE);
+					m_pos                  = 0;
+					const ssize_t received = ::recv(m_fd, m_buffer.data(), m_buffer.size(), 0);
+					if (received <= 0)
+					{
+						m_buffer.clear();
+						return false;
+					}
+
+					m_buffer.resize(static_cast<size_t>(received));
+				}
+
+				const auto begin = m_buffer.begin() + static_cast<std::ptrdiff_t>(m_pos);
+				const auto eol   = std::find(begin, m_buffer.end(), '\n');
+
+				line.append(begin, eol);
+				m_pos = static_cast<size_t>(eol - m_buffer.begin());
+
+				if (eol != m_buffer.end())
+				{
+					m_pos++;
+					if (!line.empty() && line.back() == '\r')
+						line.pop_back();
+
+					return true;
+				}
+			}
+		}
+
+		// True if no data from a previous response is left, only then the connection can be reused
+		bool IsDrained() const
+		{
+			return m_pos == m_buffer.size();
+		}
+
+	private:
+#ifdef MSG_NOSIGNAL
+		static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+		static constexpr int SEND_FLAGS = 0;
+#endif
+
+		int m_fd = -1;
+		std::vector<uint8_t> m_buffer;
+		size_t m_pos = 0;
+	};
+
+	// Cancels a request by shutting its socket down, which ends a blocking send or recv on it right away.
+	// The socket is detached before it goes back to the pool or is closed, so a late stop never hits a socket used elsewhere.
+	class Interrupter
+	{
+	public:
+		// Returns false if the request was already cancelled
+		bool Attach(const Connection& connection)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_fd = connection.Fd();
+			return !m_interrupted;
+		}
+
+		// Returns false if the request was cancelled, the socket must not be reused then
+		bool Detach()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_fd = -1;
+			return !m_interrupted;
+		}
+
+		void Interrupt()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_interrupted = true;
+			if (m_fd >= 0)
+				::shutdown(m_fd, SHUT_RDWR);
+		}
+
+	private:
+		std::mutex m_mutex;
+		int m_fd           = -1;
+		bool m_interrupted = false;
+	};
+
+	// How the end of the body is detected
+	enum class Framing
+	{
+		None,
+		Length,
+		Chunked,
+		Close
+	};
+
+public:
+	bool Request(const std::wstring& url, Sink& sink, Response& response, const std::wstring& requestHeaders = L"", ProgressCallBack cb = nullptr, std::stop_token stopToken = {}) override
+	{
+		Url parsed;
+		if (!Url::Parse(utils::ws2s(url), parsed))
+		{
+			std::wcerr << std::format(L"[Transport] Invalid URL: {}", url) << std::endl;
+			return false;
+		}
+
+		for (uint32_t redirect = 0; redirect <= MAX_REDIRECTS; redirect++)
+		{
+			if (parsed.scheme != "http")
+			{
+				std::cerr << std::format("[Transport] Unsupported scheme: {}", parsed.scheme) << std::endl;
+				return false;
+			}
+
+			// Destroyed in reverse order: no stop callback runs anymore once the connection is closed
+			Connection connection;
+			Interrupter interrupter;
+			std::stop_callback onStop(stopToken, [&]() { interrupter.Interrupt(); });
+
+			if (!exchange(parsed, utils::ws2s(requestHeaders), connection, response, interrupter))
+				return false;
+
+			const std::optional<std::wstring_view> location = response.headers.Get(L"Location");
+			const bool isRedirect                           = (response.status == 301 || response.status == 302 || response.status == 303 || response.status == 307 || response.status == 308);
+
+			if (isRedirect && location)
+			{
+				// Discard the body of the redirect, the connection stays usable if its end is known
+				std::vector<uint8_t> body;
+				VectorSink discard(body);
+				if (!readBody(parsed, connection, response, discard, nullptr, interrupter, stopToken))
+					return false;
+
+				const std::string target = parsed.Resolve(utils::ws2s(std::wstring(*location)));
+				if (!Url::Parse(target, parsed))
+				{
+					std::cerr << std::format("[Transport] Invalid redirect target: {}", target) << std::endl;
+					return false;
+				}
+
+				continue;
+			}
+
+			if (stopToken.stop_requested() || !sink.OnResponse(response))
+				return false;
+
+			return readBody(parsed, connection, response, sink, cb, interrupter, stopToken);
+		}
+
+		std::wcerr << std::format(L"[Transport] Too many redirects for {}", url) << std::endl;
+		return false;
+	}
+
+	void Preconnect(const std::wstring& url) override
+	{
+		Url parsed;
+		if (!Url::Parse(utils::ws2s(url), parsed) || parsed.scheme != "http")
+			return;
+
+		Connection connection = connect(parsed);
+		if (connection.IsOpen())
+			release(parsed, std::move(connection));
+	}
+
+private:
+	// Sends the request and reads the status line and the headers, a stale pooled connection is replaced by a new one
+	bool exchange(const Url& url, const std::string& requestHeaders, Connection& connection, Response& response, Interrupter& interrupter)
+	{
+		std::string request = std::format("GET {} HTTP/1.1\r\nHost: {}\r\nUser-Agent: {}\r\nAccept: */*\r\nConnection: keep-alive\r\n", url.target, (url.port == 80) ? url.host : url.Origin(), utils::ws2s(USER_AGENT));
+		request += requestHeaders;
+		request += "\r\n";
+
+		for (uint32_t attempt = 0; attempt < 2; attempt++)
+		{
+			// The server may have closed an idle connection in the meantime, the second attempt always uses a new one
+			const bool reused = (attempt == 0) && acquire(url, connection);
+			if (!reused)
+				connection = connect(url);
+
+			if (!connection.IsOpen() || !interrupter.Attach(connection))
+				return false;
+
+			std::string line;
+			if (connection.Send(request) && connection.ReadLine(line))
+				return readHeaders(connection, line, response);
+
+			const bool interrupted = !interrupter.Detach();
+			connection.Close();
+
+			if (interrupted)
+				return false;
+
+			if (!reused)
+			{
+				std::cerr << std::format("[Transport] Request to {} failed", url.Origin()) << std::endl;
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	static bool readHeaders(Connection& connection, const std::string& statusLine, Response& response)
+	{
+		// HTTP/1.1 200 OK
+		const size_t space = statusLine.find(' ');
+		uint32_t status    = 0;
+		if (!statusLine.starts_with("HTTP/") || space == std::string::npos || std::from_chars(statusLine.data() + space + 1, statusLine.data() + statusLine.size(), status).ec != std::errc())
+		{
+			std::cerr << "[Transport] Invalid status line" << std::endl;
+			return false;
+		}
+
+		std::string raw = statusLine + "\r\n";
+		std::string line;
+
+		while (true)
+		{
+			if (!connection.ReadLine(line))
+			{
+				std::cerr << "[Transport] Connection closed while reading the headers" << std::endl;
+				return false;
+			}
+
+			if (line.empty())
+				break;
+
+			raw += line;
+			raw += "\r\n";
+		}
+
+		// Interim responses (100 Continue) are followed by the real one
+		if (status >= 100 && status < 200)
+		{
+			if (!connection.ReadLine(line))
+				return false;
+
+			return readHeaders(connection, line, response);
+		}
+
+		response.status = status;
+		response.headers.Parse(utils::s2ws(raw));
+
+		return true;
+	}
+
+	bool readBody(const Url& url, Connection& connection, const Response& response, Sink& sink, ProgressCallBack cb, Interrupter& interrupter, const std::stop_token& stopToken)
+	{
+		const std::wstring_view transferEncoding = response.headers.Get(L"Transfer-Encoding").value_or(L"");
+		const std::wstring_view connectionHeader = response.headers.Get(L"Connection").value_or(L"");
+		const bool http10                        = response.headers.StatusLine().starts_with(L"HTTP/1.0");
+
+		Framing framing = Framing::Close;
+		if (response.status == 204 || response.status == 304)
+			framing = Framing::None;
+		else if (transferEncoding.find(L"chunked") != std::wstring_view::npos)
+			framing = Framing::Chunked;
+		else if (response.headers.Contains(L"Content-Length"))
+			framing = Framing::Length;
+
+		bool keepAlive = (framing != Framing::Close) && (http10 ? containsToken(connectionHeader, L"keep-alive") : !containsToken(connectionHeader, L"close"));
+
+		uint64_t remaining = ContentLength(response);
+		uint64_t chunkLeft = 0;
+		bool lastChunk     = false;
+
+		auto read = [&](uint8_t* pBuffer, const size_t& size) -> int64_t {
+			switch (framing)
+			{
+				case Framing::None:
+					return 0;
+				case Framing::Length:
+				{
+					if (remaining == 0)
+						return 0;
+
+					const int64_t bytesRead = connection.Read(pBuffer, static_cast<size_t>((std::min)(static_cast<uint64_t>(size), remaining)));
+					if (bytesRead <= 0)
+						return -1;
+
+					remaining -= static_cast<uint64_t>(bytesRead);
+					return bytesRead;
+				}
+				case Framing::Chunked:
+				{
+					if (chunkLeft == 0 && !lastChunk && !nextChunk(connection, chunkLeft, lastChunk))
+						return -1;
+
+					if (lastChunk)
+						return 0;
+
+					const int64_t bytesRead = connection.Read(pBuffer, static_cast<size_t>((std::min)(static_cast<uint64_t>(size), chunkLeft)));
+					if (bytesRead <= 0)
+						return -1;
+
+					chunkLeft -= static_cast<uint64_t>(bytesRead);
+
+					// Every chunk ends with a CRLF
+					std::string line;
+					if (chunkLeft == 0 && (!connection.ReadLine(line) || !line.empty()))
+						return -1;
+
+					return bytesRead;
+				}
+				case Framing::Close:
+				default:
+					return connection.Read(pBuffer, size);
+			}
+		};
+
+		const bool success = transfer(read, sink, (framing == Framing::Length) ? remaining : 0, cb, stopToken);
+
+		// Only a completely read response leaves the connection in a state where the next request can be sent
+		const bool complete = (framing == Framing::None) || (framing == Framing::Length && remaining == 0) || (framing == Framing::Chunked && lastChunk);
+		if (interrupter.Detach() && success && keepAlive && complete && connection.IsDrained())
+			release(url, std::move(connection));
+
+		return success;
+	}
+
+	// Reads the size line of the next chunk, after the last chunk the trailer is skipped
+	static bool nextChunk(Connection& connection, uint64_t& size, bool& last)
+	{
+		std::string line;
+		if (!connection.ReadLine(line))
+			return false;
+
+		const auto [p, err] = std::from_chars(line.data(), line.data() + line.size(), size, 16);
+		if (err != std::errc())
+			return false;
+
+		if (size > 0)
+			return true;
+
+		last = true;
+		while (connection.ReadLine(line))
+		{
+			if (line.empty())
+				return true;
+		}
+
+		return false;
+	}
+
+	static bool containsToken(std::wstring_view value, std::wstring_view token)
+	{
+		std::wstring lower(value);
+		for (wchar_t& c : lower)
+			c = static_cast<wchar_t>(std::towlower(c));
+
+		return lower.find(token) != std::wstring::npos;
+	}
+
+	bool acquire(const Url& url, Connection& connection)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::vector<Connection>& idle = m_idle[url.Origin()];
+		if (idle.empty())
+			return false;
+
+		connection = std::move(idle.back());
+		idle.pop_back();
+
+		return true;
+	}
+
+	void release(const Url& url, Connection&& connection)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::vector<Connection>& idle = m_idle[url.Origin()];
+		if (idle.size() < MAX_IDLE_PER_HOST)
+			idle.push_back(std::move(connection));
+	}
+
+	Connection connect(const Url& url)
+	{
+		for (uint32_t attempt = 0; attempt < 2; attempt++)
+		{
+			// A cached address that doesn't work anymore is resolved again
+			const std::vector<sockaddr_storage> addresses = resolve(url, attempt > 0);
+
+			for (const sockaddr_storage& address : addresses)
+			{
+				const int fd = ::socket(address.ss_family, SOCK_STREAM, 0);
+				if (fd < 0)
+					continue;
+
+				Connection connection(fd);
+
+				timeval timeout = {};
+				timeout.tv_sec  = TIMEOUT_SECONDS;
+				setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+				setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+				// Requests are small and sent at once, don't wait for more data
+				const int noDelay = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+				const socklen_t length = (address.ss_family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+				if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), length) == 0)
+					return connection;
+			}
+		}
+
+		std::cerr << std::format("[Transport] Failed to connect to {}", url.Origin()) << std::endl;
+		return Connection();
+	}
+
+	std::vector<sockaddr_storage> resolve(const Url& url, const bool& refresh)
+	{
+		const std::string origin = url.Origin();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			const auto it = m_resolved.find(origin);
+			if (it != m_resolved.end() && !refresh)
+				return it->second;
+		}
+
+		addrinfo hints    = {};
+		hints.ai_family   = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* pResult = nullptr;
+		if (getaddrinfo(url.host.c_str(), std::to_string(url.port).c_str(), &hints, &pResult) != 0)
+			return {};
+
+		std::vector<sockaddr_storage> addresses;
+		for (const addrinfo* pInfo = pResult; pInfo != nullptr; pInfo = pInfo->ai_next)
+		{
+			sockaddr_storage address = {};
+			std::memcpy(&address, pInfo->ai_addr, (std::min)(static_cast<size_t>(pInfo->ai_addrlen), sizeof(address)));
+			addresses.push_back(address);
+		}
+
+		freeaddrinfo(pResult);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_resolved[origin] = addresses;
+
+		return addresses;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::map<std::string, std::vector<Connection>> m_idle;
+	std::map<std::string, std::vector<sockaddr_storage>> m_resolved;
+};
+#endif
+
+inline std::shared_ptr<Transport> Transport::GetDefault()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+
+	if (s_pDefault == nullptr)
+	{
+#ifdef _WIN32
+		s_pDefault = std::make_shared<WinInetTransport>();
+#else
+		s_pDefault = std::make_shared<SocketTransport>();
+#endif
+	}
+
+	return s_pDefault;
+}
+
+} // namespace selfUpdater::downloader
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <thread>
+#include <utility>
+
+#include "MappedFile.hpp"
+
+// SSE2 is part of x64, AVX2 is detected at runtime with MSVC and used if the compiler targets it otherwise
+#if defined(_M_X64) || defined(__SSE2__)
+#define SU_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(_MSC_VER) && defined(_M_X64)) || defined(__AVX2__)
+#define SU_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(SU_HAS_AVX2)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define SU_FORCE_INLINE __forceinline
+#else
+#define SU_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace selfUpdater::hash
+{
+
+// BLAKE3 tree hash (unkeyed, 32 byte output).
+// The input is split into 1 KiB chunks which are hashed independently, several at once using SIMD,
+// and the chaining values are merged as a binary tree. Large subtrees are hashed on separate threads.
+class Blake3
+{
+	static constexpr size_t CHUNK_LEN        = 1024;
+	static constexpr size_t BLOCK_LEN        = 64;
+	static constexpr size_t BLOCKS_PER_CHUNK = CHUNK_LEN / BLOCK_LEN;
+	static constexpr size_t MAX_LANES        = 8;
+	static constexpr size_t MIN_TASK_SIZE    = 1024 * 1024; // Smaller subtrees are not worth a thread
+
+	static constexpr uint32_t CHUNK_START = 1 << 0;
+	static constexpr uint32_t CHUNK_END   = 1 << 1;
+	static constexpr uint32_t PARENT      = 1 << 2;
+	static constexpr uint32_t ROOT        = 1 << 3;
+
+	static constexpr std::array<uint32_t, 8> IV = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+
+	// Message word order of every round, i.e., the permutation applied repeatedly
+	static constexpr uint8_t SCHEDULE[7][16] = {
+		{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+		{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+		{ 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+		{ 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+		{ 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+		{ 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+		{ 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+	};
+
+public:
+	static constexpr size_t DIGEST_SIZE = 32;
+	using Digest                        = std::array<uint8_t, DIGEST_SIZE>;
+
+	// threads = 0 uses all cores
+	static Digest Hash(const uint8_t* pData, const size_t& size, uint32_t threads = 0)
+	{
+		if (threads == 0)
+			threads = (std::max)(1u, std::thread::hardware_concurrency());
+
+		Cv root;
+		if (size <= CHUNK_LEN)
+			root = chunkCv(pData, size, 0, ROOT);
+		else
+		{
+			const auto [left, right] = children(pData, size, 0, threads);
+			root                     = parentCv(left, right, ROOT);
+		}
+
+		Digest digest;
+		for (size_t i = 0; i < root.size(); i++)
+			store32(digest.data() + i * 4, root[i]);
+
+		return digest;
+	}
+
+	static bool HashFile(const std::filesystem::path& filePath, Digest& digest, const uint32_t& threads = 0)
+	{
+		utils::MappedFile file(filePath);
+		if (!file.IsOpen())
+			return false;
+
+		digest = Hash(file.Data(), static_cast<size_t>(file.Size()), threads);
+		return true;
+	}
+
+	// Name of the SIMD kernel used on this machine
+	static const char* Kernel()
+	{
+		return kernel().pName;
+	}
+
+private:
+	using Cv         = std::array<uint32_t, 8>;
+	using HashChunks = void (*)(const uint8_t* const* ppInputs, const uint64_t& counter, Cv* pOut);
+
+	struct KernelInfo
+	{
+		size_t lanes;
+		HashChunks hashChunks;
+		const char* pName;
+	};
+
+	// Vector types for the chunk kernel, every lane hashes a different chunk
+	struct Portable
+	{
+		using V                       = uint32_t;
+		static constexpr size_t LANES = 1;
+
+		static V Set1(const uint32_t& x) { return x; }
+		static V Load(const uint32_t* p) { return *p; }
+		static void Store(uint32_t* p, const V& v) { *p = v; }
+		static V Add(const V& a, const V& b) { return a + b; }
+		static V Xor(const V& a, const V& b) { return a ^ b; }
+
+		template<int N>
+		static V Rotr(const V& x)
+		{
+			return std::rotr(x, N);
+		}
+
+		static void LoadMessage(const uint8_t* const* ppInputs, const size_t& offset, V* pM)
+		{
+			for (size_t i = 0; i < 16; i++)
+				pM[i] = load32(ppInputs[0] + offset + i * 4);
+		}
+	};
+
+#ifdef SU_HAS_SSE2
+	struct Sse2
+	{
+		using V                       = __m128i;
+		static constexpr size_t LANES = 4;
+
+		static V Set1(const uint32_t& x) { return _mm_set1_epi32(static_cast<int>(x)); }
+		static V Load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static void Store(uint32_t* p, const V& v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+		static V Add(const V& a, const V& b) { return _mm_add_epi32(a, b); }
+		static V Xor(const V& a, const V& b) { return _mm_xor_si128(a, b); }
+
+		template<int N>
+		static V Rotr(const V& x)
+		{
+			return _mm_or_si128(_mm_srli_epi32(x, N), _mm_slli_epi32(x, 32 - N));
+		}
+
+		// Loads 4 words of every chunk and transposes them, so each vector holds the same word of all chunks
+		static void LoadMessage(const uint8_t* const* ppInputs, const size_t& offset, V* pM)
+		{
+			for (size_t q = 0; q < 4; q++)
+			{
+				const V a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ppInputs[0] + offset + q * 16));
+				const V b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ppInputs[1] + offset + q * 16));
+				const V c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ppInputs[2] + offset + q * 16));
+				const V d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ppInputs[3] + offset + q * 16));
+
+				const V ab01 = _mm_unpacklo_epi32(a, b);
+				const V cd01 = _mm_unpacklo_epi32(c, d);
+				const V ab23 = _mm_unpackhi_epi32(a, b);
+				const V cd23 = _mm_unpackhi_epi32(c, d);
+
+				pM[q * 4 + 0] = _mm_unpacklo_epi64(ab01, cd01);
+				pM[q * 4 + 1] = _mm_unpackhi_epi64(ab01, cd01);
+				pM[q * 4 + 2] = _mm_unpacklo_epi64(ab23, cd23);
+				pM[q * 4 + 3] = _mm_unpackhi_epi64(ab23, cd23);
+			}
+		}
+	};
+#endif
+
+#ifdef SU_HAS_AVX2
+	struct Avx2
+	{
+		using V                       = __m256i;
+		static constexpr size_t LANES = 8;
+
+		static V Set1(const uint32_t& x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+		static V Load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static void Store(uint32_t* p, const V& v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		static V Add(const V& a, const V& b) { return _mm256_add_epi32(a, b); }
+		static V Xor(const V& a, const V& b) { return _mm256_xor_si256(a, b); }
+
+		template<int N>
+		static V Rotr(const V& x)
+		{
+			// Rotations by whole bytes are a single shuffle
+			if constexpr (N == 16)
+				return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+			else if constexpr (N == 8)
+				return _mm256_shuffle_epi8(x, _mm256_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1, 12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+			else
+				return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+		}
+
+		// 8x8 transpose of 8 words from every chunk
+		static void LoadMessage(const uint8_t* const* ppInputs, const size_t& offset, V* pM)
+		{
+			for (size_t h = 0; h < 2; h++)
+			{
+				V r[8];
+				for (size_t j = 0; j < 8; j++)
+					r[j] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ppInputs[j] + offset + h * 32));
+
+				V t[8];
+				for (size_t j = 0; j < 8; j += 2)
+				{
+					t[j]     = _mm256_unpacklo_epi32(r[j], r[j + 1]);
+					t[j + 1] = _mm256_unpackhi_epi32(r[j], r[j + 1]);
+				}
+
+				V u[8];
+				for (size_t j = 0; j < 8; j += 4)
+				{
+					u[j]     = _mm256_unpacklo_epi64(t[j], t[j + 2]);
+					u[j + 1] = _mm256_unpackhi_epi64(t[j], t[j + 2]);
+					u[j + 2] = _mm256_unpacklo_epi64(t[j + 1], t[j + 3]);
+					u[j + 3] = _mm256_unpackhi_epi64(t[j + 1], t[j + 3]);
+				}
+
+				for (size_t k = 0; k < 4; k++)
+				{
+					pM[h * 8 + k]     = _mm256_permute2x128_si256(u[k], u[k + 4], 0x20);
+					pM[h * 8 + k + 4] = _mm256_permute2x128_si256(u[k], u[k + 4], 0x31);
+				}
+			}
+		}
+	};
+#endif
+
+	template<typename L>
+	SU_FORCE_INLINE static void g(typename L::V* v, const size_t& a, const size_t& b, const size_t& c, const size_t& d, const typename L::V& mx, const typename L::V& my)
+	{
+		v[a] = L::Add(L::Add(v[a], v[b]), mx);
+		v[d] = L::template Rotr<16>(L::Xor(v[d], v[a]));
+		v[c] = L::Add(v[c], v[d]);
+		v[b] = L::template Rotr<12>(L::Xor(v[b], v[c]));
+		v[a] = L::Add(L::Add(v[a], v[b]), my);
+		v[d] = L::template Rotr<8>(L::Xor(v[d], v[a]));
+		v[c] = L::Add(v[c], v[d]);
+		v[b] = L::template Rotr<7>(L::Xor(v[b], v[c]));
+	}
+
+	template<typename L>
+	SU_FORCE_INLINE static void round(typename L::V* v, const typename L::V* m, const uint8_t* s)
+	{
+		g<L>(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+		g<L>(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+		g<L>(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+		g<L>(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+		g<L>(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+		g<L>(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+		g<L>(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+		g<L>(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+	}
+
+	// Written out, so the compiler can keep the whole state in registers
+	template<typename L>
+	SU_FORCE_INLINE static void rounds(typename L::V* v, const typename L::V* m)
+	{
+		round<L>(v, m, SCHEDULE[0]);
+		round<L>(v, m, SCHEDULE[1]);
+		round<L>(v, m, SCHEDULE[2]);
+		round<L>(v, m, SCHEDULE[3]);
+		round<L>(v, m, SCHEDULE[4]);
+		round<L>(v, m, SCHEDULE[5]);
+		round<L>(v, m, SCHEDULE[6]);
+	}
+
+	// Hashes L::LANES complete chunks with consecutive counters at once
+	template<typename L>
+	static void hashChunks(const uint8_t* const* ppInputs, const uint64_t& counter, Cv* pOut)
+	{
+		using V = typename L::V;
+
+		uint32_t counterLo[L::LANES];
+		uint32_t counterHi[L::LANES];
+		for (size_t j = 0; j < L::LANES; j++)
+		{
+			counterLo[j] = static_cast<uint32_t>(counter + j);
+			counterHi[j] = static_cast<uint32_t>((counter + j) >> 32);
+		}
+
+		V h[8];
+		for (size_t i = 0; i < 8; i++)
+			h[i] = L::Set1(IV[i]);
+
+		for (size_t b = 0; b < BLOCKS_PER_CHUNK; b++)
+		{
+			V m[16];
+			L::LoadMessage(ppInputs, b * BLOCK_LEN, m);
+
+			const uint32_t flags = (b == 0 ? CHUNK_START : 0) | (b == BLOCKS_PER_CHUNK - 1 ? CHUNK_END : 0);
+
+			V v[16] = {
+				h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+				L::Set1(IV[0]), L::Set1(IV[1]), L::Set1(IV[2]), L::Set1(IV[3]),
+				L::Load(counterLo), L::Load(counterHi), L::Set1(static_cast<uint32_t>(BLOCK_LEN)), L::Set1(flags)
+			};
+
+			rounds<L>(v, m);
+
+			for (size_t i = 0; i < 8; i++)
+				h[i] = L::Xor(v[i], v[i + 8]);
+		}
+
+		uint32_t lanes[L::LANES];
+		for (size_t i = 0; i < 8; i++)
+		{
+			L::Store(lanes, h[i]);
+			for (size_t j = 0; j < L::LANES; j++)
+				pOut[j][i] = lanes[j];
+		}
+	}
+
+	static bool hasAvx2()
+	{
+#if defined(__AVX2__)
+		return true;
+#elif defined(SU_HAS_AVX2)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// AVX has to be enabled by the OS as well (OSXSAVE and YMM state in XCR0)
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	static const KernelInfo& kernel()
+	{
+		static const KernelInfo info = []() -> KernelInfo {
+#ifdef SU_HAS_AVX2
+			if (hasAvx2())
+				return { Avx2::LANES, &hashChunks<Avx2>, "avx2" };
+#endif
+#ifdef SU_HAS_SSE2
+			return { Sse2::LANES, &hashChunks<Sse2>, "sse2" };
+#else
+			return { Portable::LANES, &hashChunks<Portable>, "portable" };
+#endif
+		}();
+
+		return info;
+	}
+
+	static Cv compress(const Cv& cv, const uint8_t* pBlock, const uint64_t& counter, const uint32_t& blockLen, const uint32_t& flags)
+	{
+		uint32_t m[16];
+		Portable::LoadMessage(&pBlock, 0, m);
+
+		uint32_t v[16] = {
+			cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+			IV[0], IV[1], IV[2], IV[3],
+			static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32), blockLen, flags
+		};
+
+		rounds<Portable>(v, m);
+
+		Cv out;
+		for (size_t i = 0; i < 8; i++)
+			out[i] = v[i] ^ v[i + 8];
+
+		return out;
+	}
+
+	// Chaining value of a single (possibly partial) chunk
+	static Cv chunkCv(const uint8_t* pData, const size_t& size, const uint64_t& counter, const uint32_t& rootFlag)
+	{
+		const size_t blocks = (std::max)(static_cast<size_t>(1), (size + BLOCK_LEN - 1) / BLOCK_LEN);
+		Cv cv               = IV;
+
+		for (size_t b = 0; b < blocks; b++)
+		{
+			const size_t blockLen = (std::min)(BLOCK_LEN, size - b * BLOCK_LEN);
+			const bool last       = (b == blocks - 1);
+
+			uint8_t block[BLOCK_LEN] = {};
+			if (blockLen > 0)
+				std::memcpy(block, pData + b * BLOCK_LEN, blockLen);
+
+			const uint32_t flags = (b == 0 ? CHUNK_START : 0) | (last ? CHUNK_END | rootFlag : 0);
+			cv                   = compress(cv, block, counter, static_cast<uint32_t>(blockLen), flags);
+		}
+
+		return cv;
+	}
+
+	static Cv parentCv(const Cv& left, const Cv& right, const uint32_t& rootFlag)
+	{
+		uint8_t block[BLOCK_LEN];
+		for (size_t i = 0; i < 8; i++)
+		{
+			store32(block + i * 4, left[i]);
+			store32(block + 32 + i * 4, right[i]);
+		}
+
+		return compress(IV, block, 0, static_cast<uint32_t>(BLOCK_LEN), PARENT | rootFlag);
+	}
+
+	// The left subtree always holds the largest power of two number of chunks that leaves at least one byte for the right one
+	static size_t leftLength(const size_t& size)
+	{
+		return std::bit_floor((size - 1) / CHUNK_LEN) * CHUNK_LEN;
+	}
+
+	static std::pair<Cv, Cv> children(const uint8_t* pData, const size_t& size, const uint64_t& counter, const uint32_t& threads)
+	{
+		const size_t leftLen        = leftLength(size);
+		const uint64_t rightCounter = counter + leftLen / CHUNK_LEN;
+
+		if (threads > 1 && size >= 2 * MIN_TASK_SIZE)
+		{
+			std::future<Cv> left = std::async(std::launch::async, [=]() { return subtreeCv(pData, leftLen, counter, threads / 2); });
+			const Cv right       = subtreeCv(pData + leftLen, size - leftLen, rightCounter, threads - threads / 2);
+
+			return { left.get(), right };
+		}
+
+		return { subtreeCv(pData, leftLen, counter, 1), subtreeCv(pData + leftLen, size - leftLen, rightCounter, 1) };
+	}
+
+	static Cv subtreeCv(const uint8_t* pData, const size_t& size, const uint64_t& counter, const uint32_t& threads)
+	{
+		if (size > MAX_LANES * CHUNK_LEN)
+		{
+			const auto [left, right] = children(pData, size, counter, threads);
+			return parentCv(left, right, 0);
+		}
+
+		// Few enough chunks to hash them in one go with the SIMD kernel
+		const KernelInfo& k = kernel();
+		const size_t chunks = (size + CHUNK_LEN - 1) / CHUNK_LEN;
+		const size_t full   = size / CHUNK_LEN;
+
+		std::array<Cv, MAX_LANES> cvs;
+		const uint8_t* inputs[MAX_LANES];
+		size_t done = 0;
+
+		for (; done + k.lanes <= full; done += k.lanes)
+		{
+			for (size_t j = 0; j < k.lanes; j++)
+				inputs[j] = pData + (done + j) * CHUNK_LEN;
+
+			k.hashChunks(inputs, counter + done, cvs.data() + done);
+		}
+
+		for (; done < chunks; done++)
+			cvs[done] = chunkCv(pData + done * CHUNK_LEN, (std::min)(CHUNK_LEN, size - done * CHUNK_LEN), counter + done, 0);
+
+		return mergeCvs(cvs.data(), chunks);
+	}
+
+	static Cv mergeCvs(const Cv* pCvs, const size_t& count)
+	{
+		if (count == 1)
+			return pCvs[0];
+
+		const size_t left = std::bit_floor(count - 1);
+		return parentCv(mergeCvs(pCvs, left), mergeCvs(pCvs + left, count - left), 0);
+	}
+
+	static uint32_t load32(const uint8_t* p)
+	{
+		return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+	}
+
+	static void store32(uint8_t* p, const uint32_t& value)
+	{
+		p[0] = static_cast<uint8_t>(value);
+		p[1] = static_cast<uint8_t>(value >> 8);
+		p[2] = static_cast<uint8_t>(value >> 16);
+		p[3] = static_cast<uint8_t>(value >> 24);
+	}
+};
+
+} // namespace selfUpdater::hash
@@ -1,8 +1,11 @@
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include <cwctype>
 #include <format>
 #include <iostream>
@@ -12,6 +15,7 @@
 
 namespace selfUpdater::utils
 {
+#ifdef _WIN32
 // A helper function to set up the console for debugging in GUI applications
 inline void SetupConsole()
 {
@@ -65,10 +69,75 @@ inline std::string ToUTF8(const std::wstring& utf16String)
 
 	return utf8Str;
 }
+#else
+// Without the Windows API the conversion is done by hand, wchar_t is UTF-32 on these platforms
+inline std::wstring ToUTF16(const std::string& utf8String)
+{
+	std::wstring wideStr;
+	wideStr.reserve(utf8String.size());
+
+	for (size_t i = 0; i < utf8String.size();)
+	{
+		const uint8_t lead = static_cast<uint8_t>(utf8String[i]);
+		const size_t len   = (lead < 0x80) ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+
+		if (len == 0 || i + len > utf8String.size())
+		{
+			wideStr.push_back(L'\uFFFD');
+			i++;
+			continue;
+		}
+
+		uint32_t cp = (len == 1) ? lead : (lead & (0x7F >> len));
+		for (size_t j = 1; j < len; j++)
+			cp = (cp << 6) | (static_cast<uint8_t>(utf8String[i + j]) & 0x3F);
+
+		wideStr.push_back(static_cast<wchar_t>(cp));
+		i += len;
+	}
+
+	return wideStr;
+}
+
+inline std::string ToUTF8(const std::wstring& utf16String)
+{
+	std::string utf8Str;
+	utf8Str.reserve(utf16String.size());
+
+	for (const wchar_t& ch : utf16String)
+	{
+		const uint32_t cp = static_cast<uint32_t>(ch);
+
+		if (cp < 0x80)
+			utf8Str.push_back(static_cast<char>(cp));
+		else if (cp < 0x800)
+		{
+			utf8Str.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+			utf8Str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+		}
+		else if (cp < 0x10000)
+		{
+			utf8Str.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+			utf8Str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+			utf8Str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+		}
+		else
+		{
+			utf8Str.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+			utf8Str.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+			utf8Str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+			utf8Str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+		}
+	}
+
+	return utf8Str;
+}
+#endif
 
 #define s2ws ToUTF16
 #define ws2s ToUTF8
 
+#ifdef _WIN32
 inline std::wstring GetExecutablePath(HMODULE hModule = nullptr, uint32_t maxAttempts = 5)
 {
 	// Workaround to properly call numeric_limits::max even when the max macro of Windows.h is defined
@@ -116,6 +185,7 @@ inline std::wstring GetExecutablePath(HMODULE hModule = nullptr, uint32_t maxAtt
 	std::wstring errorMsg(ss.str().begin(), ss.str().end());
 	throw std::runtime_error(ws2s(errorMsg));
 }
+#endif
 
 // trim from start (in place)
 inline void ltrim(std::string& s)
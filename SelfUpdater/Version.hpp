@@ -1,119 +1,154 @@
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <array>
+#include <charconv>
+#include <compare>
 #include <cstdint>
+#include <functional>
 #include <format>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "PeVersion.hpp"
 #include "Utils.hpp"
 
-#pragma comment(lib, "version.lib")
+// The version of the application can be compiled in, so it doesn't have to be read from the executable at startup.
+// Either define SU_EMBEDDED_VERSION as "major, minor, revision, build" or set SU_VERSION_HEADER to the header
+// generated by tools/IncResVer, reading the version resource is then only the fallback if neither is set.
+// A prerelease build defines SU_EMBEDDED_PRERELEASE as its tag, e.g., "rc.1", the resource can't hold one.
+#ifdef SU_VERSION_HEADER
+#include SU_VERSION_HEADER
+#endif
+
+// The version format is fixed at compile time, define SU_MS_VERSION_FORMAT for major.minor.build.revision,
+// otherwise versions are written as major.minor.revision.build
 
 namespace selfUpdater::version
 {
-class ResVersion
+enum class VersionFormat
+{
+	Default,  // major.minor.revision.build
+	Microsoft // major.minor.build.revision
+};
+
+// The four parts are packed into a single integer in the order they are written (and compared) in the given format,
+// so comparing two versions is one integer compare and the low 32 bit are the LS part of the resource version
+template<VersionFormat FORMAT>
+class BasicResVersion
 {
 public:
-	static inline bool s_msFormat = false; // true = major.minor.build.revision, false = major.minor.revision.build
+	static constexpr bool MS_FORMAT = (FORMAT == VersionFormat::Microsoft);
 
 public:
-	ResVersion() = default;
-	ResVersion(const uint16_t& major, const uint16_t& minor, const uint16_t& revision = 0, const uint16_t& build = 0) :
-		m_major(major), m_minor(minor), m_revision(revision), m_build(build)
+	constexpr BasicResVersion() = default;
+	constexpr BasicResVersion(const uint16_t& major, const uint16_t& minor, const uint16_t& revision = 0, const uint16_t& build = 0) :
+		m_key(pack(major, minor, MS_FORMAT ? build : revision, MS_FORMAT ? revision : build)), m_valid(true)
 	{
-		m_valid = true;
 	}
 
-	ResVersion(const uint32_t& ms, const uint32_t& ls)
+	constexpr BasicResVersion(const uint32_t& ms, const uint32_t& ls) :
+		m_key((static_cast<uint64_t>(ms) << 32) | ls), m_valid(true)
 	{
-		m_major    = HIWORD(ms);
-		m_minor    = LOWORD(ms);
-		m_build    = (s_msFormat ? HIWORD(ls) : LOWORD(ls));
-		m_revision = (s_msFormat ? LOWORD(ls) : HIWORD(ls));
+	}
 
-		m_valid = true;
+	explicit BasicResVersion(std::string_view verStr)
+	{
+		Parse(verStr, *this);
 	}
 
-	explicit ResVersion(const std::string& verStr)
+	// Parses major.minor.revision[.build] (or major.minor.build[.revision] in the Microsoft format), doesn't throw on invalid input
+	static bool Parse(std::string_view verStr, BasicResVersion& version)
 	{
-		std::vector<std::string> parts = utils::Split(verStr, '.');
-		if (parts.size() == 4)
-		{
-			m_major    = static_cast<uint16_t>(std::stoi(parts[0]));
-			m_minor    = static_cast<uint16_t>(std::stoi(parts[1]));
-			m_revision = static_cast<uint16_t>(std::stoi(parts[2]));
-			m_build    = static_cast<uint16_t>(std::stoi(parts[3]));
-			m_valid    = true;
-		}
-		else if (parts.size() == 3)
-		{
-			m_major    = static_cast<uint16_t>(std::stoi(parts[0]));
-			m_minor    = static_cast<uint16_t>(std::stoi(parts[1]));
-			m_revision = static_cast<uint16_t>(std::stoi(parts[2]));
-			m_build    = 0;
-			m_valid    = true;
-		}
-		else
+		std::array<uint16_t, 4> parts = { 0, 0, 0, 0 };
+		const char* pCur              = verStr.data();
+		const char* pEnd              = verStr.data() + verStr.size();
+		size_t count                  = 0;
+
+		while (count < parts.size())
 		{
-			m_valid = false;
-			return;
+			const auto [pNext, ec] = std::from_chars(pCur, pEnd, parts[count]);
+			if (ec != std::errc())
+				return false;
+
+			count++;
+			pCur = pNext;
+
+			// A separator after the last part is left over and rejected below
+			if (pCur == pEnd || *pCur != '.' || count == parts.size())
+				break;
+
+			pCur++;
 		}
 
-		// Because in the default Microsoft format version string is defined as major.minor.build.revision revision and build have to be swapped
-		if (s_msFormat)
-			std::swap(m_build, m_revision);
+		if (pCur != pEnd || count < 3)
+			return false;
+
+		// The parts are in written order, which is the packing order in both formats
+		version.m_key   = pack(parts[0], parts[1], parts[2], parts[3]);
+		version.m_valid = true;
+
+		return true;
 	}
 
-	operator bool() const
+	constexpr operator bool() const
 	{
 		return m_valid;
 	}
 
-	const bool IsValid() const
+	constexpr bool IsValid() const
 	{
 		return m_valid;
 	}
 
-	void SetMajor(const uint16_t& major)
+	constexpr const uint64_t& Key() const
 	{
-		m_major = major;
+		return m_key;
 	}
 
-	void SetMinor(const uint16_t& minor)
+	constexpr void SetMajor(const uint16_t& major)
 	{
-		m_minor = minor;
+		setPart(48, major);
 	}
 
-	void SetRevision(const uint16_t& revision)
+	constexpr void SetMinor(const uint16_t& minor)
 	{
-		m_revision = revision;
+		setPart(32, minor);
 	}
 
-	void SetBuild(const uint16_t& build)
+	constexpr void SetRevision(const uint16_t& revision)
 	{
-		m_build = build;
+		setPart(REVISION_SHIFT, revision);
 	}
 
-	const uint16_t& GetMajor() const
+	constexpr void SetBuild(const uint16_t& build)
 	{
-		return m_major;
+		setPart(BUILD_SHIFT, build);
 	}
 
-	const uint16_t& GetMinor() const
+	constexpr uint16_t GetMajor() const
 	{
-		return m_minor;
+		return part(48);
 	}
 
-	const uint16_t& GetRevision() const
+	constexpr uint16_t GetMinor() const
 	{
-		return m_revision;
+		return part(32);
 	}
 
-	const uint16_t& GetBuild() const
+	constexpr uint16_t GetRevision() const
 	{
-		return m_build;
+		return part(REVISION_SHIFT);
+	}
+
+	constexpr uint16_t GetBuild() const
+	{
+		return part(BUILD_SHIFT);
 	}
 
 	std::wstring ToWString(const uint32_t lvl = 3) const
@@ -126,103 +161,14 @@ public:
 		return toString(lvl);
 	}
 
-	bool operator>(const ResVersion& other) const
+	constexpr std::strong_ordering operator<=>(const BasicResVersion& other) const
 	{
-		if (m_major > other.m_major)
-			return true;
-		if (m_major < other.m_major)
-			return false;
-
-		if (m_minor > other.m_minor)
-			return true;
-		if (m_minor < other.m_minor)
-			return false;
-
-		if (s_msFormat)
-		{
-			if (m_build > other.m_build)
-				return true;
-			if (m_build < other.m_build)
-				return false;
-			if (m_revision > other.m_revision)
-				return true;
-			if (m_revision < other.m_revision)
-				return false;
-		}
-		else
-		{
-			if (m_revision > other.m_revision)
-				return true;
-			if (m_revision < other.m_revision)
-				return false;
-			if (m_build > other.m_build)
-				return true;
-			if (m_build < other.m_build)
-				return false;
-		}
-
-		return false;
+		return m_key <=> other.m_key;
 	}
 
-	bool operator<(const ResVersion& other) const
+	constexpr bool operator==(const BasicResVersion& other) const
 	{
-		if (m_major < other.m_major)
-			return true;
-		if (m_major > other.m_major)
-			return false;
-
-		if (m_minor < other.m_minor)
-			return true;
-		if (m_minor > other.m_minor)
-			return false;
-
-		if (s_msFormat)
-		{
-			if (m_build < other.m_build)
-				return true;
-			if (m_build > other.m_build)
-				return false;
-			if (m_revision < other.m_revision)
-				return true;
-			if (m_revision > other.m_revision)
-				return false;
-		}
-		else
-		{
-			if (m_revision < other.m_revision)
-				return true;
-			if (m_revision > other.m_revision)
-				return false;
-			if (m_build < other.m_build)
-				return true;
-			if (m_build > other.m_build)
-				return false;
-		}
-
-		return false;
-	}
-
-	bool operator==(const ResVersion& other) const
-	{
-		if (s_msFormat)
-			return m_major == other.m_major && m_minor == other.m_minor && m_build == other.m_build && m_revision == other.m_revision;
-		else
-			return m_major == other.m_major && m_minor == other.m_minor && m_revision == other.m_revision && m_build == other.m_build;
-	}
-
-	bool operator!=(const ResVersion& other) const
-	{
-		return !(*this == other);
-	}
-
-	bool operator<=(const ResVersion& other) const
-	{
-		return *this < other || *this == other;
-	}
-
-	bool operator>=(const ResVersion& other) const
-	{
-		return *this > other || *this == other;
+		return m_key == other.m_key;
 	}
 
 	///////////////////////////
@@ -249,33 +195,33 @@ public:
 		return std::wstring(pStr) + ToWString(4);
 	}
 
-	friend std::string operator+(const std::string& str, const ResVersion& version)
+	friend std::string operator+(const std::string& str, const BasicResVersion& version)
 	{
 		return str + version.ToString(4);
 	}
 
-	friend std::string operator+(const char* pStr, const ResVersion& version)
+	friend std::string operator+(const char* pStr, const BasicResVersion& version)
 	{
 		return std::string(pStr) + version.ToString(4);
 	}
 
-	friend std::wstring operator+(const std::wstring& str, const ResVersion& version)
+	friend std::wstring operator+(const std::wstring& str, const BasicResVersion& version)
 	{
 		return str + version.ToWString(4);
 	}
 
-	friend std::wstring operator+(const wchar_t* pStr, const ResVersion& version)
+	friend std::wstring operator+(const wchar_t* pStr, const BasicResVersion& version)
 	{
 		return std::wstring(pStr) + version.ToWString(4);
 	}
 
-	friend std::wostream& operator<<(std::wostream& os, const ResVersion& version)
+	friend std::wostream& operator<<(std::wostream& os, const BasicResVersion& version)
 	{
 		os << version.ToWString(4);
 		return os;
 	}
 
-	friend std::ostream& operator<<(std::ostream& os, const ResVersion& version)
+	friend std::ostream& operator<<(std::ostream& os, const BasicResVersion& version)
 	{
 		os << version.ToString(4);
 		return os;
@@ -285,16 +231,18 @@ public:
 	/// String Operators End
 	///////////////////////////
 
-	static ResVersion GetVersionInfo()
+#ifdef _WIN32
+	static BasicResVersion GetVersionInfo()
 	{
 		TCHAR szPath[MAX_PATH];
 		GetModuleFileName(NULL, szPath, MAX_PATH);
 		return GetVersionInfo(szPath);
 	}
+#endif
 
-	static ResVersion GetVersionInfo(const std::wstring& exe)
+	static BasicResVersion GetVersionInfo(const std::wstring& exe)
 	{
-		ResVersion version;
+		BasicResVersion version;
 		if (!loadVersionInfo(exe, version))
 			std::wcerr << std::format(L"[GetVersionInfo] Couldn't load version info for: {}", exe) << std::endl;
 
@@ -302,6 +250,24 @@ public:
 	}
 
 private:
+	static constexpr uint32_t REVISION_SHIFT = MS_FORMAT ? 0 : 16;
+	static constexpr uint32_t BUILD_SHIFT    = MS_FORMAT ? 16 : 0;
+
+	static constexpr uint64_t pack(const uint16_t& major, const uint16_t& minor, const uint16_t& third, const uint16_t& fourth)
+	{
+		return (static_cast<uint64_t>(major) << 48) | (static_cast<uint64_t>(minor) << 32) | (static_cast<uint64_t>(third) << 16) | fourth;
+	}
+
+	constexpr uint16_t part(const uint32_t& shift) const
+	{
+		return static_cast<uint16_t>(m_key >> shift);
+	}
+
+	constexpr void setPart(const uint32_t& shift, const uint16_t& value)
+	{
+		m_key = (m_key & ~(static_cast<uint64_t>(0xFFFF) << shift)) | (static_cast<uint64_t>(value) << shift);
+	}
+
 	std::string toString(const uint32_t lvl = 3) const
 	{
 		if (lvl < 1 || lvl > 4)
@@ -310,70 +276,75 @@ private:
 		switch (lvl)
 		{
 			case 1:
-				return std::format("{}", m_major);
+				return std::format("{}", part(48));
 			case 2:
-				return std::format("{}.{}", m_major, m_minor);
+				return std::format("{}.{}", part(48), part(32));
 			case 3:
-				return std::format("{}.{}.{}", m_major, m_minor, (s_msFormat ? m_build : m_revision));
+				return std::format("{}.{}.{}", part(48), part(32), part(16));
 			case 4:
 			{
-				if (s_msFormat)
-					return std::format("{}.{}.{}.{}", m_major, m_minor, m_build, m_revision);
+				if constexpr (MS_FORMAT)
+					return std::format("{}.{}.{}.{}", part(48), part(32), part(16), part(0));
 				else
-					return std::format("{}.{}.{} Build #{}", m_major, m_minor, m_revision, m_build);
+					return std::format("{}.{}.{} Build #{}", part(48), part(32), part(16), part(0));
 			}
 		}
 
 		return toString();
 	}
 
-	static bool loadVersionInfo(const std::wstring& exe, ResVersion& version)
+	// Reads the version resource from the file itself, this works for any PE image on any platform
+	static bool loadVersionInfo(const std::wstring& exe, BasicResVersion& version)
 	{
-		DWORD verHandle = 0;
-		UINT size       = 0;
-		LPBYTE lpBuffer = NULL;
-		DWORD verSize   = GetFileVersionInfoSize(exe.c_str(), &verHandle);
-		bool ret        = false;
-
-		std::memset(&version, 0, sizeof(ResVersion));
+		version = BasicResVersion();
 
-		if (verSize != 0)
-		{
-			LPSTR pVerData = new char[verSize];
-
-			if (GetFileVersionInfo(exe.c_str(), verHandle, verSize, pVerData))
-			{
-				if (VerQueryValue(pVerData, L"\\", (VOID FAR * FAR*)&lpBuffer, &size))
-				{
-					if (size)
-					{
-						VS_FIXEDFILEINFO* verInfo = (VS_FIXEDFILEINFO*)lpBuffer;
-						if (verInfo->dwSignature == 0xfeef04bd)
-						{
-							version = ResVersion(static_cast<uint32_t>(verInfo->dwFileVersionMS), static_cast<uint32_t>(verInfo->dwFileVersionLS));
-							ret     = true;
-						}
-					}
-				}
-			}
-			delete[] pVerData;
-		}
+		FixedFileInfo info = {};
+		if (!ReadFixedFileInfo(exe, info))
+			return false;
 
-		return ret;
+		version = BasicResVersion(info.fileVersionMS, info.fileVersionLS);
+		return true;
 	}
 
 private:
-	uint16_t m_major    = 0;
-	uint16_t m_minor    = 0;
-	uint16_t m_revision = 0;
-	uint16_t m_build    = 0;
-
-	bool m_valid = false;
+	uint64_t m_key = 0;
+	bool m_valid   = false;
 };
 
+#ifdef SU_MS_VERSION_FORMAT
+using ResVersion = BasicResVersion<VersionFormat::Microsoft>;
+#else
+using ResVersion = BasicResVersion<VersionFormat::Default>;
+#endif
+
+#ifdef SU_EMBEDDED_VERSION
+inline constexpr ResVersion EMBEDDED_VERSION(SU_EMBEDDED_VERSION);
+#endif
+
+#ifdef SU_EMBEDDED_PRERELEASE
+inline constexpr std::string_view EMBEDDED_PRERELEASE = SU_EMBEDDED_PRERELEASE;
+#else
+inline constexpr std::string_view EMBEDDED_PRERELEASE = "";
+#endif
+
+#if defined(SU_EMBEDDED_VERSION) || defined(_WIN32)
 inline ResVersion GetVersionInfo()
 {
+#ifdef SU_EMBEDDED_VERSION
+	return EMBEDDED_VERSION;
+#else
 	return ResVersion::GetVersionInfo();
+#endif
 }
+#endif
 
-} // namespace selfUpdater::version
\ No newline at end of file
+} // namespace selfUpdater::version
+
+template<selfUpdater::version::VersionFormat FORMAT>
+struct std::hash<selfUpdater::version::BasicResVersion<FORMAT>>
+{
+	size_t operator()(const selfUpdater::version::BasicResVersion<FORMAT>& version) const noexcept
+	{
+		return std::hash<uint64_t>()(version.Key());
+	}
+};
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "../SelfUpdater/BlockSync.hpp"
+#include "Test.hpp"
+
+// Matching the blocks of a signature against local data and building the new version from them.
+// Sync() needs the local server, which only exists on POSIX systems.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread BlockSync.cpp -o BlockSyncTest
+
+using selfUpdater::blocksync::Match;
+using selfUpdater::blocksync::Plan;
+using selfUpdater::blocksync::Signature;
+
+constexpr uint32_t BLOCK_SIZE = 4096;
+
+Signature signature(const std::string& data)
+{
+	return Signature::Create(reinterpret_cast<const uint8_t*>(data.data()), data.size(), BLOCK_SIZE);
+}
+
+std::span<const uint8_t> span(const std::string& data)
+{
+	return { reinterpret_cast<const uint8_t*>(data.data()), data.size() };
+}
+
+void test_match()
+{
+	const std::string local = test::RandomData(100 * BLOCK_SIZE + 123);
+
+	// Shifted by an insertion, one block changed and a shorter last block
+	std::string remote = "inserted" + local;
+	remote[50 * BLOCK_SIZE + 8] ^= 1;
+
+	const Plan plan = Match(signature(remote), span(local));
+	uint32_t missing = 0;
+	for (const uint64_t& offset : plan.localOffsets)
+		missing += (offset == Plan::MISSING) ? 1 : 0;
+
+	// The block with the insertion and the one with the flipped bit
+	CHECK(missing == 2);
+	CHECK(plan.reusedBytes == remote.size() - 2 * BLOCK_SIZE);
+
+	// The padded last block matches the end of the local data
+	const std::string tail = local.substr(local.size() - 100);
+	CHECK(Match(signature(tail), span(local)).localOffsets[0] == local.size() - 100);
+
+	CHECK(Match(signature(remote), {}).reusedBytes == 0);
+	CHECK(Match(signature(remote), span(local.substr(0, 10))).reusedBytes == 0);
+}
+
+#ifndef _WIN32
+// Only a single block is missing, it is fetched right away
+void test_sync()
+{
+	const std::string local = test::RandomData(100 * BLOCK_SIZE + 123);
+	std::string remote      = local;
+	remote[10 * BLOCK_SIZE] ^= 1;
+
+	std::ostringstream sig;
+	signature(remote).Write(sig);
+	const std::string sigData = sig.str();
+
+	test::TestServer server([&](const test::HttpRequest& request) {
+		if (request.target == "/new.exe.zsig")
+			return test::HttpReply{ test::TestServer::Response(200, sigData) };
+
+		return test::TestServer::RangeResponse(request, remote, "\"v2\"");
+	});
+
+	test::TempDir dir("blocksync");
+	test::WriteFile(dir / "old.exe", local);
+
+	const auto begin = std::chrono::steady_clock::now();
+	CHECK(selfUpdater::blocksync::Sync(server.Url("new.exe"), (dir / "old.exe").wstring(), (dir / "new.exe").wstring()));
+	CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(400));
+	CHECK(test::ReadFile(dir / "new.exe") == remote);
+	CHECK(server.Requests() == 2);
+
+	CHECK(!selfUpdater::blocksync::Sync(server.Url("new.exe"), (dir / "missing.exe").wstring(), (dir / "new.exe").wstring()));
+}
+#endif
+
+int main()
+{
+	test_match();
+#ifndef _WIN32
+	test_sync();
+#endif
+
+	return test::Result();
+}
@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define SU_WITH_GZIP
+#include "../SelfUpdater/Decompress.hpp"
+#include "Test.hpp"
+
+// Streaming gzip decompression, fed in chunks of different sizes like the transport does.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Decompress.cpp -o DecompressTest -lz
+
+using selfUpdater::downloader::DecompressSink;
+using selfUpdater::downloader::Encoding;
+
+std::string gzip(const std::string& data)
+{
+	z_stream zlib = {};
+	// 15 + 16: maximum window size with a gzip header
+	deflateInit2(&zlib, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+	std::string result(deflateBound(&zlib, static_cast<uLong>(data.size())), '\0');
+	zlib.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	zlib.avail_in  = static_cast<uInt>(data.size());
+	zlib.next_out  = reinterpret_cast<Bytef*>(result.data());
+	zlib.avail_out = static_cast<uInt>(result.size());
+
+	deflate(&zlib, Z_FINISH);
+	result.resize(zlib.total_out);
+	deflateEnd(&zlib);
+
+	return result;
+}
+
+// Returns the result of Finish(), the data is committed in pieces of at most chunk bytes
+bool decompress(const std::string& compressed, const Encoding& encoding, const size_t& chunk, std::string& result, uint64_t* pProgress = nullptr)
+{
+	std::vector<uint8_t> data;
+	selfUpdater::downloader::VectorSink target(data);
+	DecompressSink sink(target, encoding, [&](const uint64_t& written, const uint64_t&) {
+		if (pProgress != nullptr)
+			*pProgress = written;
+	});
+
+	bool success = true;
+	for (size_t pos = 0; pos < compressed.size() && success;)
+	{
+		std::span<uint8_t> buffer = sink.Prepare(chunk);
+		const size_t size         = (std::min)(buffer.size(), compressed.size() - pos);
+
+		std::memcpy(buffer.data(), compressed.data() + pos, size);
+		success = sink.Commit(size);
+		pos += size;
+	}
+
+	success = success && sink.Commit(0) && sink.Finish();
+	result.assign(data.begin(), data.end());
+
+	return success;
+}
+
+void test_single_member()
+{
+	const std::string data = test::RandomData(100000) + std::string(500000, 'x');
+
+	for (const size_t& chunk : { size_t(1), size_t(7), size_t(4096), size_t(64 * 1024) })
+	{
+		std::string result;
+		uint64_t progress = 0;
+		CHECK(decompress(gzip(data), Encoding::Gzip, chunk, result, &progress));
+		CHECK(result == data);
+		CHECK(progress == data.size());
+	}
+}
+
+// gzip -c a b > ab.gz, pigz and others produce one member per block
+void test_multiple_members()
+{
+	const std::string first  = test::RandomData(200000, 1);
+	const std::string second = std::string(300000, 'y');
+	const std::string third  = test::RandomData(10, 3);
+
+	for (const size_t& chunk : { size_t(3), size_t(4096), size_t(64 * 1024) })
+	{
+		std::string result;
+		CHECK(decompress(gzip(first) + gzip(second) + gzip(third), Encoding::Auto, chunk, result));
+		CHECK(result == first + second + third);
+	}
+}
+
+void test_trailing_data()
+{
+	std::string result;
+	CHECK(!decompress(gzip(test::RandomData(1000)) + "garbage", Encoding::Gzip, 4096, result));
+}
+
+void test_truncated()
+{
+	const std::string data = gzip(test::RandomData(100000));
+
+	std::string result;
+	CHECK(!decompress(data.substr(0, data.size() - 10), Encoding::Gzip, 4096, result));
+
+	// Cut right after a complete member, within the header of the next one
+	CHECK(!decompress(data + data.substr(0, 5), Encoding::Gzip, 4096, result));
+}
+
+void test_identity()
+{
+	const std::string data = "plain";
+
+	std::string result;
+	CHECK(decompress(data, Encoding::Auto, 4096, result));
+	CHECK(result == data);
+}
+
+int main()
+{
+	test_single_member();
+	test_multiple_members();
+	test_trailing_data();
+	test_truncated();
+	test_identity();
+
+	return test::Result();
+}
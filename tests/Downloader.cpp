@@ -0,0 +1,166 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "../SelfUpdater/Downloader.hpp"
+#include "Test.hpp"
+
+// Resumable downloads against a local server that drops connections.
+// The server only exists on POSIX systems, on Windows nothing is tested.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Downloader.cpp -o DownloaderTest
+
+using selfUpdater::downloader::DownloadMode;
+using selfUpdater::downloader::Downloader;
+
+#ifndef _WIN32
+constexpr size_t BODY_SIZE = 3 * 1024 * 1024;
+const std::string ETAG     = "\"v1\"";
+
+void write_partial(const test::TempDir& dir, const std::wstring& url, std::string_view data, const std::string& validator, const uint64_t& total)
+{
+	test::WriteFile(dir / "update.bin.part", data);
+
+	std::ofstream state(dir / "update.bin.part.state", std::ios::trunc);
+	state << selfUpdater::utils::ws2s(url) << '\n'
+		  << validator << '\n'
+		  << total << '\n';
+}
+
+bool no_partial(const test::TempDir& dir)
+{
+	return !std::filesystem::exists(dir / "update.bin.part") && !std::filesystem::exists(dir / "update.bin.part.state");
+}
+
+// Every connection is dropped after 1 MB of the body, so the download needs three attempts to complete
+void test_resume_after_cut()
+{
+	const std::string body = test::RandomData(BODY_SIZE);
+	std::atomic<uint32_t> ranges = 0;
+
+	test::TestServer server([&](const test::HttpRequest& request) {
+		if (request.Header("Range"))
+			ranges++;
+
+		test::HttpReply reply = test::TestServer::RangeResponse(request, body, ETAG);
+		reply.cutAfter        = reply.data.find("\r\n\r\n") + 4 + 1024 * 1024;
+		return reply;
+	});
+
+	test::TempDir dir("resume");
+	const std::wstring file = (dir / "update.bin").wstring();
+
+	uint64_t last = 0;
+	CHECK(Downloader::DownloadSync(server.Url("update.bin"), file, [&](const uint64_t& received, const uint64_t&) { last = received; }, DownloadMode::Resumable));
+	CHECK(test::ReadFile(file) == body);
+	CHECK(ranges == 2);
+	CHECK(last == BODY_SIZE);
+	CHECK(no_partial(dir));
+}
+
+// The resource changed since the .part file was written, the server ignores the range and the download starts over
+void test_resource_changed()
+{
+	const std::string body = test::RandomData(BODY_SIZE);
+	test::TestServer server([&](const test::HttpRequest& request) { return test::TestServer::RangeResponse(request, body, ETAG); });
+
+	test::TempDir dir("changed");
+	write_partial(dir, server.Url("update.bin"), test::RandomData(1000, 7), "\"v0\"", BODY_SIZE);
+
+	CHECK(Downloader::DownloadSync(server.Url("update.bin"), (dir / "update.bin").wstring(), nullptr, DownloadMode::Resumable));
+	CHECK(test::ReadFile(dir / "update.bin") == body);
+	CHECK(no_partial(dir));
+}
+
+// A previous attempt received everything but failed before renaming the file
+void test_already_complete()
+{
+	const std::string body = test::RandomData(BODY_SIZE);
+	test::TestServer server([&](const test::HttpRequest& request) { return test::TestServer::RangeResponse(request, body, ETAG); });
+
+	test::TempDir dir("complete");
+	write_partial(dir, server.Url("update.bin"), body, ETAG, BODY_SIZE);
+
+	CHECK(Downloader::DownloadSync(server.Url("update.bin"), (dir / "update.bin").wstring(), nullptr, DownloadMode::Resumable));
+	CHECK(test::ReadFile(dir / "update.bin") == body);
+	CHECK(server.Requests() == 1);
+	CHECK(no_partial(dir));
+}
+
+// A .part file larger than the resource gets 416 on every attempt, it has to be dropped
+void test_oversized_partial()
+{
+	const std::string body = test::RandomData(BODY_SIZE);
+	test::TestServer server([&](const test::HttpRequest& request) { return test::TestServer::RangeResponse(request, body, ETAG); });
+
+	test::TempDir dir("oversized");
+	write_partial(dir, server.Url("update.bin"), test::RandomData(BODY_SIZE + 100), ETAG, BODY_SIZE + 100);
+
+	CHECK(Downloader::DownloadSync(server.Url("update.bin"), (dir / "update.bin").wstring(), nullptr, DownloadMode::Resumable));
+	CHECK(test::ReadFile(dir / "update.bin") == body);
+	CHECK(server.Requests() == 2);
+	CHECK(no_partial(dir));
+}
+
+// Without a validator the partial data can't be trusted, a failed download leaves no .part file behind
+void test_no_validator()
+{
+	const std::string body = test::RandomData(BODY_SIZE);
+	test::TestServer server([&](const test::HttpRequest&) {
+		test::HttpReply reply;
+		reply.data     = test::TestServer::Response(200, body);
+		reply.cutAfter = 1024 * 1024;
+		return reply;
+	});
+
+	test::TempDir dir("novalidator");
+
+	CHECK(!Downloader::DownloadSync(server.Url("update.bin"), (dir / "update.bin").wstring(), nullptr, DownloadMode::Resumable));
+	CHECK(!std::filesystem::exists(dir / "update.bin"));
+	CHECK(!std::filesystem::exists(dir / "update.bin.part.state"));
+}
+
+// A small download is done as soon as its workers are, not at the next progress sample
+void test_segmented()
+{
+	const std::string body = test::RandomData(BODY_SIZE);
+	test::TestServer server([&](const test::HttpRequest& request) { return test::TestServer::RangeResponse(request, body, ETAG); });
+
+	test::TempDir dir("segmented");
+	const std::wstring file = (dir / "update.bin").wstring();
+
+	auto begin = std::chrono::steady_clock::now();
+	CHECK(Downloader::DownloadSync(server.Url("update.bin"), file, nullptr, DownloadMode::Segmented));
+	CHECK(test::ReadFile(file) == body);
+	CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(400));
+
+	// A single block, like BlockSync fetches it
+	std::string expected = std::string(BODY_SIZE, '\0');
+	test::WriteFile(file, expected);
+	std::memcpy(expected.data() + 8192, body.data() + 8192, 4096);
+
+	begin = std::chrono::steady_clock::now();
+	CHECK(Downloader::DownloadRanges(server.Url("update.bin"), { { 8192, 8192 + 4096 } }, file));
+	CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(400));
+	CHECK(test::ReadFile(file) == expected);
+}
+#endif
+
+int main()
+{
+#ifndef _WIN32
+	test_resume_after_cut();
+	test_resource_changed();
+	test_already_complete();
+	test_oversized_partial();
+	test_no_validator();
+	test_segmented();
+#endif
+
+	return test::Result();
+}
@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../SelfUpdater/Hedge.hpp"
+#include "Test.hpp"
+
+// Hedged requests against a local server with a slow and a failing path.
+// The server only exists on POSIX systems, on Windows nothing is tested.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Hedge.cpp -o HedgeTest
+
+using selfUpdater::downloader::Hedge;
+using selfUpdater::downloader::HedgeOptions;
+using selfUpdater::downloader::Response;
+
+#ifndef _WIN32
+// /slow answers after 300 ms, /fail drops the connection without an answer, everything else right away
+test::HttpReply reply(const test::HttpRequest& request)
+{
+	if (request.target == "/fail")
+		return { .data = "", .close = true };
+
+	if (request.target == "/slow")
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+	return { test::TestServer::Response(200, request.target) };
+}
+
+std::string request(Hedge& hedge, const std::vector<std::wstring>& urls, std::chrono::steady_clock::duration* pElapsed = nullptr)
+{
+	std::vector<uint8_t> data;
+	Response response;
+
+	const auto begin = std::chrono::steady_clock::now();
+	if (!hedge.Request(urls, data, response))
+		return "";
+
+	if (pElapsed != nullptr)
+		*pElapsed = std::chrono::steady_clock::now() - begin;
+
+	return std::string(data.begin(), data.end());
+}
+
+void test_fast()
+{
+	test::TestServer server(reply);
+	Hedge hedge;
+
+	CHECK(request(hedge, { server.Url("fast") }) == "/fast");
+	CHECK(hedge.Requests() == 1);
+	CHECK(hedge.Hedged() == 0);
+}
+
+// The hedge wins, the latency kept is the one of the whole request and not the one of the hedge
+void test_slow()
+{
+	test::TestServer server(reply);
+	Hedge hedge({ .firstDelay = std::chrono::milliseconds(100), .minSamples = 1 });
+
+	CHECK(request(hedge, { server.Url("slow"), server.Url("fast") }) == "/fast");
+	CHECK(hedge.Hedged() == 1);
+	CHECK(hedge.HedgeWins() == 1);
+	CHECK(hedge.Delay() >= std::chrono::milliseconds(100));
+}
+
+// A first request that fails early doesn't wait for the delay, the hedge is sent right away
+void test_fail()
+{
+	test::TestServer server(reply);
+	Hedge hedge({ .firstDelay = std::chrono::seconds(5) });
+
+	std::chrono::steady_clock::duration elapsed = {};
+	CHECK(request(hedge, { server.Url("fail"), server.Url("fast") }, &elapsed) == "/fast");
+	CHECK(elapsed < std::chrono::seconds(2));
+	CHECK(hedge.Hedged() == 1);
+	CHECK(hedge.HedgeWins() == 1);
+
+	CHECK(request(hedge, { server.Url("fail"), server.Url("fail") }).empty());
+	CHECK(hedge.Requests() == 2);
+}
+#endif
+
+int main()
+{
+#ifndef _WIN32
+	test_fast();
+	test_slow();
+	test_fail();
+#endif
+
+	return test::Result();
+}
@@ -0,0 +1,170 @@
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "../SelfUpdater/Manifest.hpp"
+#include "Test.hpp"
+
+// Version ranges of requires= and blocked=, selecting the update from a version file for an installed version,
+// channel and prerelease.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Manifest.cpp -o ManifestTest
+
+using selfUpdater::manifest::UpdateSelector;
+using selfUpdater::version::ResVersion;
+using selfUpdater::version::VersionRange;
+
+struct RangeCase
+{
+	const char* pRange;
+	const char* pVersion;
+	bool contained;
+};
+
+void test_range()
+{
+	const RangeCase cases[] = {
+		{ "1.2.3.4", "1.2.3.4", true },
+		{ "1.2.3.4", "1.2.3.5", false },
+		{ "1.2", "1.2.0.0", true },
+		{ "=1.2", "1.2.65535.65535", true },
+		{ "=1.2", "1.3.0", false },
+		{ "=1.2", "1.1.9", false },
+		{ "!=1.2.3", "1.2.3.7", false },
+		{ "!=1.2.3", "1.2.4", true },
+		{ "!=1.2.3", "1.2.2.65535", true },
+		{ ">=1.2", "1.2.0", true },
+		{ ">=1.2", "1.1.65535.65535", false },
+		{ ">1.2", "1.2.9", false },
+		{ ">1.2", "1.3.0", true },
+		{ "<=2", "2.65535.0", true },
+		{ "<=2", "3.0.0", false },
+		{ "<2.0.1", "2.0.0.65535", true },
+		{ "<2.0.1", "2.0.1", false },
+		{ "^1.2", "1.2.0", true },
+		{ "^1.2", "1.9.9", true },
+		{ "^1.2", "1.1.9", false },
+		{ "^1.2", "2.0.0", false },
+		{ "~1.2.3", "1.2.3", true },
+		{ "~1.2.3", "1.2.9", true },
+		{ "~1.2.3", "1.2.2", false },
+		{ "~1.2.3", "1.3.0", false },
+		{ "~1", "1.9.0", true },
+		{ "~1", "2.0.0", false },
+		{ "*", "0.0.0", true },
+		{ "1.*", "1.5.0", true },
+		{ "1.*", "2.0.0", false },
+		{ "1.x.X", "1.7.3", true },
+		{ ">=1.2 <2 !=1.4.0 || >=3", "1.3.0", true },
+		{ ">=1.2 <2 !=1.4.0 || >=3", "1.4.0.2", false },
+		{ ">=1.2 <2 !=1.4.0 || >=3", "1.5.0", true },
+		{ ">=1.2 <2 !=1.4.0 || >=3", "2.5.0", false },
+		{ ">=1.2 <2 !=1.4.0 || >=3", "3.0.0", true },
+		{ ">=1.2 <2 !=1.4.0 || >=3", "1.1.0", false },
+		{ ">=65535.65535.65535.65535 || <1", "65535.65535.65535.65535", true },
+		{ ">=65535.65535.65535.65535 || <1", "0.5.0", true },
+		{ ">=65535.65535.65535.65535 || <1", "1.0.0", false },
+		{ ">65535.65535.65535.65535", "65535.65535.65535.65535", false },
+		{ "<0.0.0.0", "0.0.0.0", false },
+	};
+
+	for (const RangeCase& c : cases)
+	{
+		VersionRange range;
+		if (!CHECK(VersionRange::Parse(c.pRange, range) && range.Contains(ResVersion(c.pVersion)) == c.contained))
+			std::cerr << "  \"" << c.pRange << "\" with " << c.pVersion << std::endl;
+	}
+
+	// Adjacent intervals are merged, also at the end of the key space
+	for (const char* pRange : { "*", "<1 || >=1", ">=2 || <=2", "<=65535.65535.65535.65535 || >=1" })
+	{
+		VersionRange range;
+		if (!CHECK(VersionRange::Parse(pRange, range) && range.IsAll()))
+			std::cerr << "  Not all: \"" << pRange << "\"" << std::endl;
+	}
+
+	VersionRange range;
+	CHECK(VersionRange::Parse(">65535.65535.65535.65535", range) && range.IsEmpty());
+	CHECK(VersionRange::Parse("!=1.2", range) && range.Complement().Complement().Contains(ResVersion("1.3.0")));
+
+	for (const char* pRange : { "", " ", "1.2.", "*.1", "1.x.3", "1.2 ||", "|| 1.2", "1.2 |||| 3", "1.2.3.4.5", "^*", "~*", ">=", ">>1", "1..2", "a.b", "65536", "-1", "=1.2 y" })
+	{
+		if (!CHECK(!VersionRange::Parse(pRange, range)))
+			std::cerr << "  Accepted: \"" << pRange << "\"" << std::endl;
+	}
+}
+
+// The version of the selected entry with its tag, empty if there is no update
+std::string select(const std::string& versions, const std::string& installed, const std::string& prerelease, const std::string& channel)
+{
+	UpdateSelector selector(ResVersion(installed), channel);
+	selector.SetInstalledPrerelease(prerelease);
+	selfUpdater::manifest::SelectUpdate(versions, "App.exe", selector);
+
+	if (!selector.Best())
+		return "";
+
+	return selector.Best()->version.ToString() + (selector.Best()->prerelease.empty() ? "" : "-" + selector.Best()->prerelease);
+}
+
+void test_prerelease()
+{
+	const std::string rc1   = "App.exe\t1.3.0-rc.1\n";
+	const std::string rc2   = rc1 + "App.exe\t1.3.0-rc.2\n";
+	const std::string final = rc2 + "App.exe\t1.3.0\n";
+
+	CHECK(select(rc2, "1.3.0", "rc.1", "beta") == "1.3.0-rc.2");
+	CHECK(select(final, "1.3.0", "rc.1", "beta") == "1.3.0");
+	CHECK(select(final, "1.3.0", "rc.2", "beta") == "1.3.0");
+	CHECK(select(final, "1.3.0", "rc.1", "stable") == "1.3.0");
+	CHECK(select(final, "1.3.0", "", "beta") == "");
+	CHECK(select(rc1, "1.3.0", "rc.1", "beta") == "");
+	CHECK(select(rc2, "1.3.0", "rc.10", "beta") == "");
+	CHECK(select(rc2, "1.2.0", "", "beta") == "1.3.0-rc.2");
+	CHECK(select(rc2, "1.2.0", "", "stable") == "");
+}
+
+// Releases that only differ in the build start their rollout with different installations
+void test_rollout_bucket()
+{
+	using selfUpdater::manifest::Rollout;
+
+	CHECK(Rollout::Bucket("installation", ResVersion("1.3.0.1"), "") == Rollout::Bucket("installation", ResVersion("1.3.0.1"), ""));
+
+	uint32_t same = 0;
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		const std::string id = "installation-" + std::to_string(i);
+		same += (Rollout::Bucket(id, ResVersion("1.3.0.1"), "") == Rollout::Bucket(id, ResVersion("1.3.0.2"), "")) ? 1 : 0;
+	}
+
+	CHECK(same < 5);
+}
+
+// An attribute that can't be parsed stops the rollout, whatever the order of the attributes
+void test_invalid_rollout()
+{
+	for (const char* pAttributes : { "rollout-start=garbage\trollout=100", "rollout=100\trollout-start=garbage", "rollout-ramp=3x\trollout=100", "rollout=50%", "rollout=101" })
+	{
+		UpdateSelector selector(ResVersion("1.0.0"), "stable", "installation");
+		selfUpdater::manifest::SelectUpdate("App.exe\t1.1.0\t" + std::string(pAttributes) + "\n", "App.exe", selector);
+
+		if (!CHECK(!selector.Best() && selector.IsHeldBack()))
+			std::cerr << "  Offered: " << pAttributes << std::endl;
+	}
+
+	UpdateSelector selector(ResVersion("1.0.0"), "stable", "installation");
+	selfUpdater::manifest::SelectUpdate("App.exe\t1.1.0\trollout-start=2000-01-01\trollout-ramp=1d\trollout=100\n", "App.exe", selector);
+	CHECK(selector.Best());
+}
+
+int main()
+{
+	test_range();
+	test_prerelease();
+	test_rollout_bucket();
+	test_invalid_rollout();
+
+	return test::Result();
+}
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "../SelfUpdater/Mirrors.hpp"
+#include "Test.hpp"
+
+// Ranking of the mirrors from the reported latencies, throughputs and failures.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Mirrors.cpp -o MirrorsTest
+
+using namespace std::chrono_literals;
+using selfUpdater::downloader::Mirrors;
+
+constexpr uint64_t SMALL = 1024;             // Only tells the latency
+constexpr uint64_t LARGE = 8 * 1024 * 1024; // Tells the throughput
+
+void test_unmeasured_last()
+{
+	Mirrors mirrors;
+	mirrors.Add(L"http://a");
+	mirrors.Add(L"http://b");
+	mirrors.Add(L"http://c");
+
+	CHECK(mirrors.Order() == std::vector<size_t>({ 0, 1, 2 }));
+
+	mirrors.ReportSuccess(2, SMALL, 50ms);
+	CHECK(mirrors.Order().front() == 2);
+}
+
+// Serving a payload once doesn't move the fastest mirror behind the ones that only served small files
+void test_throughput_sample()
+{
+	Mirrors mirrors;
+	mirrors.Add(L"http://fast");
+	mirrors.Add(L"http://slow");
+
+	mirrors.ReportSuccess(0, SMALL, 10ms);
+	mirrors.ReportSuccess(1, SMALL, 200ms);
+	CHECK(mirrors.Order() == std::vector<size_t>({ 0, 1 }));
+
+	mirrors.ReportSuccess(0, LARGE, 1s);
+	CHECK(mirrors.Order() == std::vector<size_t>({ 0, 1 }));
+
+	// Only the slow one was seen transferring a payload, the other one is assumed to be as slow at it
+	Mirrors other;
+	other.Add(L"http://fast");
+	other.Add(L"http://slow");
+	other.ReportSuccess(0, SMALL, 10ms);
+	other.ReportSuccess(1, SMALL, 200ms);
+	other.ReportSuccess(1, LARGE, 1s);
+	CHECK(other.Order() == std::vector<size_t>({ 0, 1 }));
+
+	// With samples of both a much faster transfer wins over a lower latency
+	other.ReportSuccess(0, LARGE, 4s);
+	CHECK(other.Order() == std::vector<size_t>({ 1, 0 }));
+}
+
+void test_failure()
+{
+	Mirrors mirrors;
+	mirrors.Add(L"http://a");
+	mirrors.Add(L"http://b");
+
+	mirrors.ReportSuccess(0, SMALL, 10ms);
+	mirrors.ReportSuccess(1, SMALL, 100ms);
+	mirrors.ReportFailure(0);
+	CHECK(mirrors.Order() == std::vector<size_t>({ 1, 0 }));
+
+	mirrors.ReportSuccess(0, SMALL, 10ms);
+	CHECK(mirrors.Order() == std::vector<size_t>({ 0, 1 }));
+}
+
+int main()
+{
+	test_unmeasured_last();
+	test_throughput_sample();
+	test_failure();
+
+	return test::Result();
+}
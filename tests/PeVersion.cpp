@@ -0,0 +1,106 @@
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+
+#include "../SelfUpdater/PeVersion.hpp"
+#include "Test.hpp"
+
+// Reading VS_FIXEDFILEINFO from the PE images in fixtures/, the directory can be given as the first argument.
+// The fixtures are minimal images with a single .rsrc section:
+//   Version32.exe       PE32, file version 1.2.3.4, product version 5.6.7.8
+//   Version64.exe       PE32+, file version 10.20.30.40, product version 10.20.0.0
+//   NoVersion32.exe     Only an RT_MANIFEST resource
+//   NoResources64.exe   Empty resource data directory
+//   Truncated64.exe     Version64.exe cut off within VS_FIXEDFILEINFO
+//   BadSignature32.exe  VS_FIXEDFILEINFO with a wrong signature
+//   BadHeader32.exe     e_lfanew points behind the end of the file
+//   BadDataEntry64.exe  The data entry points to an RVA outside of every section
+//   Loop32.exe          A resource directory entry that points back to its own directory
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread PeVersion.cpp -o PeVersionTest
+
+using selfUpdater::version::FixedFileInfo;
+using selfUpdater::version::PeReader;
+
+std::filesystem::path fixtures;
+
+bool read(const std::string& name, FixedFileInfo& info)
+{
+	info = {};
+	return selfUpdater::version::ReadFixedFileInfo(fixtures / name, info);
+}
+
+void test_versions()
+{
+	FixedFileInfo info;
+
+	CHECK(read("Version32.exe", info));
+	CHECK(info.fileVersionMS == 0x00010002 && info.fileVersionLS == 0x00030004);
+	CHECK(info.productVersionMS == 0x00050006 && info.productVersionLS == 0x00070008);
+
+	CHECK(read("Version64.exe", info));
+	CHECK(info.fileVersionMS == 0x000A0014 && info.fileVersionLS == 0x001E0028);
+	CHECK(info.productVersionMS == 0x000A0014 && info.productVersionLS == 0);
+}
+
+void test_invalid()
+{
+	FixedFileInfo info;
+
+	for (const char* pName : { "NoVersion32.exe", "NoResources64.exe", "Truncated64.exe", "BadSignature32.exe", "BadHeader32.exe", "BadDataEntry64.exe", "Loop32.exe", "Missing.exe" })
+	{
+		if (!CHECK(!read(pName, info)))
+			std::cerr << "  Accepted: " << pName << std::endl;
+	}
+
+	CHECK(!PeReader(std::span<const uint8_t>()).ReadFixedFileInfo(info));
+
+	const std::string text = "MZ is not enough to be a PE image";
+	CHECK(!PeReader(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(text.data()), text.size())).ReadFixedFileInfo(info));
+}
+
+// Every bit of a valid image flipped once and every possible truncation, none of them may read out of bounds
+void test_corrupt()
+{
+	std::string image = test::ReadFile(fixtures / "Version32.exe");
+	if (!CHECK(!image.empty()))
+		return;
+
+	auto span = [&](const size_t& size) { return std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(image.data()), size); };
+
+	FixedFileInfo info;
+	uint32_t accepted = 0;
+
+	for (size_t i = 0; i < image.size() * 8; i++)
+	{
+		image[i / 8] ^= static_cast<char>(1 << (i % 8));
+		accepted += PeReader(span(image.size())).ReadFixedFileInfo(info) ? 1 : 0;
+		image[i / 8] ^= static_cast<char>(1 << (i % 8));
+	}
+
+	// Most of the headers aren't looked at, so many flips don't change the result
+	CHECK(accepted > 0 && accepted < image.size() * 8);
+
+	size_t shortest = image.size();
+	for (size_t size = image.size(); size-- > 0;)
+	{
+		if (PeReader(span(size)).ReadFixedFileInfo(info))
+			shortest = size;
+	}
+
+	// The padding behind the version resource doesn't matter, the resource itself has to be complete
+	CHECK(shortest == 0x200 + 88 + 92);
+}
+
+int main(int argc, char* argv[])
+{
+	fixtures = (argc >= 2) ? std::filesystem::path(argv[1]) : std::filesystem::path(__FILE__).parent_path() / "fixtures";
+
+	test_versions();
+	test_invalid();
+	test_corrupt();
+
+	return test::Result();
+}
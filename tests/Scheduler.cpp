@@ -0,0 +1,194 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "../SelfUpdater/Scheduler.hpp"
+#include "Test.hpp"
+
+// The schedule of the periodic checks, with the time driven by a ManualClock.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Scheduler.cpp -o SchedulerTest
+
+using namespace std::chrono_literals;
+using selfUpdater::schedule::Duration;
+using selfUpdater::schedule::ManualClock;
+using selfUpdater::schedule::Options;
+using selfUpdater::schedule::Outcome;
+using selfUpdater::schedule::Policy;
+using selfUpdater::schedule::Scheduler;
+using selfUpdater::schedule::TimePoint;
+
+const TimePoint START = TimePoint() + 1000h;
+
+// The worker thread runs the checks, wait (in real time) until it caught up
+bool wait_until(const std::function<bool()>& condition)
+{
+	for (uint32_t i = 0; i < 500 && !condition(); i++)
+		std::this_thread::sleep_for(10ms);
+
+	return condition();
+}
+
+// All fields set, so the tests build warning-free with -Wextra
+Outcome succeeded(const std::optional<Duration>& minInterval = std::nullopt, const std::optional<Duration>& retryAfter = std::nullopt)
+{
+	return Outcome{ .success = true, .retryAfter = retryAfter, .minInterval = minInterval };
+}
+
+Outcome failed(const std::optional<Duration>& retryAfter = std::nullopt)
+{
+	return Outcome{ .success = false, .retryAfter = retryAfter, .minInterval = std::nullopt };
+}
+
+bool in_range(const TimePoint& time, const Duration& lo, const Duration& hi)
+{
+	return time >= START + lo && time <= START + hi;
+}
+
+void test_jitter()
+{
+	const Options options = { .interval = 6h, .startupDelay = 5min, .jitter = 0.1 };
+
+	bool first = true;
+	bool next  = true;
+	Duration lowest(6h);
+
+	for (uint64_t seed = 0; seed < 200; seed++)
+	{
+		Policy policy(options, seed);
+		first = first && in_range(policy.First(START), 0min, 5min);
+
+		const TimePoint time = policy.Next(succeeded(), START);
+		next                 = next && in_range(time, 6h - 36min, 6h + 36min);
+		lowest               = (std::min)(lowest, std::chrono::duration_cast<Duration>(time - START));
+	}
+
+	CHECK(first);
+	CHECK(next);
+	// The checks of a fleet spread out over the whole range
+	CHECK(lowest < 6h - 30min);
+}
+
+void test_backoff()
+{
+	const Options options = { .minBackoff = 1min, .maxBackoff = 10min, .backoffFactor = 2.0 };
+	Policy policy(options, 1);
+
+	// 1, 2, 4, 8, then capped at 10 minutes, half of each backoff is random
+	bool ranges = true;
+	for (const Duration& backoff : { Duration(1min), Duration(2min), Duration(4min), Duration(8min), Duration(10min), Duration(10min) })
+		ranges = ranges && in_range(policy.Next(failed(), START), backoff / 2, backoff);
+
+	CHECK(ranges);
+	CHECK(policy.Failures() == 6);
+
+	policy.Next(succeeded(), START);
+	CHECK(policy.Failures() == 0);
+	CHECK(in_range(policy.Next(failed(), START), 30s, 1min));
+}
+
+void test_floors()
+{
+	const Options options = { .interval = 1h, .minBackoff = 1min };
+	Policy policy(options, 1);
+
+	CHECK(in_range(policy.Next(failed(3h), START), 3h, 3h));
+	CHECK(in_range(policy.Next(succeeded(std::nullopt, 3h), START), 3h, 3h));
+
+	// The minimal interval of the version file applies to failures as well, until a check returns a different one
+	CHECK(in_range(policy.Next(succeeded(12h), START), 12h, 12h));
+	CHECK(in_range(policy.Next(failed(), START), 12h, 12h));
+	CHECK(in_range(policy.Next(succeeded(), START), 54min, 66min));
+}
+
+void test_scheduler()
+{
+	std::shared_ptr<ManualClock> pClock = std::make_shared<ManualClock>(START);
+	std::atomic<uint32_t> checks        = 0;
+
+	Scheduler scheduler(
+		[&]() {
+			checks++;
+			return succeeded();
+		},
+		{ .interval = 1h, .startupDelay = 10min, .jitter = 0.0 }, pClock, 1);
+
+	scheduler.Start();
+	CHECK(in_range(scheduler.NextCheck(), 0min, 10min));
+
+	pClock->Advance(10min);
+	CHECK(wait_until([&]() { return scheduler.Checks() == 1; }));
+	CHECK(scheduler.NextCheck() == START + 10min + 1h);
+
+	// Nothing happens before the next check is due
+	pClock->Advance(59min);
+	std::this_thread::sleep_for(50ms);
+	CHECK(checks == 1);
+
+	pClock->Advance(1min);
+	CHECK(wait_until([&]() { return scheduler.Checks() == 2; }));
+
+	scheduler.CheckNow();
+	CHECK(wait_until([&]() { return scheduler.Checks() == 3; }));
+	CHECK(scheduler.NextCheck() == START + 1h + 10min + 1h);
+
+	scheduler.Stop();
+	pClock->Advance(2h);
+	std::this_thread::sleep_for(50ms);
+	CHECK(checks == 3);
+}
+
+void test_failures()
+{
+	std::shared_ptr<ManualClock> pClock = std::make_shared<ManualClock>(START);
+
+	Scheduler scheduler([]() { return failed(2h); }, { .startupDelay = 0min, .minBackoff = 1min }, pClock, 1);
+	scheduler.Start();
+
+	CHECK(wait_until([&]() { return scheduler.Checks() == 1; }));
+	CHECK(scheduler.Failures() == 1);
+	CHECK(scheduler.NextCheck() == START + 2h);
+}
+
+// CheckNow() while a check runs is not lost, another check follows right after it
+void test_check_now_while_checking()
+{
+	std::shared_ptr<ManualClock> pClock = std::make_shared<ManualClock>(START);
+	std::atomic<bool> running           = false;
+	std::atomic<bool> release           = false;
+
+	Scheduler scheduler(
+		[&]() {
+			running = true;
+			while (!release)
+				std::this_thread::sleep_for(1ms);
+
+			return succeeded();
+		},
+		{ .interval = 1h, .startupDelay = 0min }, pClock, 1);
+
+	scheduler.Start();
+	CHECK(wait_until([&]() { return running.load(); }));
+
+	scheduler.CheckNow();
+	release = true;
+
+	CHECK(wait_until([&]() { return scheduler.Checks() == 2; }));
+}
+
+int main()
+{
+	test_jitter();
+	test_backoff();
+	test_floors();
+	test_scheduler();
+	test_failures();
+	test_check_now_while_checking();
+
+	return test::Result();
+}
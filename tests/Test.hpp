@@ -0,0 +1,359 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cwchar>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "../SelfUpdater/Utils.hpp"
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Helpers shared by the tests. Every test is a standalone program like the tools, it prints the failed checks
+// and returns 0 only if all of them passed.
+
+// Compile and run a test using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Downloader.cpp -o DownloaderTest && ./DownloaderTest
+
+namespace test
+{
+
+inline uint32_t s_checks   = 0;
+inline uint32_t s_failures = 0;
+
+inline bool check(const bool& condition, const char* expression, const char* file, const int& line)
+{
+	s_checks++;
+	if (!condition)
+	{
+		s_failures++;
+		std::cerr << file << ":" << line << ": Check failed: " << expression << std::endl;
+	}
+
+	return condition;
+}
+
+#define CHECK(condition) test::check(static_cast<bool>(condition), #condition, __FILE__, __LINE__)
+
+// Prints the summary, use as the return value of main
+inline int Result()
+{
+	// Once the code under test wrote to std::wcout, narrow output to stdout is dropped
+	if (std::fwide(stdout, 0) > 0)
+		std::wcout << (s_checks - s_failures) << L"/" << s_checks << L" checks passed" << std::endl;
+	else
+		std::cout << (s_checks - s_failures) << "/" << s_checks << " checks passed" << std::endl;
+
+	return (s_failures == 0) ? 0 : 1;
+}
+
+inline std::string RandomData(const size_t& size, const uint32_t& seed = 42)
+{
+	std::mt19937 rng(seed);
+	std::string data(size, '\0');
+	for (char& c : data)
+		c = static_cast<char>(rng());
+
+	return data;
+}
+
+inline std::string ReadFile(const std::filesystem::path& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+inline bool WriteFile(const std::filesystem::path& filename, std::string_view data)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write(data.data(), static_cast<std::streamsize>(data.size()));
+	return file.good();
+}
+
+// Empty directory below the temp directory, removed again with everything in it
+class TempDir
+{
+public:
+	explicit TempDir(const std::string& name) :
+		m_path(std::filesystem::temp_directory_path() / ("SelfUpdater.test." + name))
+	{
+		std::filesystem::remove_all(m_path);
+		std::filesystem::create_directories(m_path);
+	}
+
+	~TempDir()
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(m_path, ec);
+	}
+
+	TempDir(const TempDir&)            = delete;
+	TempDir& operator=(const TempDir&) = delete;
+
+	const std::filesystem::path& Path() const
+	{
+		return m_path;
+	}
+
+	std::filesystem::path operator/(const std::string& name) const
+	{
+		return m_path / name;
+	}
+
+private:
+	std::filesystem::path m_path;
+};
+
+#ifndef _WIN32
+struct HttpRequest
+{
+	std::string target;
+	std::string head; // Request line and headers, each terminated by CRLF
+
+	// Header names are compared case-insensitive
+	std::optional<std::string> Header(const std::string& name) const
+	{
+		std::string lowerHead = head;
+		std::string lowerName = "\r\n" + name + ":";
+		for (std::string* pStr : { &lowerHead, &lowerName })
+			std::transform(pStr->begin(), pStr->end(), pStr->begin(), [](const unsigned char& c) { return static_cast<char>(std::tolower(c)); });
+
+		const size_t pos = lowerHead.find(lowerName);
+		if (pos == std::string::npos)
+			return std::nullopt;
+
+		const size_t begin = head.find_first_not_of(' ', pos + lowerName.size());
+		return head.substr(begin, head.find("\r\n", begin) - begin);
+	}
+};
+
+// What the server sends, the raw bytes of the status line, the headers and the body
+struct HttpReply
+{
+	std::string data;
+	size_t cutAfter = std::string::npos; // The connection is closed after this many bytes, like a dropped connection
+	bool close      = false;             // Close the connection after the reply, whatever its headers say
+};
+
+// HTTP/1.1 server on a random local port, every request is answered by the handler on the connection's thread.
+// Connections are kept alive until the handler closes them or the client does.
+class TestServer
+{
+public:
+	using Handler = std::function<HttpReply(const HttpRequest&)>;
+
+public:
+	explicit TestServer(Handler handler) :
+		m_handler(std::move(handler))
+	{
+		m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+		sockaddr_in address     = {};
+		address.sin_family      = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t length        = sizeof(address);
+
+		if (m_fd < 0 || ::bind(m_fd, reinterpret_cast<sockaddr*>(&address), length) != 0 || ::listen(m_fd, 64) != 0 || ::getsockname(m_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+			return;
+
+		m_port     = ntohs(address.sin_port);
+		m_acceptor = std::thread(&TestServer::acceptLoop, this);
+	}
+
+	// Wakes up every thread blocked in accept or recv, so they can be joined
+	~TestServer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopped = true;
+
+			::shutdown(m_fd, SHUT_RDWR);
+			for (const int& client : m_clients)
+				::shutdown(client, SHUT_RDWR);
+		}
+
+		if (m_acceptor.joinable())
+			m_acceptor.join();
+
+		for (std::thread& thread : m_threads)
+			thread.join();
+
+		::close(m_fd);
+	}
+
+	TestServer(const TestServer&)            = delete;
+	TestServer& operator=(const TestServer&) = delete;
+
+	std::wstring Url(const std::string& path) const
+	{
+		return selfUpdater::utils::s2ws("http://127.0.0.1:" + std::to_string(m_port) + "/" + path);
+	}
+
+	bool IsRunning() const
+	{
+		return m_port != 0;
+	}
+
+	uint32_t Connections() const
+	{
+		return m_connections;
+	}
+
+	uint32_t Requests() const
+	{
+		return m_requests;
+	}
+
+	// A complete response with Content-Length framing
+	static std::string Response(const uint32_t& status, std::string_view body, const std::string& headers = "")
+	{
+		return "HTTP/1.1 " + std::to_string(status) + " Test\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" + headers + "\r\n" + std::string(body);
+	}
+
+	// Answers a GET of body with support for a single byte range and If-Range
+	static HttpReply RangeResponse(const HttpRequest& request, std::string_view body, const std::string& etag)
+	{
+		const std::optional<std::string> range   = request.Header("Range");
+		const std::optional<std::string> ifRange = request.Header("If-Range");
+
+		if (!range || !range->starts_with("bytes=") || (ifRange && *ifRange != etag))
+			return { Response(200, body, "ETag: " + etag + "\r\n") };
+
+		const size_t dash    = range->find('-');
+		const uint64_t begin = std::stoull(range->substr(6, dash - 6));
+		uint64_t end         = body.size();
+		if (dash + 1 < range->size())
+			end = (std::min)(end, static_cast<uint64_t>(std::stoull(range->substr(dash + 1))) + 1);
+
+		if (begin >= end)
+			return { Response(416, "", "Content-Range: bytes */" + std::to_string(body.size()) + "\r\n") };
+
+		const std::string contentRange = "Content-Range: bytes " + std::to_string(begin) + "-" + std::to_string(end - 1) + "/" + std::to_string(body.size()) + "\r\n";
+		return { Response(206, body.substr(begin, end - begin), "ETag: " + etag + "\r\n" + contentRange) };
+	}
+
+private:
+	void acceptLoop()
+	{
+		while (true)
+		{
+			const int client = ::accept(m_fd, nullptr, nullptr);
+			if (client < 0)
+				return;
+
+			const int noDelay = 1;
+			::setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stopped)
+			{
+				::close(client);
+				return;
+			}
+
+			m_connections++;
+			m_clients.push_back(client);
+			m_threads.emplace_back(&TestServer::serve, this, client);
+		}
+	}
+
+	void serve(const int client)
+	{
+		std::string buffer;
+		char chunk[4096];
+		bool open = true;
+
+		while (open)
+		{
+			const ssize_t received = ::recv(client, chunk, sizeof(chunk), 0);
+			if (received <= 0)
+				break;
+
+			buffer.append(chunk, static_cast<size_t>(received));
+
+			// Only GET requests without a body are sent, one request ends with an empty line
+			size_t end;
+			while (open && (end = buffer.find("\r\n\r\n")) != std::string::npos)
+			{
+				HttpRequest request;
+				request.head = buffer.substr(0, end + 2);
+				buffer.erase(0, end + 4);
+
+				const size_t targetBegin = request.head.find(' ') + 1;
+				request.target           = request.head.substr(targetBegin, request.head.find(' ', targetBegin) - targetBegin);
+
+				m_requests++;
+				const HttpReply reply = m_handler(request);
+
+				const size_t size = (std::min)(reply.cutAfter, reply.data.size());
+				open              = sendAll(client, std::string_view(reply.data).substr(0, size)) && size == reply.data.size() && !reply.close;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_clients.erase(std::find(m_clients.begin(), m_clients.end(), client));
+		::shutdown(client, SHUT_RDWR);
+		::close(client);
+	}
+
+	static bool sendAll(const int client, std::string_view data)
+	{
+		while (!data.empty())
+		{
+			const ssize_t sent = ::send(client, data.data(), data.size(), MSG_NOSIGNAL);
+			if (sent <= 0)
+				return false;
+
+			data.remove_prefix(static_cast<size_t>(sent));
+		}
+
+		return true;
+	}
+
+private:
+	Handler m_handler;
+	int m_fd        = -1;
+	uint16_t m_port = 0;
+
+	std::atomic<uint32_t> m_connections = 0;
+	std::atomic<uint32_t> m_requests    = 0;
+
+	std::mutex m_mutex;
+	bool m_stopped = false;
+	std::vector<int> m_clients;
+	std::vector<std::thread> m_threads;
+	std::thread m_acceptor;
+};
+#endif
+
+} // namespace test
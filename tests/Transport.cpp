@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../SelfUpdater/Transport.hpp"
+#include "Test.hpp"
+
+// The socket transport against a local server: body framing, redirects and the connection pool.
+// The transport and the server only exist on POSIX systems, on Windows nothing is tested.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Transport.cpp -o TransportTest
+
+using selfUpdater::downloader::Response;
+
+#ifndef _WIN32
+using selfUpdater::downloader::SocketTransport;
+
+// The body, empty if the request failed
+std::string get(SocketTransport& transport, const std::wstring& url, uint32_t* pStatus = nullptr)
+{
+	std::vector<uint8_t> data;
+	selfUpdater::downloader::VectorSink sink(data);
+	Response response;
+
+	if (!transport.Request(url, sink, response))
+		return "";
+
+	if (pStatus != nullptr)
+		*pStatus = response.status;
+
+	return std::string(data.begin(), data.end());
+}
+
+void test_content_length()
+{
+	const std::string body = test::RandomData(200000);
+	test::TestServer server([&](const test::HttpRequest&) { return test::HttpReply{ test::TestServer::Response(200, body) }; });
+	SocketTransport transport;
+
+	uint32_t status = 0;
+	CHECK(get(transport, server.Url("file"), &status) == body);
+	CHECK(status == 200);
+
+	// The connection is kept for the following requests
+	CHECK(get(transport, server.Url("file")) == body);
+	CHECK(get(transport, server.Url("file")) == body);
+	CHECK(server.Connections() == 1);
+}
+
+void test_chunked()
+{
+	test::TestServer server([](const test::HttpRequest&) {
+		return test::HttpReply{ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+								"5\r\nHello\r\n"
+								"7;name=value\r\n, world\r\n"
+								"0\r\nX-Trailer: ignored\r\n\r\n" };
+	});
+	SocketTransport transport;
+
+	CHECK(get(transport, server.Url("chunked")) == "Hello, world");
+	CHECK(get(transport, server.Url("chunked")) == "Hello, world");
+	CHECK(server.Connections() == 1);
+}
+
+// Without a length the body ends with the connection, which can't be reused then
+void test_close_delimited()
+{
+	test::TestServer server([](const test::HttpRequest&) { return test::HttpReply{ "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nuntil the end", std::string::npos, true }; });
+	SocketTransport transport;
+
+	CHECK(get(transport, server.Url("close")) == "until the end");
+	CHECK(get(transport, server.Url("close")) == "until the end");
+	CHECK(server.Connections() == 2);
+}
+
+void test_no_body()
+{
+	test::TestServer server([](const test::HttpRequest& request) {
+		if (request.target == "/empty")
+			return test::HttpReply{ "HTTP/1.1 204 No Content\r\n\r\n" };
+
+		return test::HttpReply{ test::TestServer::Response(200, "body") };
+	});
+	SocketTransport transport;
+
+	uint32_t status = 0;
+	CHECK(get(transport, server.Url("empty"), &status).empty());
+	CHECK(status == 204);
+	CHECK(get(transport, server.Url("body")) == "body");
+	CHECK(server.Connections() == 1);
+}
+
+void test_truncated()
+{
+	test::TestServer server([](const test::HttpRequest&) {
+		test::HttpReply reply;
+		reply.data     = test::TestServer::Response(200, test::RandomData(100000));
+		reply.cutAfter = 50000;
+		return reply;
+	});
+	SocketTransport transport;
+
+	uint32_t status = 0;
+	CHECK(get(transport, server.Url("truncated"), &status).empty());
+	CHECK(status == 0);
+}
+
+// A bogus Content-Length doesn't allocate the declared size before the data arrives
+void test_huge_content_length()
+{
+	test::TestServer server([](const test::HttpRequest&) { return test::HttpReply{ "HTTP/1.1 200 OK\r\nContent-Length: 1000000000000000\r\n\r\nshort", std::string::npos, true }; });
+	SocketTransport transport;
+
+	CHECK(get(transport, server.Url("huge")).empty());
+}
+
+void test_redirect()
+{
+	test::TestServer server([](const test::HttpRequest& request) {
+		if (request.target == "/old")
+			return test::HttpReply{ test::TestServer::Response(302, "moved", "Location: /new\r\n") };
+		if (request.target == "/dir/relative")
+			return test::HttpReply{ test::TestServer::Response(307, "", "Location: target?a=b\r\n") };
+		if (request.target == "/loop")
+			return test::HttpReply{ test::TestServer::Response(301, "", "Location: loop\r\n") };
+
+		return test::HttpReply{ test::TestServer::Response(200, request.target) };
+	});
+	SocketTransport transport;
+
+	uint32_t status = 0;
+	CHECK(get(transport, server.Url("old"), &status) == "/new");
+	CHECK(status == 200);
+
+	// The body of the redirect is discarded, the same connection is used for the target
+	CHECK(server.Connections() == 1);
+	CHECK(server.Requests() == 2);
+
+	CHECK(get(transport, server.Url("dir/relative")) == "/dir/target?a=b");
+
+	CHECK(get(transport, server.Url("loop")).empty());
+	CHECK(server.Requests() == 4 + 6);
+}
+
+// The server closes every connection after the response without saying so, the pooled connection is stale on the next request
+void test_stale_connection()
+{
+	test::TestServer server([](const test::HttpRequest& request) { return test::HttpReply{ test::TestServer::Response(200, request.target), std::string::npos, true }; });
+	SocketTransport transport;
+
+	CHECK(get(transport, server.Url("first")) == "/first");
+	CHECK(get(transport, server.Url("second")) == "/second");
+	CHECK(get(transport, server.Url("third")) == "/third");
+	CHECK(server.Connections() == 3);
+}
+#endif
+
+int main()
+{
+#ifndef _WIN32
+	test_content_length();
+	test_chunked();
+	test_close_delimited();
+	test_no_body();
+	test_truncated();
+	test_huge_content_length();
+	test_redirect();
+	test_stale_connection();
+#endif
+
+	return test::Result();
+}
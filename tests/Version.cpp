@@ -0,0 +1,48 @@
+#include <string>
+
+#include "../SelfUpdater/Version.hpp"
+#include "Test.hpp"
+
+// Parsing and comparing versions in the format this is compiled with.
+
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -pthread Version.cpp -o VersionTest
+
+using selfUpdater::version::ResVersion;
+
+void test_parse()
+{
+	ResVersion version;
+
+	CHECK(ResVersion::Parse("1.2.3", version));
+	CHECK(version == ResVersion("1.2.3.0"));
+	CHECK(ResVersion::Parse("1.2.3.4", version));
+	CHECK(version.ToString() == "1.2.3");
+	CHECK((version.Key() & 0xFFFF) == 4);
+	CHECK(ResVersion::Parse("65535.0.0.65535", version));
+
+	for (const char* pStr : { "", "1", "1.2", "1.2.", "1.2.3.", "1.2.3.4.", "1.2.3.4.5", ".1.2.3", "1..2.3", "1.2.3a", "1.2.-3", "65536.0.0", " 1.2.3" })
+	{
+		version = ResVersion();
+		if (!CHECK(!ResVersion::Parse(pStr, version)))
+			std::cerr << "  Accepted: \"" << pStr << "\"" << std::endl;
+
+		CHECK(!version.IsValid());
+	}
+}
+
+void test_compare()
+{
+	CHECK(ResVersion("1.2.3.4") < ResVersion("1.2.3.5"));
+	CHECK(ResVersion("1.2.3.65535") < ResVersion("1.2.4.0"));
+	CHECK(ResVersion("1.10.0") > ResVersion("1.9.9.9"));
+	CHECK(ResVersion("2.0.0") == ResVersion(2, 0, 0, 0));
+}
+
+int main()
+{
+	test_parse();
+	test_compare();
+
+	return test::Result();
+}
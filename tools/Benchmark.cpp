@@ -0,0 +1,875 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// The startup suite compares the embedded version against reading it from the executable
+#ifndef SU_EMBEDDED_VERSION
+#define SU_EMBEDDED_VERSION 1, 2, 3, 4
+#endif
+
+#include "../SelfUpdater/BinaryManifest.hpp"
+#include "../SelfUpdater/ConditionalCache.hpp"
+#include "../SelfUpdater/Downloader.hpp"
+#include "../SelfUpdater/Hash.hpp"
+#include "../SelfUpdater/Hedge.hpp"
+#include "../SelfUpdater/Manifest.hpp"
+#include "../SelfUpdater/MappedFile.hpp"
+#include "../SelfUpdater/TreeHash.hpp"
+#include "../SelfUpdater/Utils.hpp"
+#include "../SelfUpdater/Version.hpp"
+
+#ifdef _WIN32
+#pragma comment(lib, "version.lib")
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Benchmarks for the performance relevant parts of the updater.
+// Usage: Benchmark [suite] [options] [--json <file>], without a suite all of them are run.
+//   hash [size in MB]       Sequential SHA-256 vs. BLAKE3 tree hash of a memory mapped file
+//   manifest [line count]   Parsing and looking up entries in the text and binary version file
+//   version [count]         Parsing, sorting and hashing versions, compared to the old four field layout
+//   strings [line count]    utils::Split and the UTF-8/UTF-16 conversions on a version file sized text
+//   startup [exe]           Getting the own version at startup: embedded vs. read from the executable
+//                           (default: this program, or the PE fixture of the tests if it has no version resource)
+// End-to-end against a local HTTP server started by the benchmark itself (not on Windows):
+//   download [size in MB]   Throughput of the read loop into memory, a callback and files (default and segmented mode)
+//   check [request count]   Latency of an update check: conditional request of the version file and selecting the update
+//   hedge [request count]   Latency of version file requests against a local server that delays some responses
+// --json writes every reported value to the file as well, to track the results over time.
+
+// Compile using MSVC:
+// cl /std:c++20 /O2 /EHsc /DNDEBUG Benchmark.cpp
+// Compile using GCC (13 or later) or Clang:
+// g++ -std=c++20 -O2 -DNDEBUG -pthread Benchmark.cpp -o Benchmark
+
+// A reported value, collected for --json
+struct Result
+{
+	std::string suite;
+	std::string name;
+	std::string unit;
+	double value;
+};
+
+std::vector<Result> results;
+std::string current_suite;
+
+void record(const std::string& name, const std::string& unit, const double& value)
+{
+	results.push_back({ current_suite, name, unit, value });
+}
+
+// Runs func repeatedly for at least min_time and returns the fastest run in seconds
+double measure(const std::function<void()>& func, const std::chrono::milliseconds& min_time = std::chrono::milliseconds(1000))
+{
+	using clock = std::chrono::steady_clock;
+
+	double best                 = 1e30;
+	const clock::time_point end = clock::now() + min_time;
+
+	do
+	{
+		const clock::time_point start = clock::now();
+		func();
+		best = (std::min)(best, std::chrono::duration<double>(clock::now() - start).count());
+	} while (clock::now() < end);
+
+	return best;
+}
+
+void report(const std::string& name, const double& seconds, const uint64_t& bytes)
+{
+	const double mb_per_s = static_cast<double>(bytes) / seconds / (1024.0 * 1024.0);
+
+	std::cout << "  " << name << ": " << (seconds * 1000.0) << " ms, " << mb_per_s << " MB/s" << std::endl;
+	record(name, "ms", seconds * 1000.0);
+	record(name, "MB/s", mb_per_s);
+}
+
+// Time of a single call, unit is "ms" or "us"
+void report_time(const std::string& name, const double& seconds, const std::string& unit = "ms")
+{
+	const double value = seconds * ((unit == "us") ? 1e6 : 1e3);
+
+	std::cout << "  " << name << ": " << value << " " << unit << std::endl;
+	record(name, unit, value);
+}
+
+std::string json_escape(const std::string& str)
+{
+	std::string escaped;
+	for (const char& c : str)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+bool write_json(const std::filesystem::path& filename)
+{
+	std::ofstream file(filename, std::ios::trunc);
+
+#ifdef _WIN32
+	const char* platform = "windows";
+#elif defined(__APPLE__)
+	const char* platform = "macos";
+#else
+	const char* platform = "linux";
+#endif
+
+	file << std::setprecision(9);
+	file << "{\n  \"timestamp\": " << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count() << ",\n";
+	file << "  \"platform\": \"" << platform << "\",\n";
+	file << "  \"results\": [";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		file << (i == 0 ? "\n" : ",\n") << "    { \"suite\": \"" << json_escape(r.suite) << "\", \"name\": \"" << json_escape(r.name) << "\", \"unit\": \"" << r.unit << "\", \"value\": " << r.value << " }";
+	}
+
+	file << "\n  ]\n}\n";
+
+	return file.good();
+}
+
+bool write_random_file(const std::filesystem::path& filename, const uint64_t& size)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	std::mt19937_64 rng(42);
+	std::vector<uint64_t> buffer(1024 * 1024 / sizeof(uint64_t));
+
+	for (uint64_t written = 0; written < size && file; written += buffer.size() * sizeof(uint64_t))
+	{
+		for (uint64_t& value : buffer)
+			value = rng();
+
+		const uint64_t chunk = (std::min)(size - written, static_cast<uint64_t>(buffer.size() * sizeof(uint64_t)));
+		file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(chunk));
+	}
+
+	return file.good();
+}
+
+bool bench_hash(const uint64_t& size_mb)
+{
+	const std::filesystem::path filename = std::filesystem::temp_directory_path() / "SelfUpdater.bench";
+	const uint64_t size                  = size_mb * 1024 * 1024;
+
+	if (!write_random_file(filename, size))
+	{
+		std::cerr << "Error: Cannot write the test file" << std::endl;
+		return false;
+	}
+
+	bool result = true;
+	{
+		selfUpdater::utils::MappedFile file(filename);
+		if (!file.IsOpen())
+		{
+			std::cerr << "Error: Cannot map the test file" << std::endl;
+			result = false;
+		}
+		else
+		{
+			const uint32_t threads = (std::max)(1u, std::thread::hardware_concurrency());
+
+			std::cout << "hash: " << size_mb << " MB, " << threads << " threads, BLAKE3 kernel: " << selfUpdater::hash::Blake3::Kernel() << std::endl;
+
+			// Touch every page once, so all runs work on a warm page cache
+			selfUpdater::hash::Blake3::Hash(file.Data(), static_cast<size_t>(file.Size()));
+
+			report("SHA-256 (sequential)", measure([&]() { selfUpdater::hash::Sha256::Hash(file.Data(), static_cast<size_t>(file.Size())); }), size);
+			report("BLAKE3 (1 thread)", measure([&]() { selfUpdater::hash::Blake3::Hash(file.Data(), static_cast<size_t>(file.Size()), 1); }), size);
+			report("BLAKE3 (all threads)", measure([&]() { selfUpdater::hash::Blake3::Hash(file.Data(), static_cast<size_t>(file.Size())); }), size);
+		}
+	}
+
+	std::filesystem::remove(filename);
+	return result;
+}
+
+// The parser as it was before the string_view based one: a string per line and field, std::stoi for the version
+size_t legacy_parse(const std::string& text)
+{
+	std::map<std::wstring, std::array<int32_t, 4>> versions;
+	std::vector<std::string> lines = selfUpdater::utils::Split(text, "\n");
+
+	for (std::string& line : lines)
+	{
+		selfUpdater::utils::rtrim(line);
+
+		std::vector<std::string> parts = selfUpdater::utils::Split(line, "\t");
+		if (parts.size() < 2)
+			continue;
+
+		std::vector<std::string> version = selfUpdater::utils::Split(parts[1], '.');
+		if (version.size() != 4)
+			continue;
+
+		versions[selfUpdater::utils::s2ws(parts[0])] = { std::stoi(version[0]), std::stoi(version[1]), std::stoi(version[2]), std::stoi(version[3]) };
+	}
+
+	return versions.size();
+}
+
+bool bench_manifest(const uint32_t& lines)
+{
+	std::ostringstream text;
+	selfUpdater::manifest::BinaryManifestWriter writer;
+
+	for (uint32_t i = 0; i < lines; i++)
+	{
+		const std::string name  = "Component" + std::to_string(i) + ".exe";
+		const std::string attrs = "size=" + std::to_string(1000000 + i) + "\tsha256=" + std::string(64, 'a');
+
+		text << name << '\t' << "1." << (i % 100) << '.' << (i % 1000) << ".0\t" << attrs << "\r\n";
+		writer.Add(name, selfUpdater::version::ResVersion(1, static_cast<uint16_t>(i % 100), static_cast<uint16_t>(i % 1000), 0), attrs);
+	}
+
+	const std::string data      = text.str();
+	const std::string last_name = "Component" + std::to_string(lines - 1) + ".exe";
+
+	std::ostringstream binary_stream;
+	writer.Write(binary_stream);
+	const std::string binary = binary_stream.str();
+
+	std::cout << "manifest: " << lines << " lines, " << data.size() << " bytes text, " << binary.size() << " bytes binary" << std::endl;
+
+	bool result = true;
+	selfUpdater::manifest::Entry entry;
+
+	report("Legacy parse (Split + stoi)", measure([&]() { result &= (legacy_parse(data) == lines); }), data.size());
+	report("Parse (whole map)", measure([&]() { result &= (selfUpdater::manifest::Parse(data).size() == lines); }), data.size());
+	report("FindEntry (text, single pass)", measure([&]() { result &= selfUpdater::manifest::FindEntry(data, last_name, entry); }), data.size());
+
+	const double select_time = measure([&]() {
+		selfUpdater::manifest::UpdateSelector selector(selfUpdater::version::ResVersion(1, 0, 0, 0), selfUpdater::manifest::STABLE_CHANNEL);
+		selfUpdater::manifest::SelectUpdate(data, last_name, selector);
+		result &= selector.Best().has_value(); });
+	report("SelectUpdate (text, single pass)", select_time, data.size());
+
+	const std::span<const uint8_t> binary_data(reinterpret_cast<const uint8_t*>(binary.data()), binary.size());
+	const double binary_time = measure([&]() { result &= selfUpdater::manifest::BinaryManifest(binary_data).FindEntry(last_name, entry); });
+	report_time("FindEntry (binary, indexed)", binary_time, "us");
+
+	if (!result)
+		std::cerr << "Error: Lookup failed" << std::endl;
+
+	return result;
+}
+
+// The layout of ResVersion before it was packed: four fields and the format checked on every compare
+struct LegacyVersion
+{
+	static inline bool s_msFormat = false;
+
+	uint16_t major;
+	uint16_t minor;
+	uint16_t revision;
+	uint16_t build;
+	bool valid;
+
+	bool operator<(const LegacyVersion& other) const
+	{
+		if (major != other.major)
+			return major < other.major;
+		if (minor != other.minor)
+			return minor < other.minor;
+
+		if (s_msFormat)
+		{
+			if (build != other.build)
+				return build < other.build;
+			return revision < other.revision;
+		}
+
+		if (revision != other.revision)
+			return revision < other.revision;
+		return build < other.build;
+	}
+};
+
+bool bench_version(const uint32_t& count)
+{
+	using selfUpdater::version::ResVersion;
+
+	std::mt19937 rng(42);
+	std::vector<std::string> strings;
+	std::vector<ResVersion> versions;
+	std::vector<LegacyVersion> legacy;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint16_t parts[4] = { static_cast<uint16_t>(rng() % 10), static_cast<uint16_t>(rng() % 100), static_cast<uint16_t>(rng() % 1000), static_cast<uint16_t>(rng() % 10000) };
+
+		strings.push_back(std::to_string(parts[0]) + "." + std::to_string(parts[1]) + "." + std::to_string(parts[2]) + "." + std::to_string(parts[3]));
+		versions.emplace_back(parts[0], parts[1], parts[2], parts[3]);
+		legacy.push_back({ parts[0], parts[1], parts[2], parts[3], true });
+	}
+
+	uint64_t bytes = 0;
+	for (const std::string& str : strings)
+		bytes += str.size();
+
+	std::cout << "version: " << count << " versions" << std::endl;
+
+	bool result = true;
+
+	const double parse_time = measure([&]() {
+		ResVersion version;
+		for (const std::string& str : strings)
+			result &= ResVersion::Parse(str, version); });
+	const double legacy_sort = measure([&]() {
+		std::vector<LegacyVersion> copy = legacy;
+		std::sort(copy.begin(), copy.end()); });
+	const double packed_sort = measure([&]() {
+		std::vector<ResVersion> copy = versions;
+		std::sort(copy.begin(), copy.end()); });
+	const double hash_insert = measure([&]() {
+		std::unordered_set<ResVersion> set(versions.begin(), versions.end());
+		result &= !set.empty(); });
+
+	report("Parse (from_chars)", parse_time, bytes);
+	report_time("Sort (legacy fields)", legacy_sort);
+	report_time("Sort (packed key)", packed_sort);
+	report_time("unordered_set insert", hash_insert);
+
+	if (!result)
+		std::cerr << "Error: Parsing failed" << std::endl;
+
+	return result;
+}
+
+bool bench_strings(const uint32_t& lines)
+{
+	// Component names as in the version file, every fourth one with non-ASCII characters
+	std::string text;
+	for (uint32_t i = 0; i < lines; i++)
+		text += ((i % 4 == 0) ? "Komponente_\xC3\xA4\xC3\xB6\xC3\xBC_\xE6\x9B\xB4\xE6\x96\xB0" : "Component") + std::to_string(i) + ".exe\t1." + std::to_string(i % 100) + "." + std::to_string(i % 1000) + ".0\n";
+
+	const std::wstring wide = selfUpdater::utils::ToUTF16(text);
+
+	std::cout << "strings: " << lines << " lines, " << text.size() << " bytes" << std::endl;
+
+	bool result = true;
+
+	report("Split (string delimiter)", measure([&]() { result &= (selfUpdater::utils::Split(text, "\n").size() >= lines); }), text.size());
+	report("Split (char delimiter)", measure([&]() { result &= (selfUpdater::utils::Split(text, '\t').size() > lines); }), text.size());
+	report("ToUTF16", measure([&]() { result &= (selfUpdater::utils::ToUTF16(text).size() == wide.size()); }), text.size());
+	report("ToUTF8", measure([&]() { result &= (selfUpdater::utils::ToUTF8(wide).size() == text.size()); }), text.size());
+
+	if (!result)
+		std::cerr << "Error: Conversion failed" << std::endl;
+
+	return result;
+}
+
+#ifdef _WIN32
+// The way the version was read before the PE reader, kept here as the baseline
+bool legacy_version_info(const std::wstring& exe)
+{
+	DWORD handle       = 0;
+	const DWORD size   = GetFileVersionInfoSizeW(exe.c_str(), &handle);
+	UINT length        = 0;
+	LPVOID pFixedInfo  = nullptr;
+	std::vector<char> buffer(size);
+
+	return size != 0 && GetFileVersionInfoW(exe.c_str(), handle, size, buffer.data()) && VerQueryValueW(buffer.data(), L"\\", &pFixedInfo, &length) && length != 0;
+}
+#endif
+
+// own is true if exe is this program
+bool bench_startup(std::string exe, const bool& own)
+{
+	constexpr uint32_t CALLS = 1000;
+
+	selfUpdater::version::FixedFileInfo info;
+
+	// This program usually has no version resource, the fixture of the tests has one
+	const std::filesystem::path fixture = (std::filesystem::path(__FILE__).parent_path() / ".." / "tests" / "fixtures" / "Version64.exe").lexically_normal();
+	if (!selfUpdater::version::ReadFixedFileInfo(exe, info) && own && std::filesystem::exists(fixture))
+		exe = fixture.string();
+
+	if (!selfUpdater::version::ReadFixedFileInfo(exe, info))
+	{
+		std::cerr << "Error: " << exe << " has no version resource" << std::endl;
+		return false;
+	}
+
+	std::cout << "startup: " << exe << std::endl;
+
+	// SelfUpdater::init() calls version::GetVersionInfo(), the benchmark is built with SU_EMBEDDED_VERSION so that is the
+	// embedded version. Without it, it reads the running executable with ResVersion::GetVersionInfo(), given the path here.
+	const std::wstring path = selfUpdater::utils::s2ws(exe);
+	volatile uint64_t sink  = 0;
+
+	const double embedded_time = measure([&]() {
+		for (uint32_t i = 0; i < CALLS; i++)
+			sink = selfUpdater::version::GetVersionInfo().Key(); });
+	const double resource_time = measure([&]() {
+		for (uint32_t i = 0; i < CALLS; i++)
+			sink = selfUpdater::version::ResVersion::GetVersionInfo(path).Key(); });
+
+	report_time("GetVersionInfo (embedded)", embedded_time / CALLS, "us");
+	report_time("GetVersionInfo (version resource)", resource_time / CALLS, "us");
+
+#ifdef _WIN32
+	// Part of SelfUpdater::init() in both cases
+	const double exe_path_time = measure([&]() {
+		for (uint32_t i = 0; i < CALLS; i++)
+			sink = selfUpdater::utils::GetExecutablePath().size(); });
+	const double legacy_time = measure([&]() {
+		for (uint32_t i = 0; i < CALLS; i++)
+			legacy_version_info(path); });
+
+	report_time("GetExecutablePath", exe_path_time / CALLS, "us");
+	report_time("GetFileVersionInfo", legacy_time / CALLS, "us");
+#endif
+
+	return true;
+}
+
+#ifndef _WIN32
+// Minimal HTTP/1.1 server on a random local port, answers every request on a keep-alive connection with the same body.
+// Supports single byte ranges and If-None-Match with a fixed ETag, like the static file server an update is hosted on.
+// Each response is delayed by the optional delay function, to simulate slow connections of a real server.
+class LocalServer
+{
+	static constexpr const char* ETAG = "\"bench\"";
+
+public:
+	LocalServer(const std::string& body, std::function<std::chrono::milliseconds()> delay = nullptr) :
+		m_body(body),
+		m_delay(std::move(delay))
+	{
+		m_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+		sockaddr_in address     = {};
+		address.sin_family      = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t length        = sizeof(address);
+
+		if (m_fd < 0 || ::bind(m_fd, reinterpret_cast<sockaddr*>(&address), length) != 0 || ::listen(m_fd, 64) != 0 || ::getsockname(m_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+			return;
+
+		m_port = ntohs(address.sin_port);
+		std::thread(&LocalServer::accept_loop, this).detach();
+	}
+
+	// The connection threads are detached and may still use the server, it lives until the process ends
+	LocalServer(const LocalServer&)            = delete;
+	LocalServer& operator=(const LocalServer&) = delete;
+
+	std::wstring Url(const std::string& path) const
+	{
+		return selfUpdater::utils::s2ws("http://127.0.0.1:" + std::to_string(m_port) + "/" + path);
+	}
+
+	bool IsRunning() const
+	{
+		return m_port != 0;
+	}
+
+private:
+	void accept_loop()
+	{
+		while (true)
+		{
+			const int client = ::accept(m_fd, nullptr, nullptr);
+			if (client < 0)
+				return;
+
+			// The header and the body are sent separately, without this the body waits for the delayed ACK
+			const int no_delay = 1;
+			::setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+
+			std::thread(&LocalServer::serve, this, client).detach();
+		}
+	}
+
+	void serve(const int client)
+	{
+		std::string request;
+		char buffer[4096];
+
+		while (true)
+		{
+			const ssize_t received = ::recv(client, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+				break;
+
+			request.append(buffer, static_cast<size_t>(received));
+
+			// Only GET requests without a body are sent, one request ends with an empty line
+			size_t end;
+			bool sent = true;
+			while (sent && (end = request.find("\r\n\r\n")) != std::string::npos)
+			{
+				const std::string head = request.substr(0, end + 2);
+				request.erase(0, end + 4);
+
+				if (m_delay)
+					std::this_thread::sleep_for(m_delay());
+
+				sent = respond(client, head);
+			}
+
+			if (!sent)
+				break;
+		}
+
+		::close(client);
+	}
+
+	bool respond(const int client, const std::string& head)
+	{
+		std::string header;
+		uint64_t begin = 0;
+		uint64_t end   = m_body.size();
+
+		if (head.find("If-None-Match: " + std::string(ETAG) + "\r\n") != std::string::npos)
+			return send_all(client, "HTTP/1.1 304 Not Modified\r\nETag: " + std::string(ETAG) + "\r\n\r\n");
+
+		const size_t range = head.find("Range: bytes=");
+		if (range != std::string::npos)
+		{
+			const size_t first = range + std::char_traits<char>::length("Range: bytes=");
+			const size_t dash  = head.find('-', first);
+			const size_t last  = head.find("\r\n", first);
+
+			begin = static_cast<uint64_t>(std::stoull(head.substr(first, dash - first)));
+			if (dash + 1 < last)
+				end = (std::min)(end, static_cast<uint64_t>(std::stoull(head.substr(dash + 1, last - dash - 1))) + 1);
+
+			header = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " + std::to_string(begin) + "-" + std::to_string(end - 1) + "/" + std::to_string(m_body.size()) + "\r\n";
+		}
+		else
+			header = "HTTP/1.1 200 OK\r\n";
+
+		header += "ETag: " + std::string(ETAG) + "\r\nContent-Length: " + std::to_string(end - begin) + "\r\n\r\n";
+
+		return send_all(client, header) && send_all(client, std::string_view(m_body).substr(begin, end - begin));
+	}
+
+	static bool send_all(const int client, std::string_view data)
+	{
+		while (!data.empty())
+		{
+			const ssize_t sent = ::send(client, data.data(), data.size(), MSG_NOSIGNAL);
+			if (sent <= 0)
+				return false;
+
+			data.remove_prefix(static_cast<size_t>(sent));
+		}
+
+		return true;
+	}
+
+private:
+	std::string m_body;
+	std::function<std::chrono::milliseconds()> m_delay;
+	int m_fd        = -1;
+	uint16_t m_port = 0;
+};
+
+void report_latencies(const std::string& name, std::vector<double> latencies)
+{
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](const double& p) { return latencies[(std::min)(static_cast<size_t>(p * static_cast<double>(latencies.size())), latencies.size() - 1)] * 1000.0; };
+
+	std::cout << "  " << name << ": p50 " << percentile(0.5) << " ms, p95 " << percentile(0.95) << " ms, p99 " << percentile(0.99) << " ms, max " << (latencies.back() * 1000.0) << " ms" << std::endl;
+	record(name + " p50", "ms", percentile(0.5));
+	record(name + " p95", "ms", percentile(0.95));
+	record(name + " p99", "ms", percentile(0.99));
+	record(name + " max", "ms", latencies.back() * 1000.0);
+}
+#endif
+
+bool bench_hedge(const uint32_t& requests)
+{
+#ifdef _WIN32
+	std::cout << "hedge: needs the POSIX socket transport, skipped" << std::endl;
+	return true;
+#else
+	using clock = std::chrono::steady_clock;
+
+	constexpr double SLOW_FRACTION = 0.05;
+	const auto fast_delay          = std::chrono::milliseconds(2);
+	const auto slow_delay          = std::chrono::milliseconds(200);
+
+	// Every 20th response on average is slow, independent of the connection
+	std::mutex rng_mutex;
+	std::mt19937 rng(42);
+	LocalServer server(std::string(4096, 'v'), [&]() {
+		std::lock_guard<std::mutex> lock(rng_mutex);
+		return (std::uniform_real_distribution<double>(0.0, 1.0)(rng) < SLOW_FRACTION) ? slow_delay : fast_delay;
+	});
+
+	if (!server.IsRunning())
+	{
+		std::cerr << "Error: Cannot start the local server" << std::endl;
+		return false;
+	}
+
+	const std::wstring url = server.Url("versions.txt");
+
+	std::cout << "hedge: " << requests << " requests, " << (SLOW_FRACTION * 100.0) << "% delayed by " << slow_delay.count() << " ms" << std::endl;
+
+	bool result = true;
+	std::vector<double> plain;
+	std::vector<double> hedged;
+
+	for (uint32_t i = 0; i < requests; i++)
+	{
+		std::vector<uint8_t> data;
+		selfUpdater::downloader::VectorSink sink(data);
+		selfUpdater::downloader::Response response;
+
+		const clock::time_point start = clock::now();
+		result &= selfUpdater::downloader::Downloader::Request(url, sink, response) && response.IsSuccess();
+		plain.push_back(std::chrono::duration<double>(clock::now() - start).count());
+	}
+
+	selfUpdater::downloader::Hedge hedge;
+	for (uint32_t i = 0; i < requests; i++)
+	{
+		std::vector<uint8_t> data;
+		selfUpdater::downloader::Response response;
+
+		const clock::time_point start = clock::now();
+		result &= hedge.Request({ url }, data, response) && response.IsSuccess();
+		hedged.push_back(std::chrono::duration<double>(clock::now() - start).count());
+	}
+
+	report_latencies("Single request", plain);
+	report_latencies("Hedged request", hedged);
+	std::cout << "  Hedged: " << hedge.Hedged() << " of " << hedge.Requests() << " requests, the second one won " << hedge.HedgeWins() << " times, final delay " << hedge.Delay().count() << " ms" << std::endl;
+	record("Hedged requests", "count", static_cast<double>(hedge.Hedged()));
+	record("Hedge wins", "count", static_cast<double>(hedge.HedgeWins()));
+
+	if (!result)
+		std::cerr << "Error: Request failed" << std::endl;
+
+	return result;
+#endif
+}
+
+bool bench_download(const uint64_t& size_mb)
+{
+#ifdef _WIN32
+	std::cout << "download: needs the POSIX socket transport, skipped" << std::endl;
+	return true;
+#else
+	const uint64_t size = size_mb * 1024 * 1024;
+
+	std::string body(size, '\0');
+	std::mt19937_64 rng(42);
+	for (size_t i = 0; i + sizeof(uint64_t) <= body.size(); i += sizeof(uint64_t))
+	{
+		const uint64_t value = rng();
+		std::memcpy(body.data() + i, &value, sizeof(value));
+	}
+
+	LocalServer server(body);
+	if (!server.IsRunning())
+	{
+		std::cerr << "Error: Cannot start the local server" << std::endl;
+		return false;
+	}
+
+	const std::wstring url                = server.Url("update.bin");
+	const std::filesystem::path file_path = std::filesystem::temp_directory_path() / "SelfUpdater.bench.download";
+
+	std::cout << "download: " << size_mb << " MB from a local server" << std::endl;
+
+	bool result = true;
+
+	// Only the read loop, the data is dropped
+	const double callback_time = measure([&]() {
+		uint64_t received = 0;
+		selfUpdater::downloader::CallbackSink sink([&](std::span<const uint8_t> chunk) { received += chunk.size(); return true; });
+		result &= selfUpdater::downloader::Downloader::DownloadSync(url, sink) && received == size; });
+	const double vector_time = measure([&]() {
+		std::vector<uint8_t> data;
+		result &= selfUpdater::downloader::Downloader::DownloadSync(url, data) && data.size() == size; });
+	const double file_time = measure([&]() { result &= selfUpdater::downloader::Downloader::DownloadSync(url, file_path.wstring()) && std::filesystem::file_size(file_path) == size; });
+	const double segmented_time = measure([&]() {
+		result &= selfUpdater::downloader::Downloader::DownloadSync(url, file_path.wstring(), nullptr, selfUpdater::downloader::DownloadMode::Segmented) && std::filesystem::file_size(file_path) == size; });
+
+	report("Read loop (CallbackSink)", callback_time, size);
+	report("Into memory (VectorSink)", vector_time, size);
+	report("Into a file", file_time, size);
+	report("Into a file (segmented)", segmented_time, size);
+
+	std::filesystem::remove(file_path);
+
+	if (!result)
+		std::cerr << "Error: Download failed" << std::endl;
+
+	return result;
+#endif
+}
+
+bool bench_check(const uint32_t& requests)
+{
+#ifdef _WIN32
+	std::cout << "check: needs the POSIX socket transport, skipped" << std::endl;
+	return true;
+#else
+	using clock = std::chrono::steady_clock;
+
+	constexpr uint32_t LINES = 1000;
+
+	std::string text;
+	for (uint32_t i = 0; i < LINES; i++)
+		text += "Component" + std::to_string(i) + ".exe\t1." + std::to_string(i % 100) + "." + std::to_string(i % 1000) + ".0\tsize=" + std::to_string(1000000 + i) + "\tsha256=" + std::string(64, 'a') + "\r\n";
+
+	LocalServer server(text);
+	if (!server.IsRunning())
+	{
+		std::cerr << "Error: Cannot start the local server" << std::endl;
+		return false;
+	}
+
+	const std::wstring url                = server.Url("versions.txt");
+	const std::filesystem::path cache_dir = std::filesystem::temp_directory_path() / "SelfUpdater.bench.cache";
+	const std::string last_name           = "Component" + std::to_string(LINES - 1) + ".exe";
+
+	std::filesystem::remove_all(cache_dir);
+	std::filesystem::create_directories(cache_dir);
+
+	std::cout << "check: " << requests << " requests, version file with " << LINES << " lines, " << text.size() << " bytes" << std::endl;
+
+	bool result = true;
+	std::vector<double> plain;
+	std::vector<double> not_modified;
+	std::vector<double> full_check;
+
+	for (uint32_t i = 0; i < requests; i++)
+	{
+		std::vector<uint8_t> data;
+
+		const clock::time_point start = clock::now();
+		result &= selfUpdater::downloader::Downloader::DownloadSync(url, data) && data.size() == text.size();
+		plain.push_back(std::chrono::duration<double>(clock::now() - start).count());
+	}
+
+	selfUpdater::downloader::ConditionalCache cache(cache_dir);
+	std::vector<uint8_t> cached;
+	result &= (cache.Fetch(url, cached) == selfUpdater::downloader::ConditionalCache::Result::Modified);
+
+	for (uint32_t i = 0; i < requests; i++)
+	{
+		std::vector<uint8_t> data;
+
+		const clock::time_point start = clock::now();
+		result &= (cache.Fetch(url, data) == selfUpdater::downloader::ConditionalCache::Result::NotModified);
+		not_modified.push_back(std::chrono::duration<double>(clock::now() - start).count());
+	}
+
+	// What an update check does: fetch the version file, then select the update from it
+	for (uint32_t i = 0; i < requests; i++)
+	{
+		std::vector<uint8_t> data;
+
+		const clock::time_point start = clock::now();
+		result &= selfUpdater::downloader::Downloader::DownloadSync(url, data);
+
+		selfUpdater::manifest::UpdateSelector selector(selfUpdater::version::ResVersion(1, 0, 0, 0), selfUpdater::manifest::STABLE_CHANNEL);
+		selfUpdater::manifest::SelectUpdate(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()), last_name, selector);
+		result &= selector.Best().has_value();
+		full_check.push_back(std::chrono::duration<double>(clock::now() - start).count());
+	}
+
+	report_latencies("Fetch (200)", plain);
+	report_latencies("Conditional fetch (304)", not_modified);
+	report_latencies("Fetch + SelectUpdate", full_check);
+
+	std::filesystem::remove_all(cache_dir);
+
+	if (!result)
+		std::cerr << "Error: Update check failed" << std::endl;
+
+	return result;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> args;
+	std::string json_file;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--json" && i + 1 < argc)
+			json_file = argv[++i];
+		else
+			args.push_back(argv[i]);
+	}
+
+	const std::string suite = !args.empty() ? args[0] : "";
+	const bool has_param    = (args.size() >= 2);
+	bool result             = true;
+
+	auto run = [&](const std::string& name, const std::function<bool()>& bench) {
+		if (!suite.empty() && suite != name)
+			return;
+
+		current_suite = name;
+		result &= bench();
+	};
+
+	run("hash", [&]() { return bench_hash(has_param ? std::stoull(args[1]) : 256); });
+	run("manifest", [&]() { return bench_manifest(has_param ? static_cast<uint32_t>(std::stoul(args[1])) : 100000); });
+	run("version", [&]() { return bench_version(has_param ? static_cast<uint32_t>(std::stoul(args[1])) : 1000000); });
+	run("strings", [&]() { return bench_strings(has_param ? static_cast<uint32_t>(std::stoul(args[1])) : 100000); });
+	run("startup", [&]() { return bench_startup(has_param ? args[1] : argv[0], !has_param); });
+	run("download", [&]() { return bench_download(has_param ? std::stoull(args[1]) : 64); });
+	run("check", [&]() { return bench_check(has_param ? static_cast<uint32_t>(std::stoul(args[1])) : 1000); });
+	run("hedge", [&]() { return bench_hedge(has_param ? static_cast<uint32_t>(std::stoul(args[1])) : 1000); });
+
+	if (!json_file.empty() && !write_json(json_file))
+	{
+		std::cerr << "Error: Cannot write " << json_file << std::endl;
+		result = false;
+	}
+
+	return result ? 0 : 1;
+}
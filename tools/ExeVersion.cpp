@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../SelfUpdater/PeVersion.hpp"
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Prints the file version of the given executables as version file lines:
+//   MyApp.exe<TAB>1.2.0.0
+// The version resource is read directly from the files, so this also works on build machines without Windows.
+// The parts are printed in the order they are stored in the resource, which is how the updater reads them in both version formats.
+
+// Compile using MSVC:
+// cl /std:c++20 /O2 /EHsc /DNDEBUG ExeVersion.cpp
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+
+	if (args.empty())
+	{
+		std::cerr << "Usage: " << argv[0] << " <file>..." << std::endl;
+		return 1;
+	}
+
+	int result = 0;
+
+	for (const std::string& file : args)
+	{
+		selfUpdater::version::FixedFileInfo info = {};
+		if (!selfUpdater::version::ReadFixedFileInfo(file, info))
+		{
+			std::cerr << "Error: No version info in file: " << file << std::endl;
+			result = 1;
+			continue;
+		}
+
+		std::cout << std::filesystem::path(file).filename().string() << "\t" << (info.fileVersionMS >> 16) << "." << (info.fileVersionMS & 0xFFFF) << "." << (info.fileVersionLS >> 16) << "." << (info.fileVersionLS & 0xFFFF) << std::endl;
+	}
+
+	return result;
+}
@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "../SelfUpdater/Hash.hpp"
+#include "../SelfUpdater/MappedFile.hpp"
+#include "../SelfUpdater/TreeHash.hpp"
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Prints the size and hashes of the given files, the first line of each file can be appended to its entry in the version file:
+//   MyApp.exe<TAB>1.2.0.0<TAB>size=...<TAB>sha256=...
+// The BLAKE3 tree hash is computed on all cores and is meant for quickly comparing large files.
+
+// Compile using MSVC:
+// cl /std:c++20 /O2 /EHsc /DNDEBUG HashFile.cpp
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <file>..." << std::endl;
+		return 1;
+	}
+
+	int result = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		selfUpdater::utils::MappedFile file(argv[i]);
+		if (!file.IsOpen())
+		{
+			std::cerr << "Error: Cannot open file: " << argv[i] << std::endl;
+			result = 1;
+			continue;
+		}
+
+		const size_t size = static_cast<size_t>(file.Size());
+
+		std::cout << argv[i] << std::endl;
+		std::cout << "  size=" << file.Size() << "\tsha256=" << selfUpdater::hash::ToHex(selfUpdater::hash::Sha256::Hash(file.Data(), size)) << std::endl;
+		std::cout << "  blake3=" << selfUpdater::hash::ToHex(selfUpdater::hash::Blake3::Hash(file.Data(), size)) << std::endl;
+	}
+
+	return result;
+}
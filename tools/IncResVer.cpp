@@ -21,23 +21,27 @@
 #error "This program requires C++17 or later, for MSVC use /std:c++17 or later"
 #endif
 
-// Compile using MSVC:
+// Increments the build number in the FILEVERSION/PRODUCTVERSION entries of a resource script.
+// If a header is given, the new file version is also written to it, so it can be compiled into the
+// application as SU_VERSION_HEADER (see SelfUpdater/Version.hpp) instead of being read at startup.
+
+// Compile using MSVC (no binary is checked in, build it before adding it as a pre-build step):
 // cl /std:c++20 /O2 /DNDEBUG IncResVer.cpp
 
 static bool g_msFormat = false;
 
-void update_line(std::string& line, const std::regex& pattern, const bool& is_string_format)
+bool update_line(std::string& line, const std::regex& pattern, const bool& is_string_format, std::array<int32_t, 4>& version)
 {
 	std::smatch match;
 	if (std::regex_search(line, match, pattern))
 	{
-		std::array<int32_t, 4> version = { 0, 0, 0, 0 };
+		version = { 0, 0, 0, 0 };
 
 		// Check if the required amount of groups is present
 		if (match.size() < 6)
 		{
 			std::cerr << "Error: Invalid version format in line: " << line << std::endl;
-			return;
+			return false;
 		}
 
 		std::string prefix = match[1].str();
@@ -62,19 +66,53 @@ void update_line(std::string& line, const std::regex& pattern, const bool& is_st
 			updated << prefix << version[0] << ',' << version[1] << ',' << version[2] << ',' << version[3];
 
 		line = updated.str();
+		return true;
 	}
+
+	return false;
+}
+
+bool write_header(const std::string& filename, const std::string& rc_filename, const std::array<int32_t, 4>& version)
+{
+	std::ofstream outfile(filename, std::ios::trunc);
+	if (!outfile)
+		return false;
+
+	// ResVersion takes major, minor, revision, build, the Microsoft format stores the build before the revision
+	const int32_t revision = g_msFormat ? version[3] : version[2];
+	const int32_t build    = g_msFormat ? version[2] : version[3];
+
+	outfile << "#pragma once" << std::endl
+			<< std::endl
+			<< "// Generated by IncResVer from " << std::filesystem::path(rc_filename).filename().string() << ", do not edit" << std::endl
+			<< "#define SU_EMBEDDED_VERSION " << version[0] << ", " << version[1] << ", " << revision << ", " << build << std::endl;
+
+	if (g_msFormat)
+		outfile << std::endl
+				<< "#ifndef SU_MS_VERSION_FORMAT" << std::endl
+				<< "#define SU_MS_VERSION_FORMAT" << std::endl
+				<< "#endif" << std::endl;
+
+	return outfile.good();
 }
 
 int main(int argc, char* argv[])
 {
 	if (argc < 2)
 	{
-		std::cerr << "Usage: " << argv[0] << " <filename.rc> [MS_FORMAT]" << std::endl;
+		std::cerr << "Usage: " << argv[0] << " <filename.rc> [MS_FORMAT] [version.h]" << std::endl;
 		return 1;
 	}
 
-	if (argc >= 3 && std::string(argv[2]) == "MS_FORMAT")
-		g_msFormat = true;
+	std::string header_filename;
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "MS_FORMAT")
+			g_msFormat = true;
+		else
+			header_filename = argv[i];
+	}
 
 	std::string filename = argv[1];
 
@@ -95,10 +133,20 @@ int main(int argc, char* argv[])
 	std::regex numeric_pattern(R"((.*\b(?!FILEVERSION|PRODUCTVERSION)\s+)(\d+),(\d+),(\d+),(\d+))");
 	std::regex string_pattern(R"|((.*\bVALUE\s+"(?:FileVersion|ProductVersion)",\s*"\s*)(\d+)\.(\d+)\.(\d+)\.(\d+)(\\0)?")|");
 
+	std::array<int32_t, 4> file_version = { 0, 0, 0, 0 };
+	bool has_file_version               = false;
+
 	for (std::string& l : lines)
 	{
-		update_line(l, numeric_pattern, false);
-		update_line(l, string_pattern, true);
+		std::array<int32_t, 4> version;
+
+		if (update_line(l, numeric_pattern, false, version) && !has_file_version && l.find("FILEVERSION") != std::string::npos)
+		{
+			file_version     = version;
+			has_file_version = true;
+		}
+
+		update_line(l, string_pattern, true, version);
 	}
 
 	const std::string backup_filename = filename + ".bak";
@@ -115,5 +163,23 @@ int main(int argc, char* argv[])
 		outfile << l << std::endl;
 
 	std::cout << "Build version incremented successfully in " << filename << std::endl;
+
+	if (!header_filename.empty())
+	{
+		if (!has_file_version)
+		{
+			std::cerr << "Error: No FILEVERSION found in file: " << filename << std::endl;
+			return 3;
+		}
+
+		if (!write_header(header_filename, filename, file_version))
+		{
+			std::cerr << "Error: Cannot write to file: " << header_filename << std::endl;
+			return 2;
+		}
+
+		std::cout << "Version header written to " << header_filename << std::endl;
+	}
+
 	return 0;
 }
\ No newline at end of file
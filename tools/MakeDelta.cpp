@@ -0,0 +1,169 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../SelfUpdater/Delta.hpp"
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Creates a delta patch that turns <old> into <new>, see SelfUpdater/Delta.hpp for the format.
+// The patch has to be uploaded next to the binaries and announced in the version file:
+//   MyApp.exe<TAB>1.2.0.0<TAB>patch=1.1.0.0:MyApp_1.1.0.0_1.2.0.0.sudelta
+
+// Compile using MSVC:
+// cl /std:c++20 /O2 /EHsc /DNDEBUG MakeDelta.cpp
+
+static constexpr size_t BLOCK_SIZE = 32;
+static constexpr uint64_t PRIME    = 1099511628211ULL;
+
+bool read_file(const std::string& filename, std::vector<uint8_t>& data)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		return false;
+
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+uint64_t hash_block(const uint8_t* pData)
+{
+	uint64_t hash = 0;
+	for (size_t i = 0; i < BLOCK_SIZE; i++)
+		hash = hash * PRIME + pData[i];
+
+	return hash;
+}
+
+// Greedy matching: every aligned block of the source is indexed, the target is scanned with a rolling hash
+// and every hit is extended as far as possible in both directions
+void create_patch(const std::vector<uint8_t>& source, const std::vector<uint8_t>& target, selfUpdater::delta::PatchWriter& writer)
+{
+	std::unordered_map<uint64_t, uint64_t> index;
+	for (uint64_t pos = 0; pos + BLOCK_SIZE <= source.size(); pos += BLOCK_SIZE)
+		index.emplace(hash_block(source.data() + pos), pos);
+
+	// PRIME^(BLOCK_SIZE - 1), used to remove the leaving byte from the rolling hash
+	uint64_t outFactor = 1;
+	for (size_t i = 1; i < BLOCK_SIZE; i++)
+		outFactor *= PRIME;
+
+	size_t pos          = 0;
+	size_t literalStart = 0;
+	uint64_t hash       = target.size() >= BLOCK_SIZE ? hash_block(target.data()) : 0;
+
+	while (pos + BLOCK_SIZE <= target.size())
+	{
+		auto it = index.find(hash);
+		if (it != index.end() && std::memcmp(source.data() + it->second, target.data() + pos, BLOCK_SIZE) == 0)
+		{
+			uint64_t src = it->second;
+			size_t back  = 0;
+			size_t len   = BLOCK_SIZE;
+
+			while (pos - back > literalStart && src - back > 0 && source[src - back - 1] == target[pos - back - 1])
+				back++;
+
+			while (pos + len < target.size() && src + len < source.size() && source[src + len] == target[pos + len])
+				len++;
+
+			writer.Add(target.data() + literalStart, pos - back - literalStart);
+			writer.Copy(src - back, back + len);
+
+			pos += len;
+			literalStart = pos;
+
+			if (pos + BLOCK_SIZE <= target.size())
+				hash = hash_block(target.data() + pos);
+
+			continue;
+		}
+
+		if (pos + BLOCK_SIZE < target.size())
+			hash = (hash - target[pos] * outFactor) * PRIME + target[pos + BLOCK_SIZE];
+
+		pos++;
+	}
+
+	writer.Add(target.data() + literalStart, target.size() - literalStart);
+}
+
+// Applies the patch the same way the updater does, to make sure it is usable
+bool verify_patch(const std::string& source_filename, const std::string& patch_filename)
+{
+	std::vector<uint8_t> patch;
+	if (!read_file(patch_filename, patch))
+		return false;
+
+	const std::filesystem::path temp_filename = std::filesystem::temp_directory_path() / "MakeDelta.verify";
+
+	bool result;
+	{
+		selfUpdater::delta::PatchSink sink(source_filename, temp_filename);
+		result = sink.Write(patch.data(), patch.size()) && sink.Finish();
+	}
+
+	std::filesystem::remove(temp_filename);
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: " << argv[0] << " <old.exe> <new.exe> <patch>" << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> source;
+	std::vector<uint8_t> target;
+
+	if (!read_file(argv[1], source) || !read_file(argv[2], target))
+	{
+		std::cerr << "Error: Cannot read the input files" << std::endl;
+		return 1;
+	}
+
+	std::ofstream outfile(argv[3], std::ios::binary | std::ios::trunc);
+	if (!outfile)
+	{
+		std::cerr << "Error: Cannot write to file: " << argv[3] << std::endl;
+		return 2;
+	}
+
+	selfUpdater::delta::PatchWriter writer(outfile, source.size(), target.size(), selfUpdater::hash::Sha256::Hash(target.data(), target.size()));
+	create_patch(source, target, writer);
+
+	if (!writer.End())
+	{
+		std::cerr << "Error: Cannot write to file: " << argv[3] << std::endl;
+		return 2;
+	}
+
+	outfile.close();
+
+	if (!verify_patch(argv[1], argv[3]))
+	{
+		std::cerr << "Error: Verification of the created patch failed" << std::endl;
+		return 3;
+	}
+
+	std::cout << "Patch created successfully: " << argv[3] << " (" << std::filesystem::file_size(argv[3]) << " bytes for a " << target.size() << " byte target)" << std::endl;
+	return 0;
+}
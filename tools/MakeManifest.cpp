@@ -0,0 +1,111 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../SelfUpdater/BinaryManifest.hpp"
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Converts a text version file into the binary format, see SelfUpdater/BinaryManifest.hpp.
+// The updater detects the format on its own, so the output can be uploaded under the configured version file name.
+// Use -ms if the versions are given in the Microsoft format (major.minor.build.revision).
+
+// Compile using MSVC:
+// cl /std:c++20 /O2 /EHsc /DNDEBUG MakeManifest.cpp
+
+using selfUpdater::version::BasicResVersion;
+using selfUpdater::version::ResVersion;
+using selfUpdater::version::VersionFormat;
+
+// The binary format stores the parts by meaning, so only the text has to be read in the given format
+template<VersionFormat FORMAT>
+ResVersion parse_version(const std::string& text)
+{
+	const BasicResVersion<FORMAT> version(text);
+	if (!version)
+		return ResVersion();
+
+	return ResVersion(version.GetMajor(), version.GetMinor(), version.GetRevision(), version.GetBuild());
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+	bool ms_format = false;
+
+	if (!args.empty() && args[0] == "-ms")
+	{
+		ms_format = true;
+		args.erase(args.begin());
+	}
+
+	if (args.size() < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " [-ms] <versions.txt> <output>" << std::endl;
+		return 1;
+	}
+
+	std::ifstream infile(args[0]);
+	if (!infile)
+	{
+		std::cerr << "Error: Cannot open file: " << args[0] << std::endl;
+		return 1;
+	}
+
+	selfUpdater::manifest::BinaryManifestWriter writer;
+	std::string line;
+	uint32_t line_number = 0;
+	uint32_t entries     = 0;
+
+	while (std::getline(infile, line))
+	{
+		line_number++;
+		selfUpdater::utils::rtrim(line);
+
+		const size_t name_end = line.find('\t');
+		if (line.empty() || line[0] == '#' || name_end == std::string::npos)
+			continue;
+
+		const size_t version_end = line.find('\t', name_end + 1);
+		const std::string name   = line.substr(0, name_end);
+		const std::string attrs  = (version_end == std::string::npos) ? "" : line.substr(version_end + 1);
+
+		// Versions can have a prerelease tag: 1.3.0-rc.1
+		const std::string version_column = line.substr(name_end + 1, version_end - name_end - 1);
+		const size_t dash                = version_column.find('-');
+		const std::string version_str    = version_column.substr(0, dash);
+		const std::string prerelease     = (dash == std::string::npos) ? "" : version_column.substr(dash + 1);
+
+		const ResVersion version = ms_format ? parse_version<VersionFormat::Microsoft>(version_str) : parse_version<VersionFormat::Default>(version_str);
+		if (!version || (dash != std::string::npos && !selfUpdater::manifest::IsValidPrerelease(prerelease)))
+		{
+			std::cerr << "Warning: Skipping line " << line_number << ", invalid version" << std::endl;
+			continue;
+		}
+
+		writer.Add(name, version, attrs, prerelease);
+		entries++;
+	}
+
+	std::ofstream outfile(args[1], std::ios::binary | std::ios::trunc);
+	if (!outfile || !writer.Write(outfile))
+	{
+		std::cerr << "Error: Cannot write to file: " << args[1] << std::endl;
+		return 2;
+	}
+
+	std::cout << "Converted " << entries << " entries to " << args[1] << std::endl;
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../SelfUpdater/BlockSync.hpp"
+
+#if defined(_MSC_VER)
+// MSVC compiler
+#define CPP_VERSION _MSVC_LANG
+#else
+// GCC, Clang, or other standards-compliant compilers
+#define CPP_VERSION __cplusplus
+#endif
+
+#if CPP_VERSION < 202002L
+#error "This program requires C++20 or later, for MSVC use /std:c++20 or later"
+#endif
+
+// Creates the block signature used by the updater to reuse parts of the installed binary.
+// The signature has to be uploaded next to the binary as <binary>.zsig, e.g., MyApp.exe.zsig
+
+// Compile using MSVC:
+// cl /std:c++20 /O2 /EHsc /DNDEBUG MakeSignature.cpp
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <binary> [block size]" << std::endl;
+		return 1;
+	}
+
+	const std::string filename = argv[1];
+	const uint32_t block_size  = (argc >= 3) ? static_cast<uint32_t>(std::stoul(argv[2])) : selfUpdater::blocksync::DEFAULT_BLOCK_SIZE;
+
+	if (block_size == 0)
+	{
+		std::cerr << "Error: The block size must not be zero" << std::endl;
+		return 1;
+	}
+
+	std::ifstream infile(filename, std::ios::binary);
+	if (!infile)
+	{
+		std::cerr << "Error: Cannot open file: " << filename << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+	infile.close();
+
+	const selfUpdater::blocksync::Signature signature = selfUpdater::blocksync::Signature::Create(data.data(), data.size(), block_size);
+
+	const std::string signature_filename = filename + ".zsig";
+
+	std::ofstream outfile(signature_filename, std::ios::binary | std::ios::trunc);
+	if (!outfile || !signature.Write(outfile))
+	{
+		std::cerr << "Error: Cannot write to file: " << signature_filename << std::endl;
+		return 2;
+	}
+
+	std::cout << "Signature with " << signature.Blocks().size() << " blocks written to " << signature_filename << std::endl;
+	return 0;
+}